@@ -0,0 +1,50 @@
+/*
+  Matrix Mini R4 IMU AHRS Example
+ * Description: Runs the attitude filter on the R4 from the IMU stream and
+ * prints the quaternion, the gravity direction and the heading.
+
+ * The filter takes every 10 ms sample as the getters service the link, so
+ * keep calling them instead of a long delay(). The heading counts whole
+ * turns, it does not wrap at 360.
+
+  www.matrixrobotics.com
+*/
+#include <MatrixMiniR4.h>
+
+uint32_t lastPrint = 0;
+
+void setup() {
+  MiniR4.begin();
+  Serial.begin(115200);
+  MiniR4.PWR.setBattCell(2);  // 18650x2, two-cell (2S)
+  Serial.println("\nMATRIX Mini R4 Test - IMU AHRS\n");
+
+  // Mahony by default, AHRS::FILTER::MADGWICK for the other one
+  MiniR4.Motion.beginAHRS(10);
+}
+
+void loop() {
+  float w, x, y, z, gx, gy, gz;
+  MiniR4.Motion.getQuaternion(w, x, y, z);
+  MiniR4.Motion.getGravity(gx, gy, gz);
+  float heading = MiniR4.Motion.getHeading();
+
+  if (millis() - lastPrint >= 100) {
+    lastPrint = millis();
+    Serial.print("q=");
+    Serial.print(w, 3); Serial.print(" ");
+    Serial.print(x, 3); Serial.print(" ");
+    Serial.print(y, 3); Serial.print(" ");
+    Serial.print(z, 3);
+    Serial.print("  g=");
+    Serial.print(gx, 2); Serial.print(" ");
+    Serial.print(gy, 2); Serial.print(" ");
+    Serial.print(gz, 2);
+    Serial.print("  heading=");
+    Serial.println(heading, 1);
+  }
+
+  if (MiniR4.BTN_UP.getState()) {
+    MiniR4.Motion.resetIMUValues();  // heading back to 0
+  }
+}
@@ -0,0 +1,75 @@
+/*
+  Matrix Mini R4 DriveDC Tasks Example
+ * Description: Drives a square while a DHT11 on D1 is read and the OLED is
+ * updated, using cooperative tasks (MiniR4.Tasks).
+
+ * The blocking DriveDC moves and the DHT11 read let the other tasks run
+ * while they wait. Press BTN_DOWN to print where the loop time goes.
+
+  www.matrixrobotics.com
+*/
+#include "MatrixMiniR4.h"
+
+float temp;
+int hum;
+
+// Reads the DHT11, the read waits 250 ms before it starts.
+void readSensor() {
+  MiniR4.D1.MXDHT.readTemperatureHumidity(temp, hum);
+}
+MiniR4PeriodicTask sensorTask("dht11", 2000, readSensor);
+
+// Redraws the screen, sending one page per pass so a frame never holds
+// the other tasks up for long.
+class ScreenTask : public MiniR4Task {
+public:
+  ScreenTask() : MiniR4Task("oled") {}
+
+protected:
+  void run(void) override {
+    MR4_TASK_BEGIN();
+    while (true) {
+      MiniR4.OLED.clearDisplay();
+      MiniR4.OLED.setCursor(5, 5);
+      MiniR4.OLED.print("Temp:" + String(temp) + "C Hum:" + String(hum) + "%");
+      MiniR4.OLED.setCursor(5, 20);
+      MiniR4.OLED.print("Deg:" + String(MiniR4.DriveDC.getDegrees()));
+      MR4_TASK_WAIT_UNTIL(MiniR4.OLED.displayStep());
+      MR4_TASK_DELAY(100);
+    }
+    MR4_TASK_END();
+  }
+};
+ScreenTask screenTask;
+
+void setup() {
+  MiniR4.begin();
+  Serial.begin(115200);
+  MiniR4.PWR.setBattCell(2);  // 18650x2, two-cell (2S)
+  MiniR4.OLED.setTextSize(1);
+
+  MiniR4.M2.setReverse(true);
+  MiniR4.DriveDC.begin(2, 3, true, false);
+
+  MiniR4.Tasks.add(sensorTask);
+  MiniR4.Tasks.add(screenTask);
+
+  Serial.println("Press BTN_UP to drive a square...");
+  while (!MiniR4.BTN_UP.getState()) {
+    MiniR4.Tasks.delay(10);  // Screen keeps updating
+  }
+  MiniR4.Tasks.resetStats();
+}
+
+void loop() {
+  for (int side = 0; side < 4; side++) {
+    MiniR4.DriveDC.MoveDegs(50, 50, 720, true);  // Blocks, tasks keep running
+    MiniR4.DriveDC.TurnGyro(30, 90 * (side + 1), 1, true);
+  }
+
+  while (!MiniR4.BTN_DOWN.getState()) {
+    MiniR4.Tasks.run();
+  }
+  MiniR4.Tasks.printStats(Serial);
+  MiniR4.Tasks.delay(300);  // Debounce protection
+}
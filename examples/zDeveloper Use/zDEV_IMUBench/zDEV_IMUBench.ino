@@ -0,0 +1,129 @@
+/*
+  Matrix Mini R4 IMU data path benchmark
+
+  Compares the float and double IMU paths on the R4 (Cortex-M4F, single
+  precision FPU only, double is done in software):
+
+  - decode: three int16 from an IMU frame, scaled to deg/s and g
+  - filter: a complementary filter step on the decoded sample
+  - getter: MiniR4.Motion.getGyro() from the telemetry shadow
+
+  Cycles come from the DWT cycle counter, micros() x 48 where it is not
+  available. Keep the robot still, the IMU stream is subscribed at 10 ms.
+*/
+#include <MatrixMiniR4.h>
+
+#define SAMPLES 1000
+#define CPU_MHZ 48
+
+// Recorded gyro / acc frames, little endian int16 x3 (0.01 deg/s, 0.001 g)
+static const uint8_t frames[][12] = {
+  { 0x0C, 0x00, 0xF6, 0xFF, 0x2E, 0x01, 0x14, 0x00, 0xE2, 0xFF, 0xE0, 0x03 },
+  { 0x10, 0x00, 0xF0, 0xFF, 0x40, 0x01, 0x1A, 0x00, 0xDE, 0xFF, 0xE4, 0x03 },
+  { 0x08, 0x00, 0xF8, 0xFF, 0x22, 0x01, 0x10, 0x00, 0xE6, 0xFF, 0xDC, 0x03 },
+  { 0x0E, 0x00, 0xF4, 0xFF, 0x38, 0x01, 0x18, 0x00, 0xE0, 0xFF, 0xE2, 0x03 },
+};
+#define FRAME_NUM (sizeof(frames) / sizeof(frames[0]))
+
+volatile float  sinkF;
+volatile double sinkD;
+
+static void cyclesBegin() {
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+static uint32_t cyclesNow() {
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+  return DWT->CYCCNT;
+#else
+  return micros() * CPU_MHZ;
+#endif
+}
+
+template <typename T>
+static T decode(const uint8_t* b, uint8_t offset, T scale) {
+  return (int16_t)(b[offset] | (b[offset + 1] << 8)) * scale;
+}
+
+// One IMU sample through decode and a complementary filter, in T.
+template <typename T>
+static T pipeline(const uint8_t* b, T& angle) {
+  T gx = decode<T>(b, 0, (T)0.01);
+  T gz = decode<T>(b, 4, (T)0.01);
+  T ax = decode<T>(b, 6, (T)0.001);
+  T az = decode<T>(b, 10, (T)0.001);
+  T dt = (T)0.01;
+  angle = (T)0.98 * (angle + gx * dt) + (T)0.02 * (ax / az) * (T)57.29578;
+  return angle + gz * dt;
+}
+
+template <typename T>
+static uint32_t benchPipeline() {
+  T angle = 0, out = 0;
+  uint32_t start = cyclesNow();
+  for (uint16_t i = 0; i < SAMPLES; i++) {
+    out += pipeline<T>(frames[i % FRAME_NUM], angle);
+  }
+  uint32_t cycles = cyclesNow() - start;
+  if (sizeof(T) == sizeof(float)) sinkF = out;
+  else sinkD = out;
+  return cycles / SAMPLES;
+}
+
+static uint32_t benchGetterFloat() {
+  float x, y, z, sum = 0;
+  uint32_t start = cyclesNow();
+  for (uint16_t i = 0; i < SAMPLES; i++) {
+    MiniR4.Motion.getGyro(x, y, z);
+    sum += x + y + z;
+  }
+  uint32_t cycles = cyclesNow() - start;
+  sinkF = sum;
+  return cycles / SAMPLES;
+}
+
+static uint32_t benchGetterDouble() {
+  double sum = 0;
+  uint32_t start = cyclesNow();
+  for (uint16_t i = 0; i < SAMPLES; i++) {
+    sum += MiniR4.Motion.getGyro(MiniR4Motion::AxisType::X) +
+           MiniR4.Motion.getGyro(MiniR4Motion::AxisType::Y) +
+           MiniR4.Motion.getGyro(MiniR4Motion::AxisType::Z);
+  }
+  uint32_t cycles = cyclesNow() - start;
+  sinkD = sum;
+  return cycles / SAMPLES;
+}
+
+static void report(const char* name, uint32_t cyclesF, uint32_t cyclesD) {
+  Serial.print(name);
+  Serial.print(": float ");
+  Serial.print(cyclesF);
+  Serial.print(" / double ");
+  Serial.print(cyclesD);
+  Serial.print(" cycles, x");
+  Serial.println((float)cyclesD / (cyclesF ? cyclesF : 1), 1);
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+  }
+  if (!MiniR4.begin()) {
+    Serial.println("Matrix Mini R4 init failed");
+    return;
+  }
+  mmL.Subscribe(MMLower::TELEMETRY::IMU, 10);
+  delay(100);
+  cyclesBegin();
+
+  Serial.println("IMU data path, cycles per sample");
+  report("decode+filter", benchPipeline<float>(), benchPipeline<double>());
+  report("getter", benchGetterFloat(), benchGetterDouble());
+}
+
+void loop() {}
@@ -0,0 +1,209 @@
+/**
+ * @file LinkBench.h
+ * @brief Round-trip latency benchmark of every MMLower command.
+ * @author MATRIX Robotics
+ *
+ * Shared by the zDEV_LinkBench sketch (real board) and extras/host/linkbench
+ * (host emulator or a lower board on a USB-UART adapter).
+ */
+#ifndef LINKBENCH_H
+#define LINKBENCH_H
+
+#include "Arduino.h"
+#include "Modules/MMLower.h"
+
+#include <stdlib.h>
+
+#ifndef LINKBENCH_MAX_ITER
+#    define LINKBENCH_MAX_ITER 200
+#endif
+#define LINKBENCH_SLOW_ITER 5   // iterations of commands that take ~1 s on the board
+#define LINKBENCH_DRIVE_ID  1
+
+typedef uint8_t (*LinkBenchFunc)(void);
+
+typedef struct
+{
+    const char*   name;
+    LinkBenchFunc run;   // returns a RESULT / Drive_RESULT, 0 = OK
+    bool          slow;
+} LinkBenchCmd_t;
+
+// clang-format off
+/**
+ * @brief One entry per COMM_CMD, through the public MMLower API.
+ *
+ * AUTO_SEND_* only flow from the lower board and are not listed. Arguments
+ * are chosen to leave the robot standing still (power 0, async drive tasks).
+ */
+static const LinkBenchCmd_t linkBenchCmds[] = {
+    // Setting-Init
+    {"SET_DC_MOTOR_DIR",          [] { return (uint8_t)mmL.SetDCMotorDir(1, MMLower::DIR::FORWARD); }, false},
+    {"SET_ENCODER_DIR",           [] { return (uint8_t)mmL.SetEncoderDir(1, MMLower::DIR::FORWARD); }, false},
+    {"SET_SERVO_DIR",             [] { return (uint8_t)mmL.SetServoDir(1, MMLower::DIR::FORWARD); }, false},
+    {"SET_DC_MOTOR_SPEED_RANGE",  [] { return (uint8_t)mmL.SetDCMotorSpeedRange(1, 0, 100); }, false},
+    {"SET_SERVO_PULSE_RANGE",     [] { return (uint8_t)mmL.SetServoPulseRange(1, 500, 2500); }, false},
+    {"SET_SERVO_ANGLE_RANGE",     [] { return (uint8_t)mmL.SetServoAngleRange(1, 0, 180); }, false},
+    {"SET_BUTTON_INIT",           [] { return (uint8_t)mmL.SetButtonEchoMode(MMLower::BUTTON_ECHO_MODE::PASSIVE); }, false},
+    {"SET_ENCODER_ECHO_MODE",     [] { return (uint8_t)mmL.SetEncoderEchoMode(MMLower::ENCODER_ECHO_MODE::PASSIVE, 0); }, false},
+    {"SET_IMU_ECHO_MODE",         [] { return (uint8_t)mmL.SetIMUEchoMode(MMLower::IMU_ECHO_MODE::PASSIVE, 0); }, false},
+    {"SET_IMU_INIT",              [] { return (uint8_t)mmL.SetIMUInit(MMLower::IMU_ACC_FSR::_4G, MMLower::IMU_GYRO_FSR::_1000DPS, MMLower::IMU_ODR::_100_SPS, MMLower::IMU_FIFO::DISABLE); }, false},
+    {"SET_POWER_PARAM",           [] { return (uint8_t)mmL.SetPowerParam(8.4, 6.6, 7.0); }, false},
+    {"SET_ENCODER_PPR_MAXSPEED",  [] { return (uint8_t)mmL.SetEncode_PPR_MaxRPM(1, 1080, 250); }, false},
+    {"SET_ALL_ENCODER_PPR",       [] { uint16_t ppr[4] = {1080, 1080, 1080, 1080}; return (uint8_t)mmL.SetALL_Encode_PPR(ppr); }, false},
+    {"SET_TASK_ECHO_MODE",        [] { return (uint8_t)mmL.SetTaskEchoMode(MMLower::TASK_ECHO_MODE::ACTIVE); }, false},
+    // Setting-Commonly used
+    {"SET_DC_MOTOR_POWER",        [] { return (uint8_t)mmL.SetDCMotorPower(1, 0); }, false},
+    {"SET_DC_MOTOR_SPEED",        [] { return (uint8_t)mmL.SetDCMotorSpeed(1, 0); }, false},
+    {"SET_DC_MOTOR_ROTATE",       [] { return (uint8_t)mmL.SetDCMotorRotate(1, 0, 0); }, false},
+    {"SET_ALL_DC_MOTOR_SPEED",    [] { MMLower::Motors_Param_t p = {}; return (uint8_t)mmL.SetAllDCMotorSpeed(p); }, false},
+    {"SET_SERVO_ANGLE",           [] { return (uint8_t)mmL.SetServoAngle(1, 90); }, false},
+    {"SET_ALL_SERVO_ANGLE",       [] { return (uint8_t)mmL.SetAllServoAngle(90, 90, 90, 90); }, false},
+    {"SET_MOVE_DISTANCE",         [] { return (uint8_t)mmL.SetMoveDistance(MMLower::MOVE_TYPE::DIFF, MMLower::MOVE_ACTION::STOP, 0, 0); }, false},
+    {"SET_ENCODER_RESET_COUNTER", [] { return (uint8_t)mmL.SetEncoderResetCounter(1); }, false},
+    {"SET_STATE_LED",             [] { return (uint8_t)mmL.SetStateLED(0, 0x000000); }, false},
+    {"SET_IMU_TO_ZERO",           [] { return (uint8_t)mmL.SetIMUToZero(); }, true},
+    {"SET_PID_PARAM",             [] { return (uint8_t)mmL.SetPIDParam(1, 0, 1.0, 0.0, 0.0); }, false},
+    {"SET_DC_BRAKE",              [] { return (uint8_t)mmL.SetDCBrake(1); }, false},
+    {"SET_ALL_DC_BRAKE",          [] { return (uint8_t)mmL.SetALLDCBrake(); }, false},
+    {"SET_ALL_DC_MOTOR_POWER",    [] { MMLower::Motors_Param_t p = {}; return (uint8_t)mmL.SetAllDCMotorPower(p); }, false},
+    // Getting
+    {"GET_BUTTON_STATE",          [] { bool s; return (uint8_t)mmL.GetButtonState(1, s); }, false},
+    {"GET_BUTTONS_STATE",         [] { bool s[2]; return (uint8_t)mmL.GetButtonsState(s); }, false},
+    {"GET_ENCODER_COUNTER",       [] { int32_t c; return (uint8_t)mmL.GetEncoderCounter(1, c); }, false},
+    {"GET_ALL_ENCODER_COUNTER",   [] { int32_t c[4]; return (uint8_t)mmL.GetAllEncoderCounter(c); }, false},
+    {"GET_IMU_EULER",             [] { double x, y, z; return (uint8_t)mmL.GetIMUEuler(x, y, z); }, false},
+    {"GET_IMU_GYRO",              [] { double x, y, z; return (uint8_t)mmL.GetIMUGyro(x, y, z); }, false},
+    {"GET_IMU_ACC",               [] { double x, y, z; return (uint8_t)mmL.GetIMUAcc(x, y, z); }, false},
+    {"GET_POWER_INFO",            [] { float v, p; return (uint8_t)mmL.GetPowerInfo(v, p); }, false},
+    {"GET_ROTATE_STATE",          [] { bool e; return (uint8_t)mmL.GetRotateState(1, e); }, false},
+    {"GET_SPEED_ALL_DC_MOTOR",    [] { int32_t s[4]; return (uint8_t)mmL.GetALLEncoderSpeed(s); }, false},
+    {"GET_IMU_ACC_NOcal",         [] { float a[3]; return (uint8_t)mmL.Get_IMU_nancalib_acc(a); }, false},
+    {"GET_ENCODER_DEGREES",       [] { int32_t d; return (uint8_t)mmL.GetEncoderDegrees(1, d); }, false},
+    // Drive DC
+    {"SET_DC_BRAKE_TYPE",         [] { return (uint8_t)mmL.SetDC_Type_Brake(1, 1); }, false},
+    {"SET_DC_ALL_BRAKE_TYPE",     [] { uint8_t t[4] = {1, 1, 1, 1}; return (uint8_t)mmL.SetALLDC_Type_Brake(t); }, false},
+    {"SET_DC_TWO_MOTOR_PARAM",    [] { return (uint8_t)mmL.Set_Drive2Motor_PARAM(1, 2, MMLower::DIR::FORWARD, MMLower::DIR::FORWARD, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_DC_TWO_MoveSync_PID",   [] { return (uint8_t)mmL.Set_Drive_MoveSync_PID(1.0, 0.0, 0.0, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_DC_TWO_MoveGyro_PID",   [] { return (uint8_t)mmL.Set_Drive_MoveGyro_PID(1.0, 0.0, 0.0, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_DC_TWO_TurnGyro_PID",   [] { return (uint8_t)mmL.Set_Drive_MoveTurn_PID(1.0, 0.0, 0.0, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_DC_TWO_MOTOR_Reset_count", [] { return (uint8_t)mmL.Set_Drive_Reset_Count(LINKBENCH_DRIVE_ID, true); }, false},
+    {"SET_DC_TWO_MOTOR_PPR",      [] { uint16_t ppr[2] = {1080, 1080}; return (uint8_t)mmL.Set_Drive_Encode_PPR(LINKBENCH_DRIVE_ID, ppr); }, false},
+    {"SET_DC_MOTOR_TYPE",         [] { return (uint8_t)mmL.Set_Drive_Motor_Type(LINKBENCH_DRIVE_ID, 0); }, false},
+    {"SET_Drive_Move",            [] { return (uint8_t)mmL.Set_Drive_Move_Func(0, 0, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_Drive_MoveDegs",        [] { return (uint8_t)mmL.Set_Drive_Move_Degs(0, 0, 0, true, true, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_Drive_MoveTime",        [] { return (uint8_t)mmL.Set_Drive_Move_Time(0, 0, 0, true, true, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_Drive_MoveSync",        [] { return (uint8_t)mmL.Set_Drive_MoveSync_Func(0, 0, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_Drive_MoveSyncDegs",    [] { return (uint8_t)mmL.Set_Drive_MoveSync_Degs(0, 0, 0, true, true, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_Drive_MoveSyncTime",    [] { return (uint8_t)mmL.Set_Drive_MoveSync_Time(0, 0, 0, true, true, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_Drive_Gyro",            [] { return (uint8_t)mmL.Set_Drive_MoveGyro_Func(0, 0, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_Drive_GyroDegs",        [] { return (uint8_t)mmL.Set_Drive_MoveGyro_Degs(0, 0, 0, true, true, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_Drive_GyroTime",        [] { return (uint8_t)mmL.Set_Drive_MoveGyro_Time(0, 0, 0, true, true, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_Drive_Turn",            [] { return (uint8_t)mmL.Set_Drive_TurnGyro(0, 0, 1, true, true, LINKBENCH_DRIVE_ID); }, false},
+    {"SET_Drive_Brake",           [] { return (uint8_t)mmL.Set_Drive_Brake(true, LINKBENCH_DRIVE_ID); }, false},
+    {"GET_Task_Done_Status",      [] { bool e[2]; return (uint8_t)mmL.Get_Drive_isTaskDone(LINKBENCH_DRIVE_ID, e); }, false},
+    {"GET_Drive_Degress",         [] { int32_t d; return (uint8_t)mmL.Get_Drive_Degrees(LINKBENCH_DRIVE_ID, d); }, false},
+    {"GET_Drive_Counter",         [] { int32_t c; return (uint8_t)mmL.Get_Drive_EncoderCounter(LINKBENCH_DRIVE_ID, c); }, false},
+    // Other-Info
+    {"ECHO_TEST",                 [] { return (uint8_t)mmL.EchoTest(); }, false},
+    {"F_VERSION",                 [] { String s; return (uint8_t)mmL.GetFWVersion(s); }, false},
+    {"F_BUILD_DAY",               [] { String s; return (uint8_t)mmL.GetFWBuildDay(s); }, false},
+    {"F_DESCRIPTOR",              [] { String s; return (uint8_t)mmL.GetFWDescriptor(s); }, false},
+    {"READ_MODEL_INDEX",          [] { uint8_t i; return (uint8_t)mmL.GetModelIndex(i); }, false},
+    {"READ_ALL_INFO",             [] { MMLower::AllInfo_t i; return (uint8_t)mmL.GetAllInfo(i); }, false},
+    {"RUN_AUTO_QC",               [] { return (uint8_t)mmL.RunAutoQC(); }, true},
+    {"SET_COMM_FRAMING",          [] { return (uint8_t)mmL.SetCommFraming(mmL.isFramed()); }, false},
+    {"SET_COMM_TIMESTAMP",        [] { return (uint8_t)mmL.SetCommTimestamp(mmL.isTimestamped()); }, false},
+    {"GET_PROFILE_HASH",          [] { uint32_t h; return (uint8_t)mmL.GetProfileHash(h); }, false},
+    {"SET_PROFILE",               [] { return (uint8_t)mmL.ApplyProfile(MMLowerProfile().EncoderPPR(1, 1080, 250), true); }, false},
+    {"GET_SNAPSHOT",              [] { MMLower::Snapshot_t s; return (uint8_t)mmL.GetSnapshot(s); }, false},
+    {"GET_SAMPLE",                [] { int32_t s[4]; return (uint8_t)mmL.GetALLEncoderSpeed(s, mmL.GetSampleSeq(MMLower::SENSOR::SPEED) - 1); }, false},
+    {"SET_BATCH",                 [] { mmL.BatchDCMotorPower(1, 0); mmL.BatchServoAngle(1, 90); return (uint8_t)mmL.BatchFlush(); }, false},
+};
+// clang-format on
+
+/**
+ * @brief Runs each command N times and prints min / median / p99 / max
+ * round-trip time in microseconds plus the sustained commands per second.
+ *
+ * SET_Drive_MoveSyncDegsACC has no MMLower API and SET_COMM_BAUDRATE changes
+ * the link under test, neither is measured.
+ */
+class LinkBench
+{
+public:
+    LinkBench(Print& out, uint16_t iterations)
+        : _out(out)
+        , _iterations(min(iterations, (uint16_t)LINKBENCH_MAX_ITER))
+    {}
+
+    void RunAll(void)
+    {
+        _out.println(F("command                        ok/n      min      med      p99      max    cmd/s"));
+        uint32_t total = 0, count = 0, start = micros();
+        for (const LinkBenchCmd_t& cmd : linkBenchCmds) {
+            count += Run(cmd);
+        }
+        total = micros() - start;
+        _out.print(F("total: "));
+        _out.print(count);
+        _out.print(F(" commands, "));
+        _out.print(count * 1000000.0 / total, 1);
+        _out.println(F(" cmd/s"));
+    }
+
+    uint16_t Run(const LinkBenchCmd_t& cmd)
+    {
+        uint16_t n  = cmd.slow ? min(_iterations, (uint16_t)LINKBENCH_SLOW_ITER) : _iterations;
+        uint16_t ok = 0;
+
+        uint32_t start = micros();
+        for (uint16_t i = 0; i < n; i++) {
+            uint32_t t = micros();
+            if (cmd.run() == 0) ok++;
+            _samples[i] = micros() - t;
+        }
+        uint32_t elapsed = micros() - start;
+        qsort(_samples, n, sizeof(_samples[0]), Compare);
+
+        PrintField(cmd.name, 28, true);
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u/%u", ok, n);
+        PrintField(buf, 9, false);
+        PrintNumber(_samples[0]);
+        PrintNumber(_samples[n / 2]);
+        PrintNumber(_samples[(n * 99 + 99) / 100 - 1]);
+        PrintNumber(_samples[n - 1]);
+        PrintNumber((uint32_t)(n * 1000000.0 / elapsed));
+        _out.println();
+        return n;
+    }
+
+private:
+    Print&   _out;
+    uint16_t _iterations;
+    uint32_t _samples[LINKBENCH_MAX_ITER];
+
+    static int Compare(const void* a, const void* b)
+    {
+        uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+        return (x > y) - (x < y);
+    }
+
+    void PrintField(const char* str, uint8_t width, bool left)
+    {
+        uint8_t len = strlen(str);
+        if (left) _out.print(str);
+        for (uint8_t i = len; i < width; i++) _out.print(' ');
+        if (!left) _out.print(str);
+    }
+
+    void PrintNumber(uint32_t value)
+    {
+        char buf[12];
+        snprintf(buf, sizeof(buf), "%lu", (unsigned long)value);
+        PrintField(buf, 9, false);
+    }
+};
+
+#endif   // LINKBENCH_H
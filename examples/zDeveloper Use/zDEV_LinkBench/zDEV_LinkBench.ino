@@ -0,0 +1,34 @@
+/*
+  Matrix Mini R4 link benchmark
+
+  Measures the round-trip time of every command between the R4 and the
+  lower MCU. Keep the robot on a stand, the motor / drive commands are sent
+  with power 0 but the board still acts on them.
+
+  The same benchmark runs on a PC against the host emulator, see
+  extras/host (make bench).
+*/
+#include <MatrixMiniR4.h>
+
+#include "LinkBench.h"
+
+#define ITERATIONS 100
+
+void setup(void)
+{
+    Serial.begin(115200);
+    while (!Serial) {
+    }
+
+    if (!MiniR4.begin()) {
+        Serial.println("Matrix Mini R4 init failed");
+        return;
+    }
+    Serial.print("framed: ");
+    Serial.println(mmL.isFramed());
+
+    LinkBench bench(Serial, ITERATIONS);
+    bench.RunAll();
+}
+
+void loop(void) {}
@@ -0,0 +1,95 @@
+/**
+ * @file MMLowerHostTransport.cpp
+ * @brief MMLower transport over a Linux file descriptor (socketpair or pty).
+ * @author MATRIX Robotics
+ */
+#include "MMLowerHostTransport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+MMLowerHostTransport::MMLowerHostTransport(int fd)
+    : _fd(fd)
+    , _baudrate(0)
+    , _head(0)
+    , _tail(0)
+{
+    fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+}
+
+MMLowerHostTransport::~MMLowerHostTransport()
+{
+    if (_fd >= 0) close(_fd);
+}
+
+bool MMLowerHostTransport::CreateSocketPair(int fds[2])
+{
+    return (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+}
+
+/**
+ * @brief Open a pty master, the slave path is returned in slaveName.
+ *
+ * @return The master fd, or -1 on failure.
+ */
+int MMLowerHostTransport::OpenPty(char* slaveName, size_t size)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0) return -1;
+    if (grantpt(fd) != 0 || unlockpt(fd) != 0 || ptsname_r(fd, slaveName, size) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void MMLowerHostTransport::begin(uint32_t baudrate)
+{
+    _baudrate = baudrate;
+}
+
+int MMLowerHostTransport::available(void)
+{
+    Fill();
+    return _tail - _head;
+}
+
+int MMLowerHostTransport::read(void)
+{
+    if (_head == _tail) Fill();
+    if (_head == _tail) return -1;
+    return _buf[_head++];
+}
+
+/**
+ * @brief Non-blocking, returns what the fd took; MMLower's TxPump() sends the rest later.
+ */
+size_t MMLowerHostTransport::write(const uint8_t* data, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::write(_fd, data + done, size - done);
+        if (n > 0) {
+            done += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break;
+        }
+    }
+    return done;
+}
+
+void MMLowerHostTransport::Fill(void)
+{
+    if (_head == _tail) {
+        _head = 0;
+        _tail = 0;
+    }
+    if (_tail >= sizeof(_buf)) return;
+
+    ssize_t n = ::read(_fd, _buf + _tail, sizeof(_buf) - _tail);
+    if (n > 0) _tail += n;
+}
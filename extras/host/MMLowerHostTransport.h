@@ -0,0 +1,46 @@
+/**
+ * @file MMLowerHostTransport.h
+ * @brief MMLower transport over a Linux file descriptor (socketpair or pty).
+ * @author MATRIX Robotics
+ */
+#ifndef MMLOWERHOSTTRANSPORT_H
+#define MMLOWERHOSTTRANSPORT_H
+
+#include "MMLowerTransport.h"
+
+/**
+ * @brief Carries the MMLower protocol over a host file descriptor.
+ *
+ * Use a socketpair to connect MMLower to an in-process or forked lower board
+ * stand-in, or a pty to talk to any program that opens the slave side.
+ */
+class MMLowerHostTransport : public MMLowerTransport
+{
+public:
+    explicit MMLowerHostTransport(int fd);
+    ~MMLowerHostTransport();
+
+    static bool CreateSocketPair(int fds[2]);
+    static int  OpenPty(char* slaveName, size_t size);
+
+    void   begin(uint32_t baudrate) override;
+    void   end(void) override {}
+    int    available(void) override;
+    int    read(void) override;
+    size_t write(const uint8_t* data, size_t size) override;
+    void   flush(void) override {}
+
+    int      fd(void) { return _fd; }
+    uint32_t baudrate(void) { return _baudrate; }
+
+private:
+    int      _fd;
+    uint32_t _baudrate;
+    uint8_t  _buf[256];
+    uint16_t _head;
+    uint16_t _tail;
+
+    void Fill(void);
+};
+
+#endif   // MMLOWERHOSTTRANSPORT_H
@@ -0,0 +1,167 @@
+/**
+ * @file MMLowerReplayTransport.cpp
+ * @brief MMLower transport that plays back a link capture.
+ * @author MATRIX Robotics
+ */
+#include "MMLowerReplayTransport.h"
+#include "MMLowerCapture.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+static bool GetVarint(const uint8_t* data, size_t size, size_t& pos, uint64_t& value)
+{
+    value         = 0;
+    uint8_t shift = 0;
+    while (pos < size && shift < 64) {
+        uint8_t b = data[pos++];
+        value |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) return true;
+        shift += 7;
+    }
+    return false;
+}
+
+MMLowerReplayTransport::MMLowerReplayTransport()
+    : _inPos(0)
+    , _rxNext(0)
+    , _txDone(0)
+    , _txMismatch(0)
+    , _firstMismatch(-1)
+    , _txExtra(0)
+    , _started(false)
+    , _baseUs(0)
+{}
+
+bool MMLowerReplayTransport::Load(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return false;
+
+    std::vector<uint8_t> data;
+    uint8_t              chunk[4096];
+    size_t               n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(f);
+    return Load(data.data(), data.size());
+}
+
+/**
+ * @brief Parse a capture stream and switch the shim to the virtual clock.
+ */
+bool MMLowerReplayTransport::Load(const uint8_t* data, size_t size)
+{
+    if (size < 5 || memcmp(data, MR4_CAPTURE_MAGIC, 4) != 0) return false;
+    if (data[4] != MR4_CAPTURE_VERSION) return false;
+
+    _rx.clear();
+    _txMarks.clear();
+    _tx.clear();
+    uint64_t us  = 0;
+    size_t   pos = 5;
+    while (pos < size) {
+        uint8_t  flags = data[pos++];
+        uint64_t dt, len;
+        if (!GetVarint(data, size, pos, dt) || !GetVarint(data, size, pos, len)) return false;
+        if (pos + len > size) return false;
+
+        us += dt;
+        if (flags & MR4_CAPTURE_F_RX) {
+            RxRecord_t r;
+            r.us       = us;
+            r.txBefore = _tx.size();
+            r.bytes.assign(data + pos, data + pos + len);
+            _rx.push_back(r);
+        } else {
+            _txMarks.push_back({us, _tx.size()});
+            _tx.insert(_tx.end(), data + pos, data + pos + len);
+        }
+        pos += len;
+    }
+
+    _in.clear();
+    _inPos         = 0;
+    _rxNext        = 0;
+    _txDone        = 0;
+    _txMismatch    = 0;
+    _firstMismatch = -1;
+    _txExtra       = 0;
+    _started       = false;
+    HostClockVirtual(true);
+    return true;
+}
+
+int MMLowerReplayTransport::available(void)
+{
+    Start();
+    if (_inPos >= _in.size() && !Deliver()) return 0;
+    return (int)(_in.size() - _inPos);
+}
+
+int MMLowerReplayTransport::read(void)
+{
+    if (available() <= 0) return -1;
+    return _in[_inPos++];
+}
+
+size_t MMLowerReplayTransport::write(const uint8_t* data, size_t size)
+{
+    Start();
+    for (size_t i = 0; i < size; i++, _txDone++) {
+        if (_txDone >= _tx.size()) {
+            _txExtra++;
+        } else if (_tx[_txDone] != data[i]) {
+            if (_txMismatch++ == 0) _firstMismatch = (int64_t)_txDone;
+        }
+    }
+    return size;
+}
+
+/**
+ * @brief Every recorded frame was played and every recorded byte was sent.
+ */
+bool MMLowerReplayTransport::IsDone(void)
+{
+    return (_rxNext >= _rx.size() && _inPos >= _in.size() && _txDone >= _tx.size());
+}
+
+// The capture time origin is the first time MMLower touches the link.
+void MMLowerReplayTransport::Start(void)
+{
+    if (_started) return;
+    _started = true;
+    _baseUs  = HostClockUs();
+}
+
+bool MMLowerReplayTransport::Deliver(void)
+{
+    _in.clear();
+    _inPos = 0;
+
+    if (_rxNext < _rx.size() && _txDone >= _rx[_rxNext].txBefore) {
+        RxRecord_t& r = _rx[_rxNext++];
+        HostClockAdvanceTo(_baseUs + r.us);
+        _in.swap(r.bytes);
+        return true;
+    }
+
+    // Nothing may arrive before MMLower sends more. Let time run up to when
+    // it did send in the capture, so its timeouts expire as they did then.
+    uint64_t now  = HostClockUs();
+    uint64_t next = NextTxUs();
+    HostClockAdvanceTo((next > now) ? next : now + MMLOWER_REPLAY_IDLE_US);
+    return false;
+}
+
+// Capture time (on the replay clock) of the next TX byte, 0 past the end.
+uint64_t MMLowerReplayTransport::NextTxUs(void)
+{
+    if (_txDone >= _tx.size()) return 0;
+
+    auto it = std::upper_bound(
+        _txMarks.begin(), _txMarks.end(), _txDone,
+        [](size_t offset, const TxMark_t& mark) { return offset < mark.offset; });
+    return _baseUs + (it - 1)->us;
+}
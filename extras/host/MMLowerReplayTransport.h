@@ -0,0 +1,79 @@
+/**
+ * @file MMLowerReplayTransport.h
+ * @brief MMLower transport that plays back a link capture.
+ * @author MATRIX Robotics
+ */
+#ifndef MMLOWERREPLAYTRANSPORT_H
+#define MMLOWERREPLAYTRANSPORT_H
+
+#include "MMLowerTransport.h"
+
+#include <vector>
+
+#define MMLOWER_REPLAY_IDLE_US 100
+
+/**
+ * @brief Feeds the RX side of an MMLowerCapture stream back into MMLower
+ * and checks what MMLower sends against the recorded TX side.
+ *
+ * Runs on the shim's virtual clock (HostClockVirtual() is switched on by
+ * Load()). Whenever MMLower polls an empty receive buffer the clock jumps
+ * to the next recorded RX frame, but never before MMLower has sent every
+ * byte that preceded that frame in the capture. A replay is therefore
+ * deterministic, as fast as the CPU allows, and timeouts, latencies and
+ * parsing happen exactly as recorded.
+ */
+class MMLowerReplayTransport : public MMLowerTransport
+{
+public:
+    MMLowerReplayTransport();
+
+    bool Load(const char* path);
+    bool Load(const uint8_t* data, size_t size);
+
+    void   begin(uint32_t baudrate) override {}
+    void   end(void) override {}
+    int    available(void) override;
+    int    read(void) override;
+    size_t write(const uint8_t* data, size_t size) override;
+    void   flush(void) override {}
+
+    bool     IsDone(void);
+    size_t   GetRecordCount(void) { return _rx.size(); }
+    uint32_t GetTxMismatch(void) { return _txMismatch; }
+    int64_t  GetFirstMismatch(void) { return _firstMismatch; }
+    uint32_t GetTxExtra(void) { return _txExtra; }
+
+private:
+    typedef struct
+    {
+        uint64_t             us;         // since the first record
+        size_t               txBefore;   // TX bytes recorded ahead of this frame
+        std::vector<uint8_t> bytes;
+    } RxRecord_t;
+
+    typedef struct
+    {
+        uint64_t us;
+        size_t   offset;   // into _tx
+    } TxMark_t;
+
+    std::vector<RxRecord_t> _rx;
+    std::vector<TxMark_t>   _txMarks;
+    std::vector<uint8_t>    _tx;
+    std::vector<uint8_t>    _in;
+    size_t                  _inPos;
+    size_t                  _rxNext;
+    size_t                  _txDone;
+    uint32_t                _txMismatch;
+    int64_t                 _firstMismatch;
+    uint32_t                _txExtra;
+    bool                    _started;
+    uint64_t                _baseUs;
+
+    void     Start(void);
+    bool     Deliver(void);
+    uint64_t NextTxUs(void);
+};
+
+#endif   // MMLOWERREPLAYTRANSPORT_H
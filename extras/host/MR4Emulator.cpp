@@ -0,0 +1,1454 @@
+/**
+ * @file MR4Emulator.cpp
+ * @brief Host stand-in for the lower MCU (STM32) of the Matrix Mini R4.
+ * @author MATRIX Robotics
+ */
+#include "MR4Emulator.h"
+
+#include "MMLower.h"
+#include "Util/BitConverter.h"
+#include "Util/CRC16.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef MMLower::COMM_CMD CMD;
+
+#define MR4EMU_FW_VERSION     12   // shown as "1.20"
+#define MR4EMU_BUILD_YEAR     2025
+#define MR4EMU_BUILD_MONTH    7
+#define MR4EMU_BUILD_DAY      15
+#define MR4EMU_MODEL_INDEX    1
+#define MR4EMU_DESCRIPTOR     "MiniR4 host emulator"
+#define MR4EMU_TURN_RATE      180.0   // deg/s of the robot at full differential power
+#define MR4EMU_LEGACY_IDLE_US 2000    // gap that ends a legacy EchoTest seen while framed
+
+//--------------------------------------------------------------//
+//  Request sizes  //
+//--------------------------------------------------------------//
+// The legacy protocol has no length field, the payload size is implied by
+// the command. Kept separate from MMLower's own table on purpose, so a wrong
+// entry there shows up as a link error here.
+typedef struct
+{
+    CMD     cmd;
+    uint8_t requestSize;
+} EmuCmd_t;
+
+// clang-format off
+static const EmuCmd_t emuCmds[] = {
+    {CMD::SET_DC_MOTOR_DIR,              2}, {CMD::SET_ENCODER_DIR,            2},
+    {CMD::SET_SERVO_DIR,                 2}, {CMD::SET_DC_MOTOR_SPEED_RANGE,   5},
+    {CMD::SET_SERVO_PULSE_RANGE,         5}, {CMD::SET_SERVO_ANGLE_RANGE,      5},
+    {CMD::SET_BUTTON_INIT,               1}, {CMD::SET_ENCODER_ECHO_MODE,      3},
+    {CMD::SET_IMU_ECHO_MODE,             3}, {CMD::SET_IMU_INIT,               4},
+    {CMD::SET_POWER_PARAM,               3}, {CMD::SET_ENCODER_PPR_MAXSPEED,   6},
+    {CMD::SET_ALL_ENCODER_PPR,          10}, {CMD::SET_IMU_Calib_Data,        26},
+    {CMD::SET_TASK_ECHO_MODE,            1},
+    {CMD::SET_DC_MOTOR_POWER,            4}, {CMD::SET_DC_MOTOR_SPEED,         4},
+    {CMD::SET_DC_MOTOR_ROTATE,           5}, {CMD::SET_ALL_DC_MOTOR_SPEED,    10},
+    {CMD::SET_SERVO_ANGLE,               3}, {CMD::SET_ALL_SERVO_ANGLE,        8},
+    {CMD::SET_MOVE_DISTANCE,             6}, {CMD::SET_ENCODER_RESET_COUNTER,  1},
+    {CMD::SET_STATE_LED,                 4}, {CMD::SET_IMU_TO_ZERO,            0},
+    {CMD::SET_PID_PARAM,                 8}, {CMD::SET_DC_BRAKE,               1},
+    {CMD::SET_ALL_DC_BRAKE,              1}, {CMD::SET_ALL_DC_MOTOR_POWER,    10},
+    {CMD::GET_BUTTON_STATE,              1}, {CMD::GET_BUTTONS_STATE,          0},
+    {CMD::GET_ENCODER_COUNTER,           1}, {CMD::GET_ALL_ENCODER_COUNTER,    0},
+    {CMD::GET_IMU_EULER,                 0}, {CMD::GET_IMU_GYRO,               0},
+    {CMD::GET_IMU_ACC,                   0}, {CMD::GET_POWER_INFO,             0},
+    {CMD::GET_ROTATE_STATE,              1}, {CMD::GET_SPEED_ALL_DC_MOTOR,     0},
+    {CMD::GET_IMU_ACC_NOcal,             0}, {CMD::GET_ENCODER_DEGREES,        1},
+    {CMD::SET_DC_BRAKE_TYPE,             2}, {CMD::SET_DC_ALL_BRAKE_TYPE,      5},
+    {CMD::SET_DC_TWO_MOTOR_PARAM,        5}, {CMD::SET_DC_TWO_MoveSync_PID,   13},
+    {CMD::SET_DC_TWO_MoveGyro_PID,      13}, {CMD::SET_DC_TWO_TurnGyro_PID,   13},
+    {CMD::SET_DC_TWO_MOTOR_Reset_count,  2}, {CMD::SET_DC_TWO_MOTOR_PPR,       5},
+    {CMD::SET_DC_MOTOR_TYPE,             2}, {CMD::SET_Drive_Move,             5},
+    {CMD::SET_Drive_MoveDegs,            9}, {CMD::SET_Drive_MoveTime,        11},
+    {CMD::SET_Drive_MoveSync,            5}, {CMD::SET_Drive_MoveSyncDegs,     9},
+    {CMD::SET_Drive_MoveSyncDegsACC,     9}, {CMD::SET_Drive_MoveSyncTime,    11},
+    {CMD::SET_Drive_Gyro,                5}, {CMD::SET_Drive_GyroDegs,         9},
+    {CMD::SET_Drive_GyroTime,           11}, {CMD::SET_Drive_Turn,             8},
+    {CMD::SET_Drive_Brake,               2}, {CMD::GET_Task_Done_Status,       2},
+    {CMD::GET_Drive_Degress,             1}, {CMD::GET_Drive_Counter,          1},
+    {CMD::ECHO_TEST,                     1}, {CMD::F_VERSION,                  0},
+    {CMD::F_BUILD_DAY,                   0}, {CMD::F_DESCRIPTOR,               0},
+    {CMD::READ_MODEL_INDEX,              0}, {CMD::READ_ALL_INFO,              0},
+    {CMD::RUN_AUTO_QC,                   0}, {CMD::SET_COMM_FRAMING,           1},
+    {CMD::SET_COMM_BAUDRATE,             4}, {CMD::SET_COMM_TIMESTAMP,         1},
+    {CMD::GET_PROFILE_HASH,              0}, {CMD::SET_PROFILE,              178},
+    {CMD::GET_SNAPSHOT,                  2}, {CMD::GET_SAMPLE,                 3},
+    {CMD::SET_BATCH,                    18},
+};
+// clang-format on
+
+static int RequestSize(uint8_t cmd)
+{
+    for (const EmuCmd_t& c : emuCmds) {
+        if ((uint8_t)c.cmd == cmd) return c.requestSize;
+    }
+    return -1;
+}
+
+static uint64_t NowUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int16_t Clamp16(double value)
+{
+    if (value > 32767) return 32767;
+    if (value < -32768) return -32768;
+    return (int16_t)lround(value);
+}
+
+//--------------------------------------------------------------//
+//  Public API  //
+//--------------------------------------------------------------//
+MR4Emulator::MR4Emulator(int fd)
+    : _fd(fd)
+    , _running(false)
+    , _txFreeUs(0)
+    , _rxLen(0)
+    , _framed(false)
+    , _framingSupport(true)
+    , _stamped(false)
+    , _baudrate(57600)
+    , _latencyUs(0)
+    , _baudTiming(false)
+    , _lossPermille(0)
+    , _lossSeed(1)
+    , _lost(0)
+    , _profileHash(0)
+    , _rxSeq(0)
+    , _requests(0)
+    , _errors(0)
+    , _tickOffsetUs(0)
+    , _tickDriftPpm(0)
+    , _roll(0)
+    , _pitch(0)
+    , _yaw(0)
+    , _yawRate(0)
+    , _battMilliVolt(8000)
+    , _fullVolt(84)
+    , _cutOffVolt(66)
+    , _alarmVolt(70)
+    , _btnMode(0)
+    , _encMode(0)
+    , _imuMode(0)
+    , _encIntervalMs(0)
+    , _imuIntervalMs(0)
+    , _encNextUs(0)
+    , _imuNextUs(0)
+    , _taskMode(0)
+    , _rotating(0)
+    , _driving(0)
+{
+    fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+
+    for (Motor_t& m : _motor) {
+        m.motorReverse   = false;
+        m.encoderReverse = false;
+        m.power          = 0;
+        m.count          = 0;
+        m.ppr            = 1080;
+        m.maxRPM         = 250;
+        m.speedMin       = 0;
+        m.speedMax       = 100;
+        m.rotateLeft     = -1;
+    }
+    for (Drive_t& d : _drive) {
+        memset(&d, 0, sizeof(d));
+    }
+    for (uint8_t i = 0; i < MR4EMU_SERVO_NUM; i++) {
+        _servoAngle[i] = 0;
+        _servoMin[i]   = 0;
+        _servoMax[i]   = 180;
+    }
+    for (bool& b : _btn) {
+        b = false;
+    }
+    _lastStepUs = _lastRxUs = _tickBaseUs = NowUs();
+}
+
+MR4Emulator::~MR4Emulator()
+{
+    Stop();
+    if (_fd >= 0) close(_fd);
+}
+
+/**
+ * @brief Serve the link from a background thread until Stop().
+ */
+bool MR4Emulator::Start(void)
+{
+    if (_running) return false;
+    _running = true;
+    _thread  = std::thread(&MR4Emulator::Run, this);
+    return true;
+}
+
+void MR4Emulator::Stop(void)
+{
+    _running = false;
+    if (_thread.joinable()) _thread.join();
+}
+
+void MR4Emulator::Run(void)
+{
+    while (_running) {
+        Poll(1000);
+    }
+}
+
+/**
+ * @brief Wait up to waitUs for link activity, then serve requests, advance
+ * the simulation and send the replies that are due.
+ */
+void MR4Emulator::Poll(uint32_t waitUs)
+{
+    uint64_t now = NowUs();
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (!_txQueue.empty()) {
+            uint64_t due = _txQueue.front().dueUs;
+            waitUs       = (due <= now) ? 0 : (uint32_t)std::min<uint64_t>(waitUs, due - now);
+        }
+    }
+
+    struct pollfd   pfd = {_fd, POLLIN, 0};
+    struct timespec ts  = {(time_t)(waitUs / 1000000), (long)(waitUs % 1000000) * 1000L};
+    ppoll(&pfd, 1, &ts, NULL);
+
+    std::lock_guard<std::mutex> guard(_lock);
+    now = NowUs();
+    if (pfd.revents & POLLIN) ReadLink();
+    if (_framed && _rxLen == 4 && now - _lastRxUs > MR4EMU_LEGACY_IDLE_US) {
+        // MMLower::Init() always starts with a legacy EchoTest, a host that
+        // restarted talks legacy to a board that is still framed.
+        static const uint8_t echo[4] = {
+            MatrixR4_COMM_LEAD, (~MatrixR4_COMM_LEAD) & 0xFF, (uint8_t)CMD::ECHO_TEST, 0x55};
+        if (memcmp(_rx, echo, 4) == 0) {
+            _framed  = false;
+            _stamped = false;
+            ParseLegacy();
+        }
+    }
+    now = NowUs();
+    Step(now);
+    SendTaskDone();
+    SendTelemetry(now);
+    FlushDue(now);
+}
+
+void MR4Emulator::SetLatency(uint32_t latencyUs)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _latencyUs = latencyUs;
+}
+
+/**
+ * @brief Drop this share of the replies and auto-send frames, as if they
+ * were lost on the wire. Repeatable: the same run loses the same frames.
+ */
+void MR4Emulator::SetReplyLoss(uint16_t permille)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _lossPermille = permille;
+    _lossSeed     = 1;
+}
+
+/**
+ * @brief Add 10 bit times per byte at the link baud rate to every reply.
+ */
+void MR4Emulator::SetBaudTiming(bool enable)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _baudTiming = enable;
+}
+
+/**
+ * @brief With false the emulator behaves like firmware that predates
+ * SET_COMM_FRAMING / SET_COMM_BAUDRATE and never answers them.
+ */
+void MR4Emulator::SetFramingSupport(bool enable)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _framingSupport = enable;
+}
+
+/**
+ * @brief Make the board tick run offsetUs ahead of the emulator start and
+ * driftPpm faster than the host clock.
+ */
+void MR4Emulator::SetClock(uint32_t offsetUs, int32_t driftPpm)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _tickOffsetUs = offsetUs;
+    _tickDriftPpm = driftPpm;
+}
+
+void MR4Emulator::SetButton(uint8_t num, bool pressed)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (num < 1 || num > MR4EMU_BUTTON_NUM || _btn[num - 1] == pressed) return;
+    _btn[num - 1] = pressed;
+    if (_btnMode == (uint8_t)MMLower::BUTTON_ECHO_MODE::ACTIVE) {
+        SendButton(num - 1, (uint8_t)(pressed ? MMLower::BTN_STATE::F_EDGE : MMLower::BTN_STATE::R_EDGE));
+    }
+}
+
+void MR4Emulator::SetBatteryVolt(float volt)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _battMilliVolt = (uint16_t)(volt * 1000.0f);
+}
+
+void MR4Emulator::SetIMUTilt(float roll, float pitch)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    _roll  = roll;
+    _pitch = pitch;
+}
+
+int16_t MR4Emulator::GetMotorPower(uint8_t num)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (num < 1 || num > MR4EMU_DC_MOTOR_NUM) return 0;
+    return _motor[num - 1].power;
+}
+
+int32_t MR4Emulator::GetEncoderCounter(uint8_t num)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (num < 1 || num > MR4EMU_DC_MOTOR_NUM) return 0;
+    return (int32_t)_motor[num - 1].count;
+}
+
+uint16_t MR4Emulator::GetServoAngle(uint8_t num)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (num < 1 || num > MR4EMU_SERVO_NUM) return 0;
+    return _servoAngle[num - 1];
+}
+
+float MR4Emulator::GetYaw(void)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return (float)_yaw;
+}
+
+bool MR4Emulator::IsFramed(void)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _framed;
+}
+
+bool MR4Emulator::IsTimestamped(void)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _stamped;
+}
+
+/**
+ * @brief The board tick right now.
+ */
+uint32_t MR4Emulator::GetTick(void)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return Tick(NowUs());
+}
+
+uint32_t MR4Emulator::Tick(uint64_t now)
+{
+    int64_t elapsed = (int64_t)(now - _tickBaseUs);
+    return (uint32_t)(elapsed + elapsed * _tickDriftPpm / 1000000 + _tickOffsetUs);
+}
+
+uint32_t MR4Emulator::GetBaudrate(void)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _baudrate;
+}
+
+uint32_t MR4Emulator::GetRequestCount(void)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _requests;
+}
+
+/**
+ * @brief Bytes dropped for a bad lead, bad CRC, unknown command or wrong length.
+ */
+uint32_t MR4Emulator::GetErrorCount(void)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _errors;
+}
+
+uint32_t MR4Emulator::GetLostCount(void)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _lost;
+}
+
+uint32_t MR4Emulator::GetProfileHash(void)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _profileHash;
+}
+
+//--------------------------------------------------------------//
+//  Link  //
+//--------------------------------------------------------------//
+void MR4Emulator::ReadLink(void)
+{
+    while (_rxLen < MR4EMU_RX_SIZE) {
+        ssize_t n = ::read(_fd, _rx + _rxLen, MR4EMU_RX_SIZE - _rxLen);
+        if (n <= 0) break;
+        _rxLen += n;
+        _lastRxUs = NowUs();
+    }
+    if (_framed)
+        ParseFramed();
+    else
+        ParseLegacy();
+}
+
+void MR4Emulator::Consume(uint16_t size)
+{
+    _rxLen -= size;
+    memmove(_rx, _rx + size, _rxLen);
+}
+
+void MR4Emulator::ParseLegacy(void)
+{
+    while (_rxLen >= 3) {
+        if (_rx[0] != MatrixR4_COMM_LEAD || _rx[1] != ((~MatrixR4_COMM_LEAD) & 0xFF)) {
+            _errors++;
+            Consume(1);
+            continue;
+        }
+        int size = RequestSize(_rx[2]);
+        if (size < 0) {
+            _errors++;
+            Consume(1);
+            continue;
+        }
+        if (_rxLen < 3 + size) return;
+
+        uint8_t cmd = _rx[2];
+        uint8_t data[MR4EMU_RX_SIZE];
+        memcpy(data, _rx + 3, size);
+        Consume(3 + size);
+        _rxSeq = 0;
+        Execute(cmd, data, size);
+        // A SET_COMM_FRAMING above may have switched the protocol.
+        if (_framed) {
+            ParseFramed();
+            return;
+        }
+    }
+}
+
+void MR4Emulator::ParseFramed(void)
+{
+    while (_rxLen >= 2) {
+        if (_rx[0] != MatrixR4_COMM_LEAD || _rx[1] != ((~MatrixR4_COMM_LEAD) & 0xFF)) {
+            _errors++;
+            Consume(1);
+            continue;
+        }
+        if (_rxLen < MatrixR4_FRAME_HEADER_SIZE) return;
+
+        uint8_t  len   = _rx[4];
+        uint16_t total = MatrixR4_FRAME_HEADER_SIZE + len + MatrixR4_FRAME_CRC_SIZE;
+        if (_rxLen < total) return;
+
+        uint16_t crc = CRC16::Calc(_rx + 2, 3 + len);
+        if (crc != BitConverter::ToUInt16(_rx, MatrixR4_FRAME_HEADER_SIZE + len) ||
+            RequestSize(_rx[2]) != len) {
+            _errors++;
+            Consume(1);
+            continue;
+        }
+
+        uint8_t cmd = _rx[2];
+        uint8_t data[MatrixR4_FRAME_PAYLOAD_MAX];
+        _rxSeq = _rx[3];
+        memcpy(data, _rx + MatrixR4_FRAME_HEADER_SIZE, len);
+        Consume(total);
+        Execute(cmd, data, len);
+        if (!_framed) {
+            ParseLegacy();
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Queue a reply, framed replies echo the sequence of the request.
+ */
+void MR4Emulator::Reply(uint8_t cmd, uint8_t seq, const uint8_t* data, uint8_t size, uint32_t delayUs)
+{
+    if (_lossPermille > 0) {
+        _lossSeed ^= _lossSeed << 13;   // xorshift32
+        _lossSeed ^= _lossSeed >> 17;
+        _lossSeed ^= _lossSeed << 5;
+        if (_lossSeed % 1000 < _lossPermille) {
+            _lost++;
+            return;
+        }
+    }
+
+    Pending_t p;
+    p.bytes.push_back(MatrixR4_COMM_LEAD);
+    p.bytes.push_back((~MatrixR4_COMM_LEAD) & 0xFF);
+    p.bytes.push_back(cmd);
+
+    // The board stamps a reply when it is ready to go out.
+    uint64_t start = std::max<uint64_t>(NowUs() + delayUs, _txFreeUs);
+    uint8_t  tick  = (_framed && _stamped) ? 4 : 0;
+    if (_framed) {
+        p.bytes.push_back(seq);
+        p.bytes.push_back(size + tick);
+    }
+    p.bytes.insert(p.bytes.end(), data, data + size);
+    if (tick > 0) {
+        uint8_t t[4];
+        BitConverter::GetBytes(t, Tick(start));
+        p.bytes.insert(p.bytes.end(), t, t + 4);
+    }
+    if (_framed) {
+        uint16_t crc = CRC16::Calc(p.bytes.data() + 2, 3 + size + tick);
+        p.bytes.push_back(crc & 0xFF);
+        p.bytes.push_back(crc >> 8);
+    }
+
+    // Replies leave one after another, each takes its bytes' time on the wire.
+    if (_baudTiming && _baudrate > 0) start += p.bytes.size() * 10000000ULL / _baudrate;
+    p.dueUs   = start;
+    _txFreeUs = start;
+    _txQueue.push_back(p);
+}
+
+// The parts of a SET_PROFILE the simulation uses, PID gains and the IMU
+// calibration are accepted and ignored like their own commands.
+void MR4Emulator::ApplyProfile(const MMLowerProfile& profile)
+{
+    for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+        Motor_t& m = _motor[i];
+        if (profile.sections & MMLowerProfile::DIR) {
+            m.motorReverse   = profile.motorReverse & (1 << i);
+            m.encoderReverse = profile.encoderReverse & (1 << i);
+        }
+        if ((profile.sections & MMLowerProfile::SPEED_RANGE) && profile.speedMax[i] != 0) {
+            m.speedMin = profile.speedMin[i];
+            m.speedMax = profile.speedMax[i];
+        }
+        if ((profile.sections & MMLowerProfile::PPR) && profile.ppr[i] != 0) {
+            m.ppr    = profile.ppr[i];
+            m.maxRPM = profile.maxRPM[i];
+        }
+    }
+    if (profile.sections & MMLowerProfile::SERVO_RANGE) {
+        for (uint8_t i = 0; i < MR4EMU_SERVO_NUM; i++) {
+            if (profile.servoAngleMax[i] == 0) continue;
+            _servoMin[i] = profile.servoAngleMin[i];
+            _servoMax[i] = profile.servoAngleMax[i];
+        }
+    }
+}
+
+void MR4Emulator::Status(uint8_t cmd, uint8_t status)
+{
+    Reply(cmd, _rxSeq, &status, 1, _latencyUs);
+}
+
+void MR4Emulator::FlushDue(uint64_t now)
+{
+    while (!_txQueue.empty() && _txQueue.front().dueUs <= now) {
+        const std::vector<uint8_t>& b    = _txQueue.front().bytes;
+        size_t                      done = 0;
+        while (done < b.size()) {
+            // A closed socketpair peer must not raise SIGPIPE, ptys are no sockets.
+            ssize_t n = send(_fd, b.data() + done, b.size() - done, MSG_NOSIGNAL);
+            if (n < 0 && errno == ENOTSOCK) n = ::write(_fd, b.data() + done, b.size() - done);
+            if (n > 0) {
+                done += n;
+            } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                break;
+            }
+        }
+        _txQueue.pop_front();
+    }
+}
+
+//--------------------------------------------------------------//
+//  Commands  //
+//--------------------------------------------------------------//
+void MR4Emulator::Execute(uint8_t cmd, uint8_t* d, uint8_t size)
+{
+    (void)size;
+    _requests++;
+    Step(NowUs());
+    SendTaskDone();
+
+    uint8_t r[64];
+    switch ((CMD)cmd) {
+    // Setting-Init
+    case CMD::SET_DC_MOTOR_DIR:
+    case CMD::SET_ENCODER_DIR:
+    case CMD::SET_SERVO_DIR:
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            if (!(d[0] & (1 << i))) continue;
+            bool reverse = (d[1] == (uint8_t)MMLower::DIR::REVERSE);
+            if ((CMD)cmd == CMD::SET_DC_MOTOR_DIR) _motor[i].motorReverse = reverse;
+            if ((CMD)cmd == CMD::SET_ENCODER_DIR) _motor[i].encoderReverse = reverse;
+        }
+        Status(cmd, 0x00);
+        break;
+    case CMD::SET_DC_MOTOR_SPEED_RANGE:
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            if (!(d[0] & (1 << i))) continue;
+            _motor[i].speedMin = BitConverter::ToUInt16(d, 1);
+            _motor[i].speedMax = BitConverter::ToUInt16(d, 3);
+        }
+        Status(cmd, 0x00);
+        break;
+    case CMD::SET_SERVO_PULSE_RANGE:
+    {
+        uint16_t min = BitConverter::ToUInt16(d, 1), max = BitConverter::ToUInt16(d, 3);
+        Status(cmd, (min < 500) ? 0x02 : (max > 2500 || max <= min) ? 0x03 : 0x00);
+    } break;
+    case CMD::SET_SERVO_ANGLE_RANGE:
+    {
+        uint16_t min = BitConverter::ToUInt16(d, 1), max = BitConverter::ToUInt16(d, 3);
+        uint8_t  status = (min > 180) ? 0x02 : (max > 180 || max <= min) ? 0x03 : 0x00;
+        for (uint8_t i = 0; status == 0x00 && i < MR4EMU_SERVO_NUM; i++) {
+            if (!(d[0] & (1 << i))) continue;
+            _servoMin[i] = min;
+            _servoMax[i] = max;
+        }
+        Status(cmd, status);
+    } break;
+    case CMD::SET_BUTTON_INIT:
+        if (d[0] >= (uint8_t)MMLower::BUTTON_ECHO_MODE::MAX) {
+            Status(cmd, 0x02);
+            break;
+        }
+        _btnMode = d[0];
+        Status(cmd, 0x00);
+        break;
+    case CMD::SET_ENCODER_ECHO_MODE:
+    case CMD::SET_IMU_ECHO_MODE:
+    {
+        bool     isEnc    = ((CMD)cmd == CMD::SET_ENCODER_ECHO_MODE);
+        uint8_t  max      = isEnc ? (uint8_t)MMLower::ENCODER_ECHO_MODE::MAX
+                                  : (uint8_t)MMLower::IMU_ECHO_MODE::MAX;
+        uint16_t interval = BitConverter::ToUInt16(d, 1);
+        if (d[0] >= max) {
+            Status(cmd, 0x02);
+        } else if (d[0] != 0 && interval == 0) {
+            Status(cmd, 0x03);
+        } else if (isEnc) {
+            _encMode       = d[0];
+            _encIntervalMs = interval;
+            _encNextUs     = NowUs();
+            Status(cmd, 0x00);
+        } else {
+            _imuMode       = d[0];
+            _imuIntervalMs = interval;
+            _imuNextUs     = NowUs();
+            Status(cmd, 0x00);
+        }
+    } break;
+    case CMD::SET_TASK_ECHO_MODE:
+        if (d[0] >= (uint8_t)MMLower::TASK_ECHO_MODE::MAX) {
+            Status(cmd, 0x02);
+            break;
+        }
+        _taskMode = d[0];
+        Status(cmd, 0x00);
+        break;
+    case CMD::SET_IMU_INIT:
+        Status(cmd, (d[0] > (uint8_t)MMLower::IMU_ACC_FSR::_16G)         ? 0x02
+                    : (d[1] > (uint8_t)MMLower::IMU_GYRO_FSR::_2000DPS) ? 0x03
+                    : (d[2] > (uint8_t)MMLower::IMU_ODR::_8000_SPS)     ? 0x04
+                                                                          : 0x00);
+        break;
+    case CMD::SET_POWER_PARAM:
+        if (d[1] >= d[0] || d[2] < d[1] || d[2] > d[0]) {
+            Status(cmd, 0x02);
+            break;
+        }
+        _fullVolt   = d[0];
+        _cutOffVolt = d[1];
+        _alarmVolt  = d[2];
+        Status(cmd, 0x00);
+        break;
+    case CMD::SET_ENCODER_PPR_MAXSPEED:
+        if (d[0] < MR4EMU_DC_MOTOR_NUM) {
+            _motor[d[0]].ppr    = BitConverter::ToUInt16(d, 2);
+            _motor[d[0]].maxRPM = BitConverter::ToUInt16(d, 4);
+        }
+        Status(cmd, 0x00);
+        break;
+    case CMD::SET_ALL_ENCODER_PPR:
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            _motor[i].ppr = BitConverter::ToUInt16(d, 2 + i * 2);
+        }
+        Status(cmd, 0x00);
+        break;
+
+    // Setting-Commonly used
+    case CMD::SET_DC_MOTOR_POWER:
+    case CMD::SET_DC_MOTOR_SPEED:
+    {
+        int16_t value = BitConverter::ToInt16(d, 2);
+        bool    speed = ((CMD)cmd == CMD::SET_DC_MOTOR_SPEED);
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            if (!(d[0] & (1 << i))) continue;
+            int16_t limit = speed ? _motor[i].speedMax : 100;
+            if (abs(value) > limit) {
+                Status(cmd, 0x02);
+                return;
+            }
+            _motor[i].power      = speed ? Clamp16(value * 100.0 / limit) : value;
+            _motor[i].rotateLeft = -1;
+        }
+        Status(cmd, 0x00);
+    } break;
+    case CMD::SET_DC_MOTOR_ROTATE:
+    {
+        int16_t  speed  = BitConverter::ToInt16(d, 1);
+        uint16_t degree = BitConverter::ToUInt16(d, 3);
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            if (!(d[0] & (1 << i))) continue;
+            _motor[i].power      = std::max<int16_t>(-100, std::min<int16_t>(100, speed));
+            _motor[i].rotateLeft = degree * _motor[i].ppr / 360.0;
+        }
+        Status(cmd, 0x00);
+    } break;
+    case CMD::SET_ALL_DC_MOTOR_SPEED:
+    case CMD::SET_ALL_DC_MOTOR_POWER:
+    {
+        bool speed = ((CMD)cmd == CMD::SET_ALL_DC_MOTOR_SPEED);
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            int16_t value = BitConverter::ToInt16(d, 1 + i * 2);
+            int16_t limit = speed ? _motor[i].speedMax : 100;
+            if (abs(value) > limit) {
+                Status(cmd, 0x02 + i);
+                return;
+            }
+        }
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            int16_t value        = BitConverter::ToInt16(d, 1 + i * 2);
+            int16_t limit        = speed ? _motor[i].speedMax : 100;
+            // Direction bit 1 = FORWARD, as in MMLower::DIR.
+            int16_t sign         = (d[0] & (1 << i)) ? 1 : -1;
+            _motor[i].power      = Clamp16(sign * value * 100.0 / limit);
+            _motor[i].rotateLeft = -1;
+        }
+        Status(cmd, 0x00);
+    } break;
+    case CMD::SET_SERVO_ANGLE:
+    {
+        uint16_t angle = BitConverter::ToUInt16(d, 1);
+        for (uint8_t i = 0; i < MR4EMU_SERVO_NUM; i++) {
+            if (!(d[0] & (1 << i))) continue;
+            if (angle < _servoMin[i] || angle > _servoMax[i]) {
+                Status(cmd, 0x02);
+                return;
+            }
+            _servoAngle[i] = angle;
+        }
+        Status(cmd, 0x00);
+    } break;
+    case CMD::SET_ALL_SERVO_ANGLE:
+        for (uint8_t i = 0; i < MR4EMU_SERVO_NUM; i++) {
+            uint16_t angle = BitConverter::ToUInt16(d, i * 2);
+            if (angle < _servoMin[i] || angle > _servoMax[i]) {
+                Status(cmd, 0x02 + i);
+                return;
+            }
+        }
+        for (uint8_t i = 0; i < MR4EMU_SERVO_NUM; i++) {
+            _servoAngle[i] = BitConverter::ToUInt16(d, i * 2);
+        }
+        Status(cmd, 0x00);
+        break;
+    case CMD::SET_MOVE_DISTANCE:
+    {
+        // DIFF drives M1 (left) and M2 (right), OMNI all four.
+        static const int8_t dirs[5][2] = {{0, 0}, {1, 1}, {-1, -1}, {-1, 1}, {1, -1}};
+        uint16_t            speed      = BitConverter::ToUInt16(d, 2);
+        uint16_t            counts     = BitConverter::ToUInt16(d, 4);
+        if (d[0] > (uint8_t)MMLower::MOVE_TYPE::OMNI || d[1] > (uint8_t)MMLower::MOVE_ACTION::RIGHT) {
+            Status(cmd, 0x02);
+            break;
+        }
+        if (speed > 100) {
+            Status(cmd, 0x03);
+            break;
+        }
+        if (d[1] != (uint8_t)MMLower::MOVE_ACTION::STOP && counts == 0) {
+            Status(cmd, 0x04);
+            break;
+        }
+        uint8_t num = (d[0] == (uint8_t)MMLower::MOVE_TYPE::DIFF) ? 2 : 4;
+        for (uint8_t i = 0; i < num; i++) {
+            _motor[i].power      = dirs[d[1]][i & 1] * speed;
+            _motor[i].rotateLeft = (_motor[i].power == 0) ? -1 : counts;
+        }
+        Status(cmd, 0x00);
+    } break;
+    case CMD::SET_ENCODER_RESET_COUNTER:
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            if (d[0] & (1 << i)) _motor[i].count = 0;
+        }
+        Status(cmd, 0x00);
+        break;
+    case CMD::SET_IMU_TO_ZERO:
+        _roll = _pitch = _yaw = 0;
+        // The real board takes a while to settle the IMU.
+        r[0] = 0x00;
+        Reply(cmd, _rxSeq, r, 1, _latencyUs + 200000);
+        break;
+    case CMD::SET_DC_BRAKE:
+    case CMD::SET_ALL_DC_BRAKE:
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            if ((CMD)cmd == CMD::SET_ALL_DC_BRAKE || (d[0] & (1 << i))) {
+                _motor[i].power      = 0;
+                _motor[i].rotateLeft = -1;
+            }
+        }
+        Status(cmd, 0x00);
+        break;
+    case CMD::SET_STATE_LED:
+    case CMD::SET_PID_PARAM:
+    case CMD::SET_IMU_Calib_Data:
+    case CMD::SET_DC_BRAKE_TYPE:
+    case CMD::SET_DC_ALL_BRAKE_TYPE:
+        Status(cmd, 0x00);
+        break;
+
+    // Getting
+    case CMD::GET_BUTTON_STATE:
+        r[0] = (d[0] < MR4EMU_BUTTON_NUM) ? _btn[d[0]] : 0;
+        Reply(cmd, _rxSeq, r, 1, _latencyUs);
+        break;
+    case CMD::GET_BUTTONS_STATE:
+        r[0] = (uint8_t)_btn[0] | ((uint8_t)_btn[1] << 1);
+        r[1] = 0;
+        Reply(cmd, _rxSeq, r, 2, _latencyUs);
+        break;
+    case CMD::GET_ENCODER_COUNTER:
+    case CMD::GET_ENCODER_DEGREES:
+    {
+        int32_t value = 0;
+        if (d[0] < MR4EMU_DC_MOTOR_NUM) {
+            value = ((CMD)cmd == CMD::GET_ENCODER_COUNTER) ? (int32_t)_motor[d[0]].count
+                                                           : (int32_t)MotorDegrees(d[0]);
+        }
+        BitConverter::GetBytes(r, value);
+        Reply(cmd, _rxSeq, r, 4, _latencyUs);
+    } break;
+    case CMD::GET_ALL_ENCODER_COUNTER:
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            BitConverter::GetBytes(r + i * 4, (int32_t)_motor[i].count);
+        }
+        Reply(cmd, _rxSeq, r, 16, _latencyUs);
+        break;
+    case CMD::GET_SPEED_ALL_DC_MOTOR:
+    case CMD::GET_IMU_EULER:
+    case CMD::GET_IMU_GYRO:
+    case CMD::GET_IMU_ACC:
+    case CMD::GET_IMU_ACC_NOcal:
+        Reply(cmd, _rxSeq, r, SampleReply(cmd, r), _latencyUs);
+        break;
+    case CMD::GET_POWER_INFO:
+        BitConverter::GetBytes(r, _battMilliVolt);
+        r[2] = BatteryPercent();
+        Reply(cmd, _rxSeq, r, 3, _latencyUs);
+        break;
+    case CMD::GET_ROTATE_STATE:
+        r[0] = (d[0] < MR4EMU_DC_MOTOR_NUM) ? (_motor[d[0]].rotateLeft < 0) : 1;
+        Reply(cmd, _rxSeq, r, 1, _latencyUs);
+        break;
+
+    // Drive DC
+    case CMD::SET_DC_TWO_MOTOR_PARAM:
+    {
+        uint8_t id = d[4];
+        if (id >= MR4EMU_DRIVE_NUM || d[0] < 1 || d[0] > MR4EMU_DC_MOTOR_NUM || d[1] < 1 ||
+            d[1] > MR4EMU_DC_MOTOR_NUM || d[0] == d[1]) {
+            Status(cmd, 0x08);
+            break;
+        }
+        Drive_t& drive   = _drive[id];
+        drive.defined    = true;
+        drive.task       = 0;
+        drive.running    = false;
+        for (uint8_t s = 0; s < 2; s++) {
+            drive.motor[s]   = d[s] - 1;
+            drive.reverse[s] = (d[2 + s] == (uint8_t)MMLower::DIR::REVERSE);
+            drive.base[s]    = _motor[drive.motor[s]].count;
+        }
+        Status(cmd, 0x00);
+    } break;
+    case CMD::SET_DC_TWO_MoveSync_PID:
+    case CMD::SET_DC_TWO_MoveGyro_PID:
+    case CMD::SET_DC_TWO_TurnGyro_PID:
+        Status(cmd, 0x00);
+        break;
+    case CMD::SET_DC_TWO_MOTOR_Reset_count:
+    case CMD::SET_DC_TWO_MOTOR_PPR:
+    case CMD::SET_Drive_Brake:
+    {
+        uint8_t id = d[size - 1];
+        if (id >= MR4EMU_DRIVE_NUM || !_drive[id].defined) {
+            Status(cmd, 0x07);
+            break;
+        }
+        Drive_t& drive = _drive[id];
+        for (uint8_t s = 0; s < 2; s++) {
+            if ((CMD)cmd == CMD::SET_DC_TWO_MOTOR_Reset_count && d[0]) {
+                drive.base[s] = _motor[drive.motor[s]].count;
+            } else if ((CMD)cmd == CMD::SET_DC_TWO_MOTOR_PPR) {
+                _motor[drive.motor[s]].ppr = BitConverter::ToUInt16(d, s * 2);
+            }
+        }
+        if ((CMD)cmd == CMD::SET_Drive_Brake) {
+            SetDrivePower(id, 0, 0);
+            drive.running = false;
+        }
+        Status(cmd, 0x00);
+    } break;
+    case CMD::SET_DC_MOTOR_TYPE:
+        Status(cmd, (d[0] < MR4EMU_DRIVE_NUM && _drive[d[0]].defined) ? 0x00 : 0x07);
+        break;
+    case CMD::SET_Drive_Move:
+    case CMD::SET_Drive_MoveDegs:
+    case CMD::SET_Drive_MoveTime:
+    case CMD::SET_Drive_MoveSync:
+    case CMD::SET_Drive_MoveSyncDegs:
+    case CMD::SET_Drive_MoveSyncDegsACC:
+    case CMD::SET_Drive_MoveSyncTime:
+    case CMD::SET_Drive_Gyro:
+    case CMD::SET_Drive_GyroDegs:
+    case CMD::SET_Drive_GyroTime:
+    case CMD::SET_Drive_Turn: StartDrive(cmd, d, size); break;
+    case CMD::GET_Task_Done_Status:
+    {
+        // 0x02 while the task runs, 0x01 once it is done (DriveDC polls
+        // Get_Drive_isTaskDone until its flag drops).
+        uint8_t id = d[1];
+        r[0]       = (id >= MR4EMU_DRIVE_NUM || !_drive[id].defined) ? 0x07
+                     : _drive[id].running                            ? 0x02
+                                                                     : 0x01;
+        Reply(cmd, _rxSeq, r, 1, _latencyUs);
+    } break;
+    case CMD::GET_Drive_Degress:
+    case CMD::GET_Drive_Counter:
+    {
+        uint8_t id = d[0];
+        if (id >= MR4EMU_DRIVE_NUM || !_drive[id].defined) {
+            memset(r, 0, 4);
+            r[0] = 0x07;
+        } else {
+            double value = ((CMD)cmd == CMD::GET_Drive_Counter) ? DriveCount(id) : DriveDegrees(id);
+            BitConverter::GetBytes(r, (int32_t)value);
+        }
+        Reply(cmd, _rxSeq, r, 4, _latencyUs);
+    } break;
+
+    // Other-Info
+    case CMD::ECHO_TEST: Reply(cmd, _rxSeq, d, 1, _latencyUs); break;
+    case CMD::F_VERSION:
+        r[0] = MR4EMU_FW_VERSION;
+        Reply(cmd, _rxSeq, r, 1, _latencyUs);
+        break;
+    case CMD::F_BUILD_DAY:
+    case CMD::READ_ALL_INFO:
+    {
+        uint8_t* p = r;
+        if ((CMD)cmd == CMD::READ_ALL_INFO) *p++ = MR4EMU_FW_VERSION;
+        BitConverter::GetBytes(p, (uint16_t)MR4EMU_BUILD_YEAR);
+        p[2] = MR4EMU_BUILD_MONTH;
+        p[3] = MR4EMU_BUILD_DAY;
+        p += 4;
+        if ((CMD)cmd == CMD::READ_ALL_INFO) *p++ = MR4EMU_MODEL_INDEX;
+        Reply(cmd, _rxSeq, r, p - r, _latencyUs);
+    } break;
+    case CMD::F_DESCRIPTOR:
+        // Length byte, then the text.
+        r[0] = strlen(MR4EMU_DESCRIPTOR);
+        memcpy(r + 1, MR4EMU_DESCRIPTOR, r[0]);
+        Reply(cmd, _rxSeq, r, 1 + r[0], _latencyUs);
+        break;
+    case CMD::READ_MODEL_INDEX:
+        r[0] = MR4EMU_MODEL_INDEX;
+        Reply(cmd, _rxSeq, r, 1, _latencyUs);
+        break;
+    case CMD::RUN_AUTO_QC:
+        r[0] = 0x01;   // IMU ok
+        Reply(cmd, _rxSeq, r, 1, _latencyUs);
+        break;
+    case CMD::SET_COMM_FRAMING:
+        if (!_framingSupport) break;
+        if (d[0] > MatrixR4_FRAME_VERSION) {
+            Status(cmd, 0x02);
+            break;
+        }
+        // Acknowledge in the old mode, then switch.
+        Status(cmd, 0x00);
+        _framed = (d[0] != 0x00);
+        if (!_framed) _stamped = false;
+        break;
+    case CMD::SET_COMM_BAUDRATE:
+    {
+        if (!_framingSupport) break;
+        uint32_t baudrate = BitConverter::ToUInt32(d, 0);
+        if (baudrate < 9600 || baudrate > 2000000) {
+            Status(cmd, 0x02);
+            break;
+        }
+        Status(cmd, 0x00);
+        _baudrate = baudrate;
+    } break;
+    case CMD::SET_COMM_TIMESTAMP:
+        if (!_framingSupport) break;
+        if (!_framed) {
+            Status(cmd, 0x02);
+            break;
+        }
+        Status(cmd, 0x00);
+        _stamped = (d[0] != 0x00);
+        break;
+    case CMD::GET_PROFILE_HASH:
+        if (!_framingSupport) break;
+        BitConverter::GetBytes(r, _profileHash);
+        Reply(cmd, _rxSeq, r, 4, _latencyUs);
+        break;
+    case CMD::SET_PROFILE:
+    {
+        if (!_framingSupport) break;
+        MMLowerProfile profile;
+        if (d[0] != MR4_PROFILE_VERSION || !profile.Deserialize(d + 1)) {
+            Status(cmd, 0x02);
+            break;
+        }
+        ApplyProfile(profile);
+        _profileHash = MMLowerProfile::Hash(d, 1 + MR4_PROFILE_BLOB_SIZE);
+        Status(cmd, 0x00);
+    } break;
+    case CMD::GET_SAMPLE:
+    {
+        if (!_framingSupport) break;
+        // sample number, then the reply of the getter. A request for the
+        // sample after the current one is held until it is taken.
+        uint8_t size = SampleReply(d[0], r + 2);
+        if (size == 0) {
+            _errors++;
+            break;
+        }
+        uint64_t elapsed = NowUs() - _tickBaseUs;
+        uint16_t seq     = (uint16_t)(elapsed / MR4EMU_SAMPLE_PERIOD_US);
+        uint32_t holdUs  = 0;
+        if (seq == BitConverter::ToUInt16(d, 1)) {
+            holdUs = MR4EMU_SAMPLE_PERIOD_US - elapsed % MR4EMU_SAMPLE_PERIOD_US;
+            seq++;
+        }
+        BitConverter::GetBytes(r, seq);
+        Reply(cmd, _rxSeq, r, 2 + size, _latencyUs + holdUs);
+    } break;
+    case CMD::GET_SNAPSHOT:
+    {
+        if (!_framingSupport) break;
+        // mask of the fields sent, then each in bit order
+        uint16_t fields = BitConverter::ToUInt16(d, 0) & 0x007F;
+        uint8_t  n      = 2;
+        BitConverter::GetBytes(r, fields);
+        if (fields & 0x0001) {
+            for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++, n += 4) {
+                BitConverter::GetBytes(r + n, (int32_t)_motor[i].count);
+            }
+        }
+        if (fields & 0x0002) {
+            for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++, n += 4) {
+                int32_t rpm = _motor[i].power * _motor[i].maxRPM / 100;
+                if (_motor[i].motorReverse != _motor[i].encoderReverse) rpm = -rpm;
+                BitConverter::GetBytes(r + n, rpm);
+            }
+        }
+        if (fields & 0x0004) {
+            BitConverter::GetBytes(r + n + 0, Clamp16(_roll * 100));
+            BitConverter::GetBytes(r + n + 2, Clamp16(_pitch * 100));
+            BitConverter::GetBytes(r + n + 4, Clamp16(_yaw * 100));
+            n += 6;
+        }
+        if (fields & 0x0008) {
+            BitConverter::GetBytes(r + n + 0, (int16_t)0);
+            BitConverter::GetBytes(r + n + 2, (int16_t)0);
+            BitConverter::GetBytes(r + n + 4, Clamp16(_yawRate * 100));
+            n += 6;
+        }
+        if (fields & 0x0010) {
+            BitConverter::GetBytes(r + n + 0, Clamp16(-sin(_pitch * M_PI / 180) * 1000));
+            BitConverter::GetBytes(r + n + 2, Clamp16(sin(_roll * M_PI / 180) * 1000));
+            BitConverter::GetBytes(
+                r + n + 4, Clamp16(cos(_roll * M_PI / 180) * cos(_pitch * M_PI / 180) * 1000));
+            n += 6;
+        }
+        if (fields & 0x0020) {
+            r[n++] = (uint8_t)_btn[0] | ((uint8_t)_btn[1] << 1);
+        }
+        if (fields & 0x0040) {
+            BitConverter::GetBytes(r + n, _battMilliVolt);
+            r[n + 2] = BatteryPercent();
+            n += 3;
+        }
+        Reply(cmd, _rxSeq, r, n, _latencyUs);
+    } break;
+    case CMD::SET_BATCH:
+    {
+        if (!_framingSupport) break;
+        // motor ops (2 bits each: none, power, speed, brake), motor values,
+        // servo mask, angles. Nothing is applied if a value is out of range.
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            uint8_t op    = (d[0] >> (i * 2)) & 0x03;
+            int16_t value = BitConverter::ToInt16(d, 1 + i * 2);
+            int16_t limit = (op == 2) ? _motor[i].speedMax : 100;
+            if ((op == 1 || op == 2) && abs(value) > limit) {
+                Status(cmd, 0x02 + i);
+                return;
+            }
+        }
+        for (uint8_t i = 0; i < MR4EMU_SERVO_NUM; i++) {
+            uint16_t angle = BitConverter::ToUInt16(d, 10 + i * 2);
+            if ((d[9] & (1 << i)) && (angle < _servoMin[i] || angle > _servoMax[i])) {
+                Status(cmd, 0x06 + i);
+                return;
+            }
+        }
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            uint8_t op    = (d[0] >> (i * 2)) & 0x03;
+            int16_t value = BitConverter::ToInt16(d, 1 + i * 2);
+            if (op == 0) continue;
+            if (op == 1) _motor[i].power = value;
+            else if (op == 2) _motor[i].power = Clamp16(value * 100.0 / _motor[i].speedMax);
+            else _motor[i].power = 0;
+            _motor[i].rotateLeft = -1;
+        }
+        for (uint8_t i = 0; i < MR4EMU_SERVO_NUM; i++) {
+            if (d[9] & (1 << i)) _servoAngle[i] = BitConverter::ToUInt16(d, 10 + i * 2);
+        }
+        Status(cmd, 0x00);
+    } break;
+    default: _errors++; break;
+    }
+}
+
+// Reply of a getter of sampled data into r, its size, 0 if cmd is none.
+uint8_t MR4Emulator::SampleReply(uint8_t cmd, uint8_t* r)
+{
+    switch ((CMD)cmd) {
+    case CMD::GET_SPEED_ALL_DC_MOTOR:
+        r[0] = 0x00;
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            int32_t rpm = _motor[i].power * _motor[i].maxRPM / 100;
+            if (_motor[i].motorReverse != _motor[i].encoderReverse) rpm = -rpm;
+            BitConverter::GetBytes(r + 1 + i * 4, rpm);
+        }
+        return 17;
+    case CMD::GET_IMU_EULER:
+        BitConverter::GetBytes(r + 0, Clamp16(_roll * 100));
+        BitConverter::GetBytes(r + 2, Clamp16(_pitch * 100));
+        BitConverter::GetBytes(r + 4, Clamp16(_yaw * 100));
+        return 6;
+    case CMD::GET_IMU_GYRO:
+        BitConverter::GetBytes(r + 0, (int16_t)0);
+        BitConverter::GetBytes(r + 2, (int16_t)0);
+        BitConverter::GetBytes(r + 4, Clamp16(_yawRate * 100));
+        return 6;
+    case CMD::GET_IMU_ACC:
+        BitConverter::GetBytes(r + 0, Clamp16(-sin(_pitch * M_PI / 180) * 1000));
+        BitConverter::GetBytes(r + 2, Clamp16(sin(_roll * M_PI / 180) * 1000));
+        BitConverter::GetBytes(r + 4, Clamp16(cos(_roll * M_PI / 180) * cos(_pitch * M_PI / 180) * 1000));
+        return 6;
+    case CMD::GET_IMU_ACC_NOcal:
+        r[0] = 0x00;
+        BitConverter::FloatGetBytes(r + 1, (float)-sin(_pitch * M_PI / 180));
+        BitConverter::FloatGetBytes(r + 5, (float)sin(_roll * M_PI / 180));
+        BitConverter::FloatGetBytes(r + 9, (float)(cos(_roll * M_PI / 180) * cos(_pitch * M_PI / 180)));
+        return 13;
+    default: return 0;
+    }
+}
+
+//--------------------------------------------------------------//
+//  Simulation  //
+//--------------------------------------------------------------//
+double MR4Emulator::MotorDegrees(uint8_t num)
+{
+    return _motor[num].count * 360.0 / _motor[num].ppr;
+}
+
+// Average of both wheels since the last reset, positive when driving forward.
+double MR4Emulator::DriveCount(uint8_t id)
+{
+    Drive_t& drive = _drive[id];
+    double   sum   = 0;
+    for (uint8_t s = 0; s < 2; s++) {
+        Motor_t& m     = _motor[drive.motor[s]];
+        double   count = m.count - drive.base[s];
+        sum += drive.reverse[s] ? -count : count;
+    }
+    return sum / 2;
+}
+
+double MR4Emulator::DriveDegrees(uint8_t id)
+{
+    return DriveCount(id) * 360.0 / _motor[_drive[id].motor[0]].ppr;
+}
+
+void MR4Emulator::SetDrivePower(uint8_t id, int16_t left, int16_t right)
+{
+    Drive_t& drive = _drive[id];
+    int16_t  p[2]  = {left, right};
+    for (uint8_t s = 0; s < 2; s++) {
+        Motor_t& m   = _motor[drive.motor[s]];
+        m.power      = drive.reverse[s] ? -p[s] : p[s];
+        m.rotateLeft = -1;
+    }
+}
+
+/**
+ * @brief Start one of the SET_Drive_* tasks.
+ *
+ * Request layouts (id is always the last byte):
+ *   Move / MoveSync:        left, right (int16)
+ *   *Degs:                  left, right, degree (uint16), brake, async
+ *   *Time:                  left, right, ms (uint32), brake, async
+ *   Gyro:                   power, heading (int16)
+ *   GyroDegs / GyroTime:    power, heading, degree / ms, brake, async
+ *   Turn:                   power, heading, mode, brake, async
+ */
+void MR4Emulator::StartDrive(uint8_t cmd, uint8_t* d, uint8_t size)
+{
+    uint8_t id = d[size - 1];
+    if (id >= MR4EMU_DRIVE_NUM || !_drive[id].defined) {
+        Status(cmd, 0x07);
+        return;
+    }
+    int16_t a = BitConverter::ToInt16(d, 0);
+    int16_t b = BitConverter::ToInt16(d, 2);
+    if (abs(a) > 100 || ((CMD)cmd < CMD::SET_Drive_Gyro && abs(b) > 100)) {
+        Status(cmd, 0x02);
+        return;
+    }
+
+    Drive_t& drive  = _drive[id];
+    drive.task      = cmd;
+    drive.running   = true;
+    drive.startUs   = NowUs();
+    drive.startDegs = DriveDegrees(id);
+    drive.degree    = 0;
+    drive.timeMs    = 0;
+    drive.brake     = true;
+    switch ((CMD)cmd) {
+    case CMD::SET_Drive_MoveDegs:
+    case CMD::SET_Drive_MoveSyncDegs:
+    case CMD::SET_Drive_MoveSyncDegsACC:
+    case CMD::SET_Drive_GyroDegs:
+        drive.degree = BitConverter::ToUInt16(d, 4);
+        drive.brake  = d[6];
+        break;
+    case CMD::SET_Drive_MoveTime:
+    case CMD::SET_Drive_MoveSyncTime:
+    case CMD::SET_Drive_GyroTime:
+        drive.timeMs = BitConverter::ToUInt32(d, 4);
+        drive.brake  = d[8];
+        break;
+    case CMD::SET_Drive_Turn: drive.brake = d[5]; break;
+    default: break;
+    }
+
+    if ((CMD)cmd >= CMD::SET_Drive_Gyro) {
+        drive.target = b;
+        drive.power  = ((CMD)cmd == CMD::SET_Drive_Turn) ? abs(a) : a;
+        drive.mode   = ((CMD)cmd == CMD::SET_Drive_Turn) ? d[4] : 0;
+        StepDrive(id, drive.startUs);
+    } else {
+        SetDrivePower(id, a, b);
+    }
+    // Unbounded moves keep running but have nothing to wait for.
+    if (drive.degree == 0 && drive.timeMs == 0 && (CMD)cmd != CMD::SET_Drive_Turn) {
+        drive.running = false;
+    }
+    Status(cmd, 0x00);
+}
+
+void MR4Emulator::StepDrive(uint8_t id, uint64_t now)
+{
+    Drive_t& drive = _drive[id];
+    CMD      cmd   = (CMD)drive.task;
+    bool     done  = false;
+
+    if (cmd == CMD::SET_Drive_Turn) {
+        if (!drive.running) return;
+        // Spin in place, or pivot on the inner wheel in single motor mode.
+        double  error = drive.target - _yaw;
+        int16_t p     = (error > 0) ? drive.power : -drive.power;
+        done          = fabs(error) < 0.5;
+        if (!done && drive.mode) {
+            SetDrivePower(id, p, -p);
+        } else if (!done) {
+            SetDrivePower(id, (p > 0) ? p : 0, (p > 0) ? 0 : -p);
+        }
+    } else if (cmd >= CMD::SET_Drive_Gyro && cmd <= CMD::SET_Drive_GyroTime) {
+        // Hold the heading, steering proportional to the yaw error.
+        int16_t power = drive.power;
+        double  steer = (drive.target - _yaw) * 2;
+        steer         = std::max(-fabs(power / 2.0), std::min(fabs(power / 2.0), steer));
+        int16_t left  = Clamp16(power + steer), right = Clamp16(power - steer);
+        _motor[drive.motor[0]].power = drive.reverse[0] ? -left : left;
+        _motor[drive.motor[1]].power = drive.reverse[1] ? -right : right;
+    }
+    if (!drive.running) return;
+
+    if (drive.degree > 0) {
+        done = fabs(DriveDegrees(id) - drive.startDegs) >= drive.degree;
+    } else if (drive.timeMs > 0) {
+        done = (now - drive.startUs) >= (uint64_t)drive.timeMs * 1000;
+    }
+    if (done) {
+        SetDrivePower(id, 0, 0);
+        drive.task    = 0;
+        drive.running = false;
+    }
+}
+
+void MR4Emulator::Step(uint64_t now)
+{
+    if (now <= _lastStepUs) return;
+    double dt   = (now - _lastStepUs) / 1e6;
+    _lastStepUs = now;
+
+    for (Motor_t& m : _motor) {
+        double rev   = m.power / 100.0 * m.maxRPM / 60.0 * dt;
+        double delta = rev * m.ppr;
+        if (m.motorReverse) delta = -delta;
+        if (m.encoderReverse) delta = -delta;
+        m.count += delta;
+        if (m.rotateLeft >= 0) {
+            m.rotateLeft -= fabs(delta);
+            if (m.rotateLeft <= 0) {
+                m.power      = 0;
+                m.rotateLeft = -1;
+            }
+        }
+    }
+
+    // The first defined drive turns the robot by its wheel difference.
+    _yawRate = 0;
+    for (uint8_t id = 0; id < MR4EMU_DRIVE_NUM; id++) {
+        Drive_t& drive = _drive[id];
+        if (!drive.defined) continue;
+        double v[2];
+        for (uint8_t s = 0; s < 2; s++) {
+            int16_t p = _motor[drive.motor[s]].power;
+            v[s]      = drive.reverse[s] ? -p : p;
+        }
+        _yawRate = (v[0] - v[1]) / 200.0 * MR4EMU_TURN_RATE;
+        break;
+    }
+    _yaw += _yawRate * dt;
+
+    for (uint8_t id = 0; id < MR4EMU_DRIVE_NUM; id++) {
+        if (_drive[id].defined && _drive[id].task != 0) StepDrive(id, now);
+    }
+}
+
+uint8_t MR4Emulator::BatteryPercent(void)
+{
+    int32_t full = _fullVolt * 100, cutOff = _cutOffVolt * 100;
+    int32_t perc = (_battMilliVolt - cutOff) * 100 / (full - cutOff);
+    return (uint8_t)std::max<int32_t>(0, std::min<int32_t>(100, perc));
+}
+
+void MR4Emulator::SendButton(uint8_t num, uint8_t state)
+{
+    uint8_t b[2] = {num, state};
+    Reply((uint8_t)CMD::AUTO_SEND_BUTTON_STATE, 0, b, 2, 0);
+}
+
+/**
+ * @brief AUTO_SEND_TASK_DONE for every rotate / drive task that stopped
+ * since the last call, whether it finished or a command stopped it.
+ */
+void MR4Emulator::SendTaskDone(void)
+{
+    uint8_t rotating = 0, driving = 0;
+    for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+        if (_motor[i].rotateLeft >= 0) rotating |= (1 << i);
+    }
+    for (uint8_t id = 0; id < MR4EMU_DRIVE_NUM; id++) {
+        if (_drive[id].running) driving |= (1 << id);
+    }
+
+    uint8_t ended[2] = {(uint8_t)(_rotating & ~rotating), (uint8_t)(_driving & ~driving)};
+    _rotating        = rotating;
+    _driving         = driving;
+    if (_taskMode == (uint8_t)MMLower::TASK_ECHO_MODE::PASSIVE) return;
+
+    for (uint8_t task = 0; task < 2; task++) {
+        for (uint8_t i = 0; i < 8; i++) {
+            if (!(ended[task] & (1 << i))) continue;
+            uint8_t b[2] = {task, i};
+            Reply((uint8_t)CMD::AUTO_SEND_TASK_DONE, 0, b, 2, 0);
+        }
+    }
+}
+
+/**
+ * @brief Auto-send streams: encoders as the low 16 bits of each counter,
+ * IMU as euler, gyro and acc frames.
+ */
+void MR4Emulator::SendTelemetry(uint64_t now)
+{
+    if (_encMode != (uint8_t)MMLower::ENCODER_ECHO_MODE::PASSIVE && now >= _encNextUs) {
+        uint8_t b[8];
+        for (uint8_t i = 0; i < MR4EMU_DC_MOTOR_NUM; i++) {
+            BitConverter::GetBytes(b + i * 2, (uint16_t)(int32_t)_motor[i].count);
+        }
+        Reply((uint8_t)CMD::AUTO_SEND_ENCODER_COUNTER, 0, b, 8, 0);
+        _encNextUs = now + _encIntervalMs * 1000ULL;
+    }
+    if (_imuMode != (uint8_t)MMLower::IMU_ECHO_MODE::PASSIVE && now >= _imuNextUs) {
+        uint8_t b[6];
+        BitConverter::GetBytes(b + 0, Clamp16(_roll * 100));
+        BitConverter::GetBytes(b + 2, Clamp16(_pitch * 100));
+        BitConverter::GetBytes(b + 4, Clamp16(_yaw * 100));
+        Reply((uint8_t)CMD::AUTO_SEND_IMU_EULER, 0, b, 6, 0);
+        BitConverter::GetBytes(b + 0, (int16_t)0);
+        BitConverter::GetBytes(b + 2, (int16_t)0);
+        BitConverter::GetBytes(b + 4, Clamp16(_yawRate * 100));
+        Reply((uint8_t)CMD::AUTO_SEND_IMU_GYRO, 0, b, 6, 0);
+        BitConverter::GetBytes(b + 0, Clamp16(-sin(_pitch * M_PI / 180) * 1000));
+        BitConverter::GetBytes(b + 2, Clamp16(sin(_roll * M_PI / 180) * 1000));
+        BitConverter::GetBytes(b + 4, Clamp16(cos(_roll * M_PI / 180) * cos(_pitch * M_PI / 180) * 1000));
+        Reply((uint8_t)CMD::AUTO_SEND_IMU_ACC, 0, b, 6, 0);
+        _imuNextUs = now + _imuIntervalMs * 1000ULL;
+    }
+}
@@ -0,0 +1,189 @@
+/**
+ * @file MR4Emulator.h
+ * @brief Host stand-in for the lower MCU (STM32) of the Matrix Mini R4.
+ * @author MATRIX Robotics
+ */
+#ifndef MR4EMULATOR_H
+#define MR4EMULATOR_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define MR4EMU_DC_MOTOR_NUM 4
+#define MR4EMU_SERVO_NUM    4
+#define MR4EMU_BUTTON_NUM   2
+#define MR4EMU_DRIVE_NUM    4
+#define MR4EMU_RX_SIZE      512
+
+// Encoder speeds and IMU readings are numbered per period, see GET_SAMPLE
+#define MR4EMU_SAMPLE_PERIOD_US 10000
+
+class MMLowerProfile;
+
+/**
+ * @brief Implements the lower board side of every MMLower COMM_CMD over a
+ * file descriptor (one end of a socketpair, or a pty master).
+ *
+ * DC motors, encoders, servos, IMU, buttons and battery are simulated well
+ * enough for the library, the DriveDC routines and sketches to run on a
+ * host. Replies can be delayed by a fixed processing latency and by the
+ * byte time of the emulated baud rate.
+ *
+ * Either call Start() to serve the link from a background thread, or call
+ * Poll() from your own loop. All setters / getters are thread safe.
+ */
+class MR4Emulator
+{
+public:
+    explicit MR4Emulator(int fd);
+    ~MR4Emulator();
+
+    bool Start(void);
+    void Stop(void);
+    void Poll(uint32_t waitUs);
+
+    // Link
+    void SetLatency(uint32_t latencyUs);
+    void SetBaudTiming(bool enable);
+    void SetFramingSupport(bool enable);
+    void SetClock(uint32_t offsetUs, int32_t driftPpm);
+    void SetReplyLoss(uint16_t permille);
+
+    // Stimuli
+    void SetButton(uint8_t num, bool pressed);
+    void SetBatteryVolt(float volt);
+    void SetIMUTilt(float roll, float pitch);
+
+    // Inspection
+    int16_t  GetMotorPower(uint8_t num);
+    int32_t  GetEncoderCounter(uint8_t num);
+    uint16_t GetServoAngle(uint8_t num);
+    float    GetYaw(void);
+    bool     IsFramed(void);
+    bool     IsTimestamped(void);
+    uint32_t GetTick(void);
+    uint32_t GetBaudrate(void);
+    uint32_t GetRequestCount(void);
+    uint32_t GetErrorCount(void);
+    uint32_t GetLostCount(void);
+    uint32_t GetProfileHash(void);
+
+private:
+    typedef struct
+    {
+        bool     motorReverse;
+        bool     encoderReverse;
+        int16_t  power;          // -100..100, after the motor direction
+        double   count;          // encoder counts, after the encoder direction
+        uint16_t ppr;
+        uint16_t maxRPM;
+        uint16_t speedMin, speedMax;
+        double   rotateLeft;     // counts to go of a rotate / move distance, <0 = none
+    } Motor_t;
+
+    typedef struct
+    {
+        bool     defined;
+        uint8_t  motor[2];       // 0 based motor index of left / right
+        bool     reverse[2];
+        double   base[2];        // counter reset point
+        uint8_t  task;           // 0 = none, else the SET_Drive_* command
+        bool     running;
+        uint64_t startUs;
+        uint32_t timeMs;
+        double   startDegs;
+        uint16_t degree;
+        int16_t  target;         // Gyro / Turn heading
+        int16_t  power;          // Gyro / Turn power
+        uint8_t  mode;           // Turn, 0 = single motor pivot
+        bool     brake;
+    } Drive_t;
+
+    typedef struct
+    {
+        uint64_t             dueUs;
+        std::vector<uint8_t> bytes;
+    } Pending_t;
+
+    int                   _fd;
+    std::mutex            _lock;
+    std::thread           _thread;
+    std::atomic<bool>     _running;
+    std::deque<Pending_t> _txQueue;
+    uint64_t              _txFreeUs;
+    uint64_t              _lastStepUs;
+    uint64_t              _lastRxUs;
+
+    // Link state
+    uint8_t  _rx[MR4EMU_RX_SIZE];
+    uint16_t _rxLen;
+    bool     _framed;
+    bool     _framingSupport;
+    bool     _stamped;
+    uint32_t _baudrate;
+    uint32_t _latencyUs;
+    bool     _baudTiming;
+    uint16_t _lossPermille;
+    uint32_t _lossSeed;
+    uint32_t _lost;
+    uint32_t _profileHash;   // of the last SET_PROFILE, 0 = none
+    uint8_t  _rxSeq;
+    uint32_t _requests;
+    uint32_t _errors;
+
+    // Board clock, the tick runs from construction with an offset and a drift
+    uint64_t _tickBaseUs;
+    uint32_t _tickOffsetUs;
+    int32_t  _tickDriftPpm;
+
+    // Simulated hardware
+    Motor_t  _motor[MR4EMU_DC_MOTOR_NUM];
+    Drive_t  _drive[MR4EMU_DRIVE_NUM];
+    uint16_t _servoAngle[MR4EMU_SERVO_NUM];
+    uint16_t _servoMin[MR4EMU_SERVO_NUM], _servoMax[MR4EMU_SERVO_NUM];
+    bool     _btn[MR4EMU_BUTTON_NUM];
+    double   _roll, _pitch, _yaw, _yawRate;
+    uint16_t _battMilliVolt;
+    uint8_t  _fullVolt, _cutOffVolt, _alarmVolt;   // 0.1 V
+
+    // Auto-send
+    uint8_t  _btnMode;
+    uint8_t  _encMode, _imuMode;
+    uint16_t _encIntervalMs, _imuIntervalMs;
+    uint64_t _encNextUs, _imuNextUs;
+    uint8_t  _taskMode;
+    uint8_t  _rotating, _driving;   // tasks running at the last SendTaskDone()
+
+    void Run(void);
+    void ReadLink(void);
+    void ParseLegacy(void);
+    void ParseFramed(void);
+    void Consume(uint16_t size);
+    uint32_t Tick(uint64_t now);
+
+    void Execute(uint8_t cmd, uint8_t* data, uint8_t size);
+    void Reply(uint8_t cmd, uint8_t seq, const uint8_t* data, uint8_t size, uint32_t delayUs);
+    void Status(uint8_t cmd, uint8_t status);
+    void ApplyProfile(const MMLowerProfile& profile);
+    void FlushDue(uint64_t now);
+
+    void    Step(uint64_t now);
+    void    StepDrive(uint8_t id, uint64_t now);
+    void    StartDrive(uint8_t cmd, uint8_t* data, uint8_t size);
+    double  MotorDegrees(uint8_t num);
+    double  DriveDegrees(uint8_t id);
+    double  DriveCount(uint8_t id);
+    void    SetDrivePower(uint8_t id, int16_t left, int16_t right);
+    uint8_t BatteryPercent(void);
+    uint8_t SampleReply(uint8_t cmd, uint8_t* r);
+    void    SendTelemetry(uint64_t now);
+    void    SendTaskDone(void);
+    void    SendButton(uint8_t num, uint8_t state);
+};
+
+#endif   // MR4EMULATOR_H
@@ -0,0 +1,115 @@
+/**
+ * @file ahrsbench.cpp
+ * @brief Host benchmark of the AHRS update, cycles per sample.
+ * @author MATRIX Robotics
+ *
+ * Usage: ahrsbench [-n samples]
+ *   Feeds a recorded-like stream (tilted, turning at 90 deg/s, 100 Hz,
+ *   with noise) to both filters and prints the time per Update() and the
+ *   attitude / heading error at the end. Cycles are the TSC on x86, the
+ *   nanoseconds of steady_clock elsewhere.
+ */
+#include "Util/AHRS.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <x86intrin.h>
+#    define AHRSBENCH_UNIT "cycles"
+static inline uint64_t Now(void)
+{
+    return __rdtsc();
+}
+#else
+#    define AHRSBENCH_UNIT "ns"
+static inline uint64_t Now(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+#endif
+
+#define RATE_HZ   100
+#define ROLL_DEG  10.0f
+#define PITCH_DEG -5.0f
+#define YAW_DPS   90.0f
+
+typedef struct
+{
+    float gx, gy, gz, ax, ay, az;
+} Sample_t;
+
+static uint32_t lcg = 1;
+
+// Uniform in -amp..amp
+static float Noise(float amp)
+{
+    lcg = lcg * 1664525u + 1013904223u;
+    return ((lcg >> 8) * (1.0f / 8388608.0f) - 1.0f) * amp;
+}
+
+// With a constant tilt a turn about the vertical is a constant body rate
+// along gravity, so gyro and acc are the gravity direction scaled.
+static std::vector<Sample_t> MakeStream(uint32_t n)
+{
+    float r = ROLL_DEG * 0.017453292f, p = PITCH_DEG * 0.017453292f;
+    float ux = -sinf(p), uy = sinf(r) * cosf(p), uz = cosf(r) * cosf(p);
+
+    std::vector<Sample_t> v(n);
+    for (Sample_t& s : v) {
+        s.gx = YAW_DPS * ux + Noise(0.5f);
+        s.gy = YAW_DPS * uy + Noise(0.5f);
+        s.gz = YAW_DPS * uz + Noise(0.5f);
+        s.ax = ux + Noise(0.02f);
+        s.ay = uy + Noise(0.02f);
+        s.az = uz + Noise(0.02f);
+    }
+    return v;
+}
+
+static void Run(const char* name, AHRS::FILTER filter, const std::vector<Sample_t>& v)
+{
+    AHRS        ahrs(filter);
+    const float dt = 1.0f / RATE_HZ;
+
+    uint64_t start = Now();
+    for (const Sample_t& s : v) ahrs.Update(s.gx, s.gy, s.gz, s.ax, s.ay, s.az, dt);
+    uint64_t took = Now() - start;
+
+    float roll, pitch, yaw;
+    ahrs.GetEuler(roll, pitch, yaw);
+    float turn = YAW_DPS * (v.size() - 1) / RATE_HZ;   // the first sample aligns
+    printf("%-9s %7.1f %s/update  roll err %6.2f  pitch err %6.2f  heading err %6.2f deg\n",
+           name,
+           (double)took / v.size(),
+           AHRSBENCH_UNIT,
+           roll - ROLL_DEG,
+           pitch - PITCH_DEG,
+           ahrs.GetHeading() - turn);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t n = 6000;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1] == 'n' && i + 1 < argc) {
+            n = strtoul(argv[++i], NULL, 10);
+        }
+        else {
+            fprintf(stderr, "usage: %s [-n samples]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (n < 2) n = 2;
+
+    std::vector<Sample_t> v = MakeStream(n);
+    Run("madgwick", AHRS::FILTER::MADGWICK, v);
+    Run("mahony", AHRS::FILTER::MAHONY, v);
+    return 0;
+}
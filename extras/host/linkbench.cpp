@@ -0,0 +1,159 @@
+/**
+ * @file linkbench.cpp
+ * @brief Host runner of the MMLower round-trip benchmark.
+ * @author MATRIX Robotics
+ *
+ * Usage: linkbench [-n iterations] [-l latency_us] [-b] [-d tty] [-w capture] [-r capture]
+ *   without -d the in-process emulator answers (-l / -b shape its timing),
+ *   with -d a lower board on a USB-UART adapter is measured.
+ *   -w records the link traffic, -r replays a recording (same -n) on the
+ *   virtual clock instead of talking to a board.
+ */
+#define LINKBENCH_MAX_ITER 10000
+
+#include "MMLowerHostTransport.h"
+#include "MMLowerReplayTransport.h"
+#include "MR4Emulator.h"
+#include "../../examples/zDeveloper Use/zDEV_LinkBench/LinkBench.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+static int OpenTty(const char* path, uint32_t baudrate)
+{
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) return -1;
+
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, baudrate);
+    tcsetattr(fd, TCSANOW, &tio);
+    return fd;
+}
+
+class FilePrint : public Print
+{
+public:
+    explicit FilePrint(FILE* f)
+        : _f(f)
+    {}
+    size_t write(uint8_t b) override { return fwrite(&b, 1, 1, _f); }
+    size_t write(const uint8_t* data, size_t size) override { return fwrite(data, 1, size, _f); }
+
+private:
+    FILE* _f;
+};
+
+int main(int argc, char** argv)
+{
+    uint16_t    iterations   = 1000;
+    uint32_t    latencyUs    = 0;
+    bool        baudTiming   = false;
+    bool        linkStats    = false;
+    uint16_t    lossPermille = 0;
+    const char* tty          = NULL;
+    const char* capPath      = NULL;
+    const char* replayPath   = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:bd:w:r:sp:")) != -1) {
+        switch (opt) {
+        case 'n': iterations = strtoul(optarg, NULL, 0); break;
+        case 'l': latencyUs = strtoul(optarg, NULL, 0); break;
+        case 'b': baudTiming = true; break;
+        case 'd': tty = optarg; break;
+        case 'w': capPath = optarg; break;
+        case 'r': replayPath = optarg; break;
+        case 's': linkStats = true; break;
+        case 'p': lossPermille = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-n iterations] [-l latency_us] [-b] [-d tty] [-w capture] [-r capture] [-s] [-p loss_permille]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    FILE*                 capFile = NULL;
+    FilePrint*            capOut  = NULL;
+    MMLowerCaptureStream* capture = NULL;
+    if (capPath != NULL) {
+        capFile = fopen(capPath, "wb");
+        if (capFile == NULL) {
+            perror(capPath);
+            return 1;
+        }
+        capOut  = new FilePrint(capFile);
+        capture = new MMLowerCaptureStream(*capOut);
+        mmL.setCapture(capture);
+    }
+
+    MR4Emulator*            emu    = NULL;
+    MMLowerTransport*       link   = NULL;
+    MMLowerReplayTransport* replay = NULL;
+    int                     fd     = -1;
+    if (replayPath != NULL) {
+        replay = new MMLowerReplayTransport();
+        if (!replay->Load(replayPath)) {
+            fprintf(stderr, "%s: not a capture\n", replayPath);
+            return 1;
+        }
+        link = replay;
+    } else if (tty != NULL) {
+        fd = OpenTty(tty, 57600);   // the rate MMLower::Init() starts at
+        if (fd < 0) {
+            perror(tty);
+            return 1;
+        }
+    } else {
+        int fds[2];
+        if (!MMLowerHostTransport::CreateSocketPair(fds)) {
+            perror("socketpair");
+            return 1;
+        }
+        fd  = fds[0];
+        emu = new MR4Emulator(fds[1]);
+        emu->SetLatency(latencyUs);
+        emu->SetBaudTiming(baudTiming);
+        emu->Start();
+    }
+    if (link == NULL) link = new MMLowerHostTransport(fd);
+
+    mmL.setTransport(link);
+    if (mmL.Init() != MMLower::RESULT::OK) {
+        fprintf(stderr, "Init failed\n");
+        return 1;
+    }
+    printf("%s, framed: %d, latency: %u us%s\n",
+           replayPath ? replayPath : (tty ? tty : "emulator"), mmL.isFramed(), latencyUs,
+           baudTiming ? ", wire time" : "");
+
+    // Lose replies only after Init(), a lost mode switch ack would desync the link.
+    if (emu != NULL) emu->SetReplyLoss(lossPermille);
+
+    LinkBench bench(Serial, iterations);
+    bench.RunAll();
+    if (emu != NULL && lossPermille > 0) printf("lost replies: %u\n", emu->GetLostCount());
+    if (linkStats) mmL.PrintLinkStats(Serial);
+
+    if (replay != NULL) {
+        printf("replay: %s, %u TX bytes differ (first at %lld), %u extra\n",
+               replay->IsDone() ? "complete" : "incomplete", replay->GetTxMismatch(),
+               (long long)replay->GetFirstMismatch(), replay->GetTxExtra());
+    }
+    if (capture != NULL) {
+        mmL.setCapture(NULL);
+        fprintf(stderr, "%u records captured\n", capture->GetRecordCount());
+        fclose(capFile);
+    }
+
+    delete capture;
+    delete capOut;
+    delete link;
+    delete emu;
+    return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file mr4emu.cpp
+ * @brief Standalone lower board emulator on a pty.
+ * @author MATRIX Robotics
+ *
+ * Usage: mr4emu [-l latency_us] [-b] [-n]
+ *   -l  processing latency added to every reply
+ *   -b  add the byte time of the link baud rate to every reply
+ *   -n  behave like old firmware without SET_COMM_FRAMING / SET_COMM_BAUDRATE
+ */
+#include "MMLowerHostTransport.h"
+#include "MR4Emulator.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t quit = 0;
+
+static void OnSignal(int)
+{
+    quit = 1;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t latencyUs = 0;
+    bool     baudTiming = false, framing = true;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:bn")) != -1) {
+        switch (opt) {
+        case 'l': latencyUs = strtoul(optarg, NULL, 0); break;
+        case 'b': baudTiming = true; break;
+        case 'n': framing = false; break;
+        default: fprintf(stderr, "usage: %s [-l latency_us] [-b] [-n]\n", argv[0]); return 1;
+        }
+    }
+
+    char name[64];
+    int  fd = MMLowerHostTransport::OpenPty(name, sizeof(name));
+    if (fd < 0) {
+        perror("pty");
+        return 1;
+    }
+    printf("%s\n", name);
+    fflush(stdout);
+
+    MR4Emulator emu(fd);
+    emu.SetLatency(latencyUs);
+    emu.SetBaudTiming(baudTiming);
+    emu.SetFramingSupport(framing);
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    while (!quit) {
+        emu.Poll(1000);
+    }
+    fprintf(stderr, "%u requests, %u errors\n", emu.GetRequestCount(), emu.GetErrorCount());
+    return 0;
+}
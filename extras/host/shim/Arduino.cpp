@@ -0,0 +1,75 @@
+/**
+ * @file Arduino.cpp
+ * @brief Minimal Arduino core for building MMLower on a Linux host.
+ * @author MATRIX Robotics
+ */
+#include "Arduino.h"
+#include "EEPROM.h"
+
+#include <sched.h>
+#include <time.h>
+
+static uint64_t MonotonicUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static const uint64_t startUs   = MonotonicUs();
+static bool           virtualOn = false;
+static uint64_t       virtualUs = 0;
+
+uint64_t HostClockUs(void)
+{
+    return virtualOn ? virtualUs : MonotonicUs() - startUs;
+}
+
+void HostClockVirtual(bool enable)
+{
+    if (enable && !virtualOn) virtualUs = MonotonicUs() - startUs;
+    virtualOn = enable;
+}
+
+void HostClockAdvanceTo(uint64_t us)
+{
+    if (virtualOn && us > virtualUs) virtualUs = us;
+}
+
+unsigned long millis(void)
+{
+    return (unsigned long)(uint32_t)(HostClockUs() / 1000);
+}
+
+unsigned long micros(void)
+{
+    return (unsigned long)(uint32_t)HostClockUs();
+}
+
+void delay(unsigned long ms)
+{
+    if (virtualOn) {
+        virtualUs += (uint64_t)ms * 1000;
+        return;
+    }
+    struct timespec ts = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    if (virtualOn) {
+        virtualUs += us;
+        return;
+    }
+    struct timespec ts = {(time_t)(us / 1000000), (long)(us % 1000000) * 1000L};
+    nanosleep(&ts, NULL);
+}
+
+void yield(void)
+{
+    sched_yield();
+}
+
+HardwareSerial Serial;
+EEPROMClass    EEPROM;
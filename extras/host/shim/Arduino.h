@@ -0,0 +1,171 @@
+/**
+ * @file Arduino.h
+ * @brief Minimal Arduino core for building MMLower on a Linux host.
+ * @author MATRIX Robotics
+ */
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define F(str)      (str)
+#define SERIAL_8N1  0x06
+#define HIGH        0x1
+#define LOW         0x0
+#define INPUT       0x0
+#define OUTPUT      0x1
+#define DEC         10
+#define HEX         16
+#define PIN_A0      14
+#define PIN_A1      15
+#define PIN_A2      16
+#define PIN_A3      17
+#define PIN_A4      18
+#define PIN_A5      19
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void          delay(unsigned long ms);
+void          delayMicroseconds(unsigned int us);
+void          yield(void);
+
+// Host only: run millis() / micros() / delay() on a virtual clock that moves
+// only when delayed or advanced, for deterministic replays.
+void     HostClockVirtual(bool enable);
+void     HostClockAdvanceTo(uint64_t us);
+uint64_t HostClockUs(void);
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int  digitalRead(uint8_t) { return LOW; }
+inline void noInterrupts(void) {}
+inline void interrupts(void) {}
+
+// Same shape as the ArduinoCore-API templates, std::min would clash on mixed types.
+template<class T, class L> auto min(const T& a, const L& b) -> decltype((b < a) ? b : a)
+{
+    return (b < a) ? b : a;
+}
+template<class T, class L> auto max(const T& a, const L& b) -> decltype((b < a) ? b : a)
+{
+    return (a < b) ? b : a;
+}
+
+class String
+{
+public:
+    String() {}
+    String(const char* str)
+        : _str(str)
+    {}
+    String(int value) { _str = std::to_string(value); }
+    String(float value, unsigned char decimals = 2)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+        _str = buf;
+    }
+
+    int indexOf(char c) const
+    {
+        size_t pos = _str.find(c);
+        return (pos == std::string::npos) ? -1 : (int)pos;
+    }
+    String substring(unsigned int from) const { return String(_str.substr(from).c_str()); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        return String(_str.substr(from, to - from).c_str());
+    }
+    long        toInt(void) const { return atol(_str.c_str()); }
+    const char* c_str(void) const { return _str.c_str(); }
+    unsigned    length(void) const { return _str.length(); }
+
+private:
+    std::string _str;
+};
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t* data, size_t size)
+    {
+        size_t n = 0;
+        while (size--) n += write(*data++);
+        return n;
+    }
+    virtual void flush(void) {}
+
+    size_t print(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+    size_t print(const String& str) { return print(str.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long value, int base = DEC)
+    {
+        char buf[24];
+        snprintf(buf, sizeof(buf), (base == HEX) ? "%lX" : "%ld", value);
+        return print(buf);
+    }
+    size_t print(unsigned long value, int base = DEC)
+    {
+        char buf[24];
+        snprintf(buf, sizeof(buf), (base == HEX) ? "%lX" : "%lu", value);
+        return print(buf);
+    }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(double value, int digits = 2)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.*f", digits, value);
+        return print(buf);
+    }
+    size_t println(void) { return print("\r\n"); }
+    template<typename T> size_t println(T value) { return print(value) + println(); }
+    template<typename T> size_t println(T value, int base) { return print(value, base) + println(); }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available(void) = 0;
+    virtual int read(void)      = 0;
+    virtual int peek(void) { return -1; }
+};
+
+/**
+ * @brief Serial port stand-in, output goes to stdout, input is always empty.
+ */
+class HardwareSerial : public Stream
+{
+public:
+    void   begin(unsigned long, uint16_t = SERIAL_8N1) {}
+    void   end(void) {}
+    int    available(void) override { return 0; }
+    int    read(void) override { return -1; }
+    size_t write(uint8_t b) override { return fwrite(&b, 1, 1, stdout); }
+    size_t write(const uint8_t* data, size_t size) override { return fwrite(data, 1, size, stdout); }
+    void   flush(void) override { fflush(stdout); }
+    using Print::write;
+    operator bool() { return true; }
+};
+
+class UART : public HardwareSerial
+{
+public:
+    UART(int, int) {}
+};
+
+extern HardwareSerial Serial;
+
+#endif   // HOST_ARDUINO_H
@@ -0,0 +1,37 @@
+/**
+ * @file EEPROM.h
+ * @brief RAM backed EEPROM stand-in for host builds.
+ * @author MATRIX Robotics
+ */
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <stdint.h>
+#include <string.h>
+
+class EEPROMClass
+{
+public:
+    uint8_t  read(int idx) { return _data[idx]; }
+    void     write(int idx, uint8_t value) { _data[idx] = value; }
+    void     update(int idx, uint8_t value) { _data[idx] = value; }
+    uint16_t length(void) { return sizeof(_data); }
+
+    template<typename T> T& get(int idx, T& t)
+    {
+        memcpy(&t, _data + idx, sizeof(T));
+        return t;
+    }
+    template<typename T> const T& put(int idx, const T& t)
+    {
+        memcpy(_data + idx, &t, sizeof(T));
+        return t;
+    }
+
+private:
+    uint8_t _data[8192];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif   // HOST_EEPROM_H
@@ -0,0 +1,17 @@
+/**
+ * @file SoftwareSerial.h
+ * @brief SoftwareSerial stand-in for host builds (use MMLowerHostTransport instead).
+ * @author MATRIX Robotics
+ */
+#ifndef HOST_SOFTWARESERIAL_H
+#define HOST_SOFTWARESERIAL_H
+
+#include "Arduino.h"
+
+class SoftwareSerial : public HardwareSerial
+{
+public:
+    SoftwareSerial(int, int) {}
+};
+
+#endif   // HOST_SOFTWARESERIAL_H
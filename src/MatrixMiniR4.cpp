@@ -24,106 +24,163 @@ MatrixMiniR4::MatrixMiniR4() {}
  * and pre init for all DC motors and servos =. It also configures the 
  * OLED display and the MJ2 gamepad.
  * 
+ * With fastBoot the lower board is polled instead of waited for
+ * (MMLower::InitFast), the motor and servo defaults go out as one burst
+ * (MMLower::SetDefaultConfig) and the fixed delays are skipped. The time
+ * of every stage is kept, see getBootTiming() / printBootTiming().
+ * 
+ * A fast boot also applies a profile stored with MMLowerProfile::Save() on
+ * top of the defaults, in one transfer that is skipped when the board
+ * already has it.
+ * 
+ * @param fastBoot Boot in a few hundred milliseconds instead of seconds.
  * @return true if initialization was successful, false otherwise.
  */
  
-bool MatrixMiniR4::begin()
+bool MatrixMiniR4::begin(bool fastBoot)
 {
-    MMLower::RESULT result = mmL.Init();
+    uint32_t bootStart = micros();
+    uint32_t stage     = bootStart;
+
+    MMLower::RESULT result = fastBoot ? mmL.InitFast() : mmL.Init();
+    _bootTiming.linkUs     = micros() - stage;
 
     LED.begin(7);
 	LED.setColor(1, 0, 0, 0);
 	LED.setColor(2, 0, 0, 0);
     Buzzer.begin(6);
 
+    stage = micros();
 	Motion.begin();
+    _bootTiming.imuUs = micros() - stage;
+
+    stage = micros();
+    if (!fastBoot || mmL.SetDefaultConfig() != MMLower::RESULT::OK) {
+        while (!M1.begin());
+        while (!M2.begin());
+        while (!M3.begin());
+        while (!M4.begin());
 
-    while (!M1.begin());
-    while (!M2.begin());
-    while (!M3.begin());
-    while (!M4.begin());
+        RC1.begin();
+        RC2.begin();
+        RC3.begin();
+        RC4.begin();
+    }
+    _bootTiming.configUs = micros() - stage;
 
-    RC1.begin();
-    RC2.begin();
-    RC3.begin();
-    RC4.begin();
+    stage = micros();
+    if (fastBoot) {
+        MMLowerProfile profile;
+        if (profile.Load()) mmL.ApplyProfile(profile);
+    }
+    _bootTiming.profileUs = micros() - stage;
 
+    stage = micros();
     OLED = Adafruit_SSD1306(128, 32, &Wire1, -1);
     OLED.begin(SSD1306_SWITCHCAPVCC, MATRIXMINIR4_OLED_ADDRESS);
     OLED.setTextColor(SSD1306_WHITE); //Default Color White
     OLED.clearDisplay();
     OLED.display();
+    _bootTiming.oledUs = micros() - stage;
 
+    stage = micros();
     /* CLK: D3R(11) , CMD: D2R(4) , SET: D3L(12) , DAT: D2L(5) */
     PS2.config_gamepad(11, 4, 12, 5, false, false);
+    _bootTiming.gamepadUs = micros() - stage;
 		
-	//Check the Init is ok or not.
-    if (result != MMLower::RESULT::OK) {
-        OLED.setCursor(4, 8);
-        OLED.setTextSize(2);
-        OLED.print(F("Init Error"));
-        OLED.display();
-		
-        while (true) {
-            for (uint8_t i = 0; i < 3; i++) {
-                Buzzer.Tone(700, 100);
-                delay(100);
-                Buzzer.NoTone();
-                delay(100);
-            }
-            delay(3000);
+	//Check the Init is ok or not. A failed link mode switch leaves a working link.
+    if (result == MMLower::RESULT::ERROR_INIT) initError();
+	
+    stage = micros();
+	if (!fastBoot) delay(200);
+	//Check the FW version is outdated or not.
+	uint8_t FWmajorVersion, FWminorVersion;
+	MMLower::RESULT resultFWCheck = mmL.GetFWVersion(FWmajorVersion, FWminorVersion);
+    _bootTiming.fwCheckUs = micros() - stage;
+    _bootTiming.totalUs   = micros() - bootStart;
+	if (resultFWCheck == MMLower::RESULT::OK && FWmajorVersion < 6) fwOutdated();
+
+    return true;
+}
+
+/**
+ * @brief Print the stage times of the last begin() in milliseconds, one line.
+ */
+void MatrixMiniR4::printBootTiming(Print& out)
+{
+    out.print(F("boot ms: link="));
+    out.print(_bootTiming.linkUs / 1000.0f, 1);
+    out.print(F(" imu="));
+    out.print(_bootTiming.imuUs / 1000.0f, 1);
+    out.print(F(" config="));
+    out.print(_bootTiming.configUs / 1000.0f, 1);
+    out.print(F(" profile="));
+    out.print(_bootTiming.profileUs / 1000.0f, 1);
+    out.print(F(" oled="));
+    out.print(_bootTiming.oledUs / 1000.0f, 1);
+    out.print(F(" gamepad="));
+    out.print(_bootTiming.gamepadUs / 1000.0f, 1);
+    out.print(F(" fw="));
+    out.print(_bootTiming.fwCheckUs / 1000.0f, 1);
+    out.print(F(" total="));
+    out.println(_bootTiming.totalUs / 1000.0f, 1);
+}
+
+// MMLower did not come up: show it and beep forever.
+void MatrixMiniR4::initError(void)
+{
+    OLED.setCursor(4, 8);
+    OLED.setTextSize(2);
+    OLED.print(F("Init Error"));
+    OLED.display();
+	
+    while (true) {
+        for (uint8_t i = 0; i < 3; i++) {
+            Buzzer.Tone(700, 100);
+            delay(100);
+            Buzzer.NoTone();
+            delay(100);
         }
+        delay(3000);
     }
+}
+
+// Lower board firmware older than v6.0: ask for an update until BTN_DOWN is pressed.
+void MatrixMiniR4::fwOutdated(void)
+{
+	for (uint8_t i = 0; i < 3; i++) {
+		Buzzer.Tone(550, 100);
+		delay(60);
+		Buzzer.NoTone();
+		delay(60);
+	}
 	
-	delay(200);
-	//Check the FW version is outdated or not.
-	String FWVersion_S;
-	MMLower::RESULT resultFWCheck = mmL.GetFWVersion(FWVersion_S);
-	if (resultFWCheck == MMLower::RESULT::OK) {
-		uint8_t FWmajorVersion, FWminorVersion;
-		uint8_t FWVersion_dotIndex = FWVersion_S.indexOf('.');
-		if (FWVersion_dotIndex != -1) {
-			FWmajorVersion = FWVersion_S.substring(0, FWVersion_dotIndex).toInt();
-			FWminorVersion = FWVersion_S.substring(FWVersion_dotIndex + 1).toInt();
-			if (FWmajorVersion < 6 || (FWmajorVersion == 6 && FWminorVersion < 0)) {
-				for (uint8_t i = 0; i < 3; i++) {
-					Buzzer.Tone(550, 100);
-					delay(60);
-					Buzzer.NoTone();
-					delay(60);
-				}
-				
-				unsigned long lastUpdate = millis();
-				bool showFirst = true;
-				OLED.clearDisplay();
-				OLED.setTextSize(1);
-				while (BTN_DOWN.getState() == false) {
-					if (millis() - lastUpdate >= 3000) {
-						lastUpdate = millis();
-						showFirst = !showFirst;
-					}
-					OLED.clearDisplay();
-					if (showFirst) {
-						OLED.setCursor(11, 5);
-						OLED.print(F("Firmware Outdated!"));
-						OLED.setCursor(11, 18);
-						OLED.print(F(" Required:  v6.0+ "));
-					} else {
-						OLED.setCursor(11, 5);
-						OLED.print(F(" Open MATRIXblock "));
-						OLED.setCursor(6, 18);
-						OLED.print(F("File->FirmwareUpdate"));
-					}
-					OLED.display();	
-					delay(1);
-				}
-				OLED.clearDisplay();
-				OLED.display();
-			}
+	unsigned long lastUpdate = millis();
+	bool showFirst = true;
+	OLED.clearDisplay();
+	OLED.setTextSize(1);
+	while (BTN_DOWN.getState() == false) {
+		if (millis() - lastUpdate >= 3000) {
+			lastUpdate = millis();
+			showFirst = !showFirst;
 		}
+		OLED.clearDisplay();
+		if (showFirst) {
+			OLED.setCursor(11, 5);
+			OLED.print(F("Firmware Outdated!"));
+			OLED.setCursor(11, 18);
+			OLED.print(F(" Required:  v6.0+ "));
+		} else {
+			OLED.setCursor(11, 5);
+			OLED.print(F(" Open MATRIXblock "));
+			OLED.setCursor(6, 18);
+			OLED.print(F("File->FirmwareUpdate"));
+		}
+		OLED.display();	
+		delay(1);
 	}
-
-    return true;
+	OLED.clearDisplay();
+	OLED.display();
 }
 
 MatrixMiniR4 MiniR4; ///< The MiniR4 Main Object.
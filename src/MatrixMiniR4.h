@@ -25,6 +25,7 @@
 #include "Modules/MiniR4PWM.h"
 #include "Modules/MiniR4Power.h"
 #include "Modules/MiniR4RC.h"
+#include "Modules/MiniR4Scheduler.h"
 #include "Modules/MiniR4Tone.h"
 
 #include "Modules/Sensors/MiniR4PS2X_lib.h"
@@ -49,8 +50,26 @@
 class MatrixMiniR4
 {
 public:
+    /**
+     * @brief Time spent in each stage of begin(), in microseconds.
+     */
+    typedef struct
+    {
+        uint32_t linkUs;      ///< Lower board link up (MMLower Init)
+        uint32_t imuUs;       ///< IMU calibration upload
+        uint32_t configUs;    ///< DC motor and servo defaults
+        uint32_t profileUs;   ///< EEPROM profile (MMLowerProfile), fast boot only
+        uint32_t oledUs;      ///< OLED init
+        uint32_t gamepadUs;   ///< PS2 / MJ2 gamepad config
+        uint32_t fwCheckUs;   ///< Firmware version check
+        uint32_t totalUs;
+    } BootTiming_t;
+
     MatrixMiniR4();
-    bool begin();
+    bool begin(bool fastBoot = false);
+
+    const BootTiming_t& getBootTiming(void) { return _bootTiming; }
+    void                printBootTiming(Print& out);
 
     // Power
     MiniR4Power PWR; ///< Controller Power management
@@ -122,7 +141,14 @@ public:
     // Vision
     MiniR4SmartCamReader Vision;  ///< mVision (UART 9600)
 
+    // Cooperative tasks
+    MiniR4Scheduler& Tasks = mr4Sched; ///< Runs MiniR4Task objects, see MiniR4Scheduler
+
 private:
+    BootTiming_t _bootTiming;
+
+    void initError(void);
+    void fwOutdated(void);
 };
 
 extern MatrixMiniR4 MiniR4;
@@ -4,37 +4,477 @@
  * @author MATRIX Robotics
  */
 #include "MMLower.h"
-#include "Util/BitConverter.h"
+#include "Util/CRC16.h"
+#include "Util/WireFormat.h"
+
+//--------------------------------------------------------------//
+//  Command descriptor table  //
+//--------------------------------------------------------------//
+/**
+ * @brief Maps a status byte of the lower board to a RESULT / Drive_RESULT.
+ */
+struct MMLowerStatusMap_t
+{
+    uint8_t code;
+    uint8_t result;
+};
+
+/**
+ * @brief Wire layout of one COMM_CMD.
+ *
+ * With hasStatus the first reply byte is a status, 0x00 is OK, codes found in
+ * statusMap return the mapped result and anything else returns ERROR.
+ */
+struct MMLowerCmdDesc_t
+{
+    MMLower::COMM_CMD         cmd;
+    uint8_t                   requestSize;
+    uint8_t                   replySize;
+    uint16_t                  timeout_ms;   // reply timeout, the ceiling of the adaptive one
+    bool                      hasStatus;
+    uint8_t                   statusNum;
+    const MMLowerStatusMap_t* statusMap;
+};
+
+#define MR4_STATUS(map) (uint8_t)(sizeof(map) / sizeof(map[0])), map
+#define MR4_ACK(cmd, requestSize, timeout_ms) \
+    {MMLower::COMM_CMD::cmd, requestSize, 1, timeout_ms, true, 0, NULL}
+#define MR4_ACK_MAP(cmd, requestSize, map) \
+    {MMLower::COMM_CMD::cmd, requestSize, 1, 100, true, MR4_STATUS(map)}
+#define MR4_GET(cmd, requestSize, replySize) \
+    {MMLower::COMM_CMD::cmd, requestSize, replySize, 100, false, 0, NULL}
+
+static constexpr MMLowerStatusMap_t servoPulseStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_SERVO_MIN_PULSE},
+    {0x03, (uint8_t)MMLower::RESULT::ERROR_SERVO_MAX_PULSE},
+};
+static constexpr MMLowerStatusMap_t servoRangeStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_SERVO_MIN_ANGLE},
+    {0x03, (uint8_t)MMLower::RESULT::ERROR_SERVO_MAX_ANGLE},
+};
+static constexpr MMLowerStatusMap_t echoModeStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_MODE},
+    {0x03, (uint8_t)MMLower::RESULT::ERROR_INTERVAL},
+};
+static constexpr MMLowerStatusMap_t imuInitStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_IMU_ACC_FSR},
+    {0x03, (uint8_t)MMLower::RESULT::ERROR_IMU_GYRO_FSR},
+    {0x04, (uint8_t)MMLower::RESULT::ERROR_IMU_ODR},
+};
+static constexpr MMLowerStatusMap_t powerParamStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_POWER_VOLT_RANGE},
+};
+static constexpr MMLowerStatusMap_t motorPowerStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_MOTOR_POWER},
+};
+static constexpr MMLowerStatusMap_t motorSpeedStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_MOTOR_SPEED},
+};
+static constexpr MMLowerStatusMap_t allMotorStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_MOTOR1_SPEED},
+    {0x03, (uint8_t)MMLower::RESULT::ERROR_MOTOR2_SPEED},
+    {0x04, (uint8_t)MMLower::RESULT::ERROR_MOTOR3_SPEED},
+    {0x05, (uint8_t)MMLower::RESULT::ERROR_MOTOR4_SPEED},
+};
+static constexpr MMLowerStatusMap_t servoAngleStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_SERVO_ANGLE},
+};
+static constexpr MMLowerStatusMap_t allServoStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_SERVO1_ANGLE},
+    {0x03, (uint8_t)MMLower::RESULT::ERROR_SERVO2_ANGLE},
+    {0x04, (uint8_t)MMLower::RESULT::ERROR_SERVO3_ANGLE},
+    {0x05, (uint8_t)MMLower::RESULT::ERROR_SERVO4_ANGLE},
+};
+static constexpr MMLowerStatusMap_t batchStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_MOTOR1_SPEED},
+    {0x03, (uint8_t)MMLower::RESULT::ERROR_MOTOR2_SPEED},
+    {0x04, (uint8_t)MMLower::RESULT::ERROR_MOTOR3_SPEED},
+    {0x05, (uint8_t)MMLower::RESULT::ERROR_MOTOR4_SPEED},
+    {0x06, (uint8_t)MMLower::RESULT::ERROR_SERVO1_ANGLE},
+    {0x07, (uint8_t)MMLower::RESULT::ERROR_SERVO2_ANGLE},
+    {0x08, (uint8_t)MMLower::RESULT::ERROR_SERVO3_ANGLE},
+    {0x09, (uint8_t)MMLower::RESULT::ERROR_SERVO4_ANGLE},
+};
+static constexpr MMLowerStatusMap_t moveDistanceStatus[] = {
+    {0x02, (uint8_t)MMLower::RESULT::ERROR_MOVE_ACTION},
+    {0x03, (uint8_t)MMLower::RESULT::ERROR_MOVE_SPEED},
+    {0x04, (uint8_t)MMLower::RESULT::ERROR_MOVE_ENCODER},
+};
+static constexpr MMLowerStatusMap_t driveParamStatus[] = {
+    {0x08, (uint8_t)MMLower::Drive_RESULT::ERROR_Drive_Param},
+    {0x09, (uint8_t)MMLower::Drive_RESULT::ERROR_Drive_IMU_idle},
+};
+static constexpr MMLowerStatusMap_t driveDefineStatus[] = {
+    {0x07, (uint8_t)MMLower::Drive_RESULT::ERROR_Drive_Define},
+};
+static constexpr MMLowerStatusMap_t driveMoveStatus[] = {
+    {0x02, (uint8_t)MMLower::Drive_RESULT::ERROR_MOTOR_POWER},
+    {0x07, (uint8_t)MMLower::Drive_RESULT::ERROR_Drive_Define},
+};
+
+// clang-format off
+static constexpr MMLowerCmdDesc_t cmdTable[] = {
+    // Setting-Init
+    MR4_ACK    (SET_DC_MOTOR_DIR,             2, 100),
+    MR4_ACK    (SET_ENCODER_DIR,              2, 100),
+    MR4_ACK    (SET_SERVO_DIR,                2, 100),
+    MR4_ACK    (SET_DC_MOTOR_SPEED_RANGE,     5, 100),
+    MR4_ACK_MAP(SET_SERVO_PULSE_RANGE,        5, servoPulseStatus),
+    MR4_ACK_MAP(SET_SERVO_ANGLE_RANGE,        5, servoRangeStatus),
+    MR4_ACK_MAP(SET_BUTTON_INIT,              1, echoModeStatus),
+    MR4_ACK_MAP(SET_ENCODER_ECHO_MODE,        3, echoModeStatus),
+    MR4_ACK_MAP(SET_IMU_ECHO_MODE,            3, echoModeStatus),
+    MR4_ACK_MAP(SET_IMU_INIT,                 4, imuInitStatus),
+    MR4_ACK_MAP(SET_POWER_PARAM,              3, powerParamStatus),
+    MR4_ACK    (SET_ENCODER_PPR_MAXSPEED,     6, 100),
+    MR4_ACK    (SET_ALL_ENCODER_PPR,         10, 100),
+    MR4_ACK    (SET_IMU_Calib_Data,          26, 100),
+    MR4_ACK_MAP(SET_TASK_ECHO_MODE,           1, echoModeStatus),
+    // Setting-Commonly used
+    MR4_ACK_MAP(SET_DC_MOTOR_POWER,           4, motorPowerStatus),
+    MR4_ACK_MAP(SET_DC_MOTOR_SPEED,           4, motorSpeedStatus),
+    MR4_ACK    (SET_DC_MOTOR_ROTATE,          5, 100),
+    MR4_ACK_MAP(SET_ALL_DC_MOTOR_SPEED,      10, allMotorStatus),
+    MR4_ACK_MAP(SET_SERVO_ANGLE,              3, servoAngleStatus),
+    MR4_ACK_MAP(SET_ALL_SERVO_ANGLE,          8, allServoStatus),
+    MR4_ACK_MAP(SET_MOVE_DISTANCE,            6, moveDistanceStatus),
+    MR4_ACK    (SET_ENCODER_RESET_COUNTER,    1, 100),
+    MR4_ACK    (SET_STATE_LED,                4, 100),
+    MR4_ACK    (SET_IMU_TO_ZERO,              0, 1000),
+    MR4_ACK    (SET_PID_PARAM,                8, 100),
+    MR4_ACK    (SET_DC_BRAKE,                 1, 100),
+    MR4_ACK    (SET_ALL_DC_BRAKE,             1, 100),
+    MR4_ACK_MAP(SET_ALL_DC_MOTOR_POWER,      10, allMotorStatus),
+    // Getting
+    MR4_GET    (GET_BUTTON_STATE,             1, 1),
+    MR4_GET    (GET_BUTTONS_STATE,            0, 2),
+    MR4_GET    (GET_ENCODER_COUNTER,          1, 4),
+    MR4_GET    (GET_ALL_ENCODER_COUNTER,      0, 16),
+    MR4_GET    (GET_IMU_EULER,                0, 6),
+    MR4_GET    (GET_IMU_GYRO,                 0, 6),
+    MR4_GET    (GET_IMU_ACC,                  0, 6),
+    MR4_GET    (GET_POWER_INFO,               0, 3),
+    MR4_GET    (GET_ROTATE_STATE,             1, 1),
+    MR4_GET    (GET_SPEED_ALL_DC_MOTOR,       0, 17),
+    MR4_GET    (GET_IMU_ACC_NOcal,            0, 13),
+    MR4_GET    (GET_ENCODER_DEGREES,          1, 4),
+    // Drive DC
+    MR4_ACK    (SET_DC_BRAKE_TYPE,            2, 100),
+    MR4_ACK    (SET_DC_ALL_BRAKE_TYPE,        5, 100),
+    MR4_ACK_MAP(SET_DC_TWO_MOTOR_PARAM,       5, driveParamStatus),
+    MR4_ACK    (SET_DC_TWO_MoveSync_PID,     13, 100),
+    MR4_ACK    (SET_DC_TWO_MoveGyro_PID,     13, 100),
+    MR4_ACK    (SET_DC_TWO_TurnGyro_PID,     13, 100),
+    MR4_ACK_MAP(SET_DC_TWO_MOTOR_Reset_count, 2, driveMoveStatus),
+    MR4_ACK_MAP(SET_DC_TWO_MOTOR_PPR,         5, driveDefineStatus),
+    MR4_ACK_MAP(SET_DC_MOTOR_TYPE,            2, driveDefineStatus),
+    MR4_ACK_MAP(SET_Drive_Move,               5, driveMoveStatus),
+    MR4_ACK_MAP(SET_Drive_MoveDegs,           9, driveMoveStatus),
+    MR4_ACK_MAP(SET_Drive_MoveTime,          11, driveMoveStatus),
+    MR4_ACK_MAP(SET_Drive_MoveSync,           5, driveMoveStatus),
+    MR4_ACK_MAP(SET_Drive_MoveSyncDegs,       9, driveMoveStatus),
+    MR4_ACK_MAP(SET_Drive_MoveSyncTime,      11, driveMoveStatus),
+    MR4_ACK_MAP(SET_Drive_Gyro,               5, driveMoveStatus),
+    MR4_ACK_MAP(SET_Drive_GyroDegs,           9, driveMoveStatus),
+    MR4_ACK_MAP(SET_Drive_GyroTime,          11, driveMoveStatus),
+    MR4_ACK_MAP(SET_Drive_Turn,               8, driveMoveStatus),
+    MR4_ACK_MAP(SET_Drive_Brake,              2, driveMoveStatus),
+    MR4_GET    (GET_Task_Done_Status,         2, 1),
+    MR4_GET    (GET_Drive_Degress,            1, 4),
+    MR4_GET    (GET_Drive_Counter,            1, 4),
+    // Other-Info
+    MR4_GET    (ECHO_TEST,                    1, 1),
+    MR4_GET    (F_VERSION,                    0, 1),
+    MR4_GET    (F_BUILD_DAY,                  0, 4),
+    MR4_GET    (F_DESCRIPTOR,                 0, 1),   // length, the text follows
+    MR4_GET    (READ_MODEL_INDEX,             0, 1),
+    MR4_GET    (READ_ALL_INFO,                0, 6),
+    MR4_GET    (RUN_AUTO_QC,                  0, 1),
+    MR4_ACK    (SET_COMM_FRAMING,             1, 50),
+    MR4_ACK    (SET_COMM_BAUDRATE,            4, 50),
+    MR4_ACK    (SET_COMM_TIMESTAMP,           1, 50),
+    MR4_GET    (GET_PROFILE_HASH,             0, 4),
+    MR4_ACK    (SET_PROFILE, 1 + MR4_PROFILE_BLOB_SIZE, 100),   // version, blob
+    MR4_GET    (GET_SNAPSHOT,                 2, 2),   // fields, then each field
+    MR4_GET    (GET_SAMPLE,                   3, 2),   // sample number, then the reply of cmd
+    MR4_ACK_MAP(SET_BATCH,                   18, batchStatus),   // motor ops and values, servo mask and angles
+};
+// clang-format on
+
+/**
+ * @brief Compile-time lookup, a COMM_CMD missing from cmdTable fails to build.
+ */
+static constexpr const MMLowerCmdDesc_t& FindCmd(MMLower::COMM_CMD cmd, uint8_t i = 0)
+{
+    return (cmdTable[i].cmd == cmd) ? cmdTable[i] : FindCmd(cmd, i + 1);
+}
+
+static_assert(sizeof(cmdTable) / sizeof(cmdTable[0]) == MatrixR4_CMD_NUM,
+              "MatrixR4_CMD_NUM does not match cmdTable");
+
+// Run-time lookup by opcode, for frames and statistics. -1 if unknown.
+static int8_t LookupCmd(uint8_t cmd)
+{
+    for (uint8_t i = 0; i < MatrixR4_CMD_NUM; i++) {
+        if ((uint8_t)cmdTable[i].cmd == cmd) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Send a command whose reply is a single status byte.
+ *
+ * The arguments are serialized little endian in order, straight into the TX
+ * ring. Their total size is checked against the descriptor at compile time.
+ */
+template<MMLower::COMM_CMD CMD, typename R, typename... Args>
+R MMLower::Call(Args... args)
+{
+    constexpr const MMLowerCmdDesc_t& desc = FindCmd(CMD);
+    static_assert(WireLayout<Args...>::Size == desc.requestSize, "request does not match cmdTable");
+    static_assert(desc.hasStatus, "command has a data reply, use Query()");
+
+    uint8_t* p = TxBegin(desc.cmd, desc.requestSize);
+    if (p == NULL) return (R)RESULT::ERROR;
+    WireLayout<Args...>::PackTo(p, args...);
+    TxEnd();
+
+    uint8_t status[1];
+    return (R)Transact(desc, status);
+}
+
+/**
+ * @brief Send a command and read its reply into the caller's buffer.
+ */
+template<MMLower::COMM_CMD CMD, typename R, size_t N, typename... Args>
+R MMLower::Query(uint8_t (&reply)[N], Args... args)
+{
+    constexpr const MMLowerCmdDesc_t& desc = FindCmd(CMD);
+    static_assert(WireLayout<Args...>::Size == desc.requestSize, "request does not match cmdTable");
+    static_assert(N >= desc.replySize, "reply buffer is smaller than cmdTable");
+
+    uint8_t* p = TxBegin(desc.cmd, desc.requestSize);
+    if (p == NULL) return (R)RESULT::ERROR;
+    WireLayout<Args...>::PackTo(p, args...);
+    TxEnd();
+
+    return (R)Transact(desc, reply);
+}
+
+/**
+ * @brief Queue a command like Call() / Query() without waiting for it.
+ */
+template<MMLower::COMM_CMD CMD, typename... Args>
+MMLower::AsyncHandle MMLower::CallAsync(AsyncCallback callback, Args... args)
+{
+    constexpr const MMLowerCmdDesc_t& desc = FindCmd(CMD);
+    static_assert(WireLayout<Args...>::Size == desc.requestSize, "request does not match cmdTable");
+    static_assert(desc.replySize <= MatrixR4_ASYNC_REPLY_SIZE, "reply does not fit an async slot");
+
+    AsyncHandle handle = AsyncClaim(desc.cmd, desc.replySize, &desc, callback, RtoUs(desc));
+    if (handle < 0) return -1;
+
+    uint8_t* p = TxBegin(desc.cmd, desc.requestSize);
+    if (p == NULL) {
+        asyncSlots[handle].state = ASYNC_STATE::FREE;
+        return -1;
+    }
+    WireLayout<Args...>::PackTo(p, args...);
+    TxEnd();
+    asyncSlots[handle].seq = txSeq;
+    return handle;
+}
+
+/**
+ * @brief Queue one command of a burst sent back to back, PipelineAwait()
+ * then waits for all of them.
+ *
+ * The command takes a free async slot, else one freed by awaiting the
+ * burst so far. When other code holds every slot it is sent with Call().
+ *
+ * @return false if the TX ring took nothing, the command was not sent.
+ */
+template<MMLower::COMM_CMD CMD, typename... Args>
+bool MMLower::PipelineCall(AsyncHandle* handles, uint8_t& count, RESULT& result, Args... args)
+{
+    AsyncHandle handle = CallAsync<CMD>(NULL, args...);
+    if (handle < 0 && count > 0) {
+        PipelineAwait(handles, count, result);
+        handle = CallAsync<CMD>(NULL, args...);
+    }
+    if (handle >= 0) {
+        handles[count++] = handle;
+        return true;
+    }
+    if (AsyncSlotFree()) return false;
+
+    RESULT r = Call<CMD>(args...);
+    if (result == RESULT::OK && r != RESULT::OK) result = r;
+    return true;
+}
+
+// Wait for the commands PipelineCall() queued, keep the first failing result.
+void MMLower::PipelineAwait(AsyncHandle* handles, uint8_t& count, RESULT& result)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        RESULT r = await(handles[i]);
+        if (result == RESULT::OK && r != RESULT::OK) result = r;
+    }
+    count = 0;
+}
+
+static uint8_t MapStatus(const MMLowerCmdDesc_t& desc, uint8_t status)
+{
+    if (status == 0x00) return (uint8_t)MMLower::RESULT::OK;
+    for (uint8_t i = 0; i < desc.statusNum; i++) {
+        if (desc.statusMap[i].code == status) return desc.statusMap[i].result;
+    }
+    return (uint8_t)MMLower::RESULT::ERROR;
+}
+
+/**
+ * @brief Wait for the reply of the request just queued by TxBegin() / TxEnd().
+ *
+ * Returns a RESULT value; the first entries of Drive_RESULT use the same codes.
+ *
+ * @param timeoutUs 0 = the adaptive timeout of the command.
+ */
+uint8_t MMLower::Transact(const MMLowerCmdDesc_t& desc, uint8_t* reply, uint32_t timeoutUs)
+{
+    uint32_t start = micros();
+    uint8_t  result;
+    if (!WaitData(desc.cmd, desc.replySize, timeoutUs ? timeoutUs : RtoUs(desc))) {
+        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
+        result = (uint8_t)MMLower::RESULT::ERROR_WAIT_TIMEOUT;
+    } else if (!CommReadData(reply, desc.replySize)) {
+        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
+        result = (uint8_t)MMLower::RESULT::ERROR_READ_TIMEOUT;
+    } else {
+        result = desc.hasStatus ? MapStatus(desc, reply[0]) : (uint8_t)MMLower::RESULT::OK;
+        MR4_DEBUG_PRINT_TAIL(result);
+    }
+    uint32_t latency = micros() - start;
+    CountCall(desc, result, latency);
+    RtoUpdate(desc, result, latency);
+    // Callbacks held back while this call waited run before it returns
+    FireCallbacks();
+    return result;
+}
 
 MMLower::MMLower(uint8_t rx, uint8_t tx, uint32_t baudrate)
     : _baudrate(baudrate)
 {
-    commSerial = new SoftwareSerial(rx, tx);
+    commSerial = new MMLowerSoftSerialTransport(new SoftwareSerial(rx, tx));
+    InitState();
+}
+
+MMLower::MMLower(MMLowerTransport* transport, uint32_t baudrate)
+    : _baudrate(baudrate)
+    , commSerial(transport)
+{
+    InitState();
+}
+
+void MMLower::InitState(void)
+{
+    callbackFunc      = NULL;
+    taskCallback      = NULL;
+    idleCallback      = NULL;
+    schedulerCallback = NULL;
+    imuCallback       = NULL;
+
+    asyncOrder   = 0;
+    framed       = false;
+    txSeq        = 0;
+    rxRawLen     = 0;
+    rxLen        = 0;
+    rxPos        = 0;
+    rxState      = COMM_STATE::WAIT_LEAD;
+    rxWaitCmd    = COMM_CMD::NONE;
+    capture      = NULL;
+    ResetLinkStats();
+    RtoReset();
+    stamped      = false;
+    rxHasTick    = false;
+    rxTick       = 0;
+    rxTickUs     = 0;
+    txHead       = 0;
+    txTail       = 0;
+    txWrap       = MatrixR4_TX_BUF_SIZE;
+    for (uint8_t i = 0; i < MatrixR4_ASYNC_SLOT_NUM; i++) {
+        asyncSlots[i].state = ASYNC_STATE::FREE;
+    }
+    eventHead  = 0;
+    eventCount = 0;
+    imuPending = false;
+    firing     = false;
+    BatchClear();
+    snapshotProbe = PROBE::UNKNOWN;
+    sampleProbe   = PROBE::UNKNOWN;
+    batchProbe    = PROBE::UNKNOWN;
+    sampleSeq[0]  = sampleSeq[1] = 0;
+
+    for (uint8_t i = 0; i < MatrixR4_ENCODER_NUM; i++) {
+        enCounter[i]   = 0;
+        enCounter64[i] = 0;
+    }
+    enReconcileMs     = 1000;
+    enReconcileAt     = 0;
+    enReconcileSentUs = 0;
+    enReconcileHandle = -1;
+    clockSync.Reset();
+    clockSyncMs = 1000;
+    clockSyncAt = 0;
+    for (uint8_t i = 0; i < MatrixR4_BUTTON_NUM; i++) {
+        btnState[i] = false;
+    }
+    enCounterUs = imuEulerUs = imuGyroUs = imuAccUs = btnStateUs = 0;
+    subscribed                                                   = 0;
+    telemetryMaxAgeUs                                            = 20000;
+    for (uint8_t t = 0; t < 2; t++) {
+        taskRunning[t] = 0;
+        taskUnsure[t]  = 0;
+        taskPolled[t]  = 0;
+        for (uint8_t i = 0; i < MatrixR4_DC_MOTOR_NUM; i++) {
+            taskDoneUs[t][i] = 0;
+        }
+    }
 }
 
+/**
+ * @brief Wait for the lower board to power up, then EchoTest it every 250 ms
+ * until it answers.
+ *
+ * @param timeout_ms Give up after retrying this long, ERROR_INIT.
+ * @return OK, or the error of a link mode switch (see LinkSetup()); the
+ * link then works in the mode it had.
+ */
 MMLower::RESULT MMLower::Init(uint32_t timeout_ms)
 {
     MR4_DEBUG_PRINT_HEADER(F("[Init]"));
 
-	commSerial->begin(_baudrate, SERIAL_8N1);
+	commSerial->begin(_baudrate);
+	framed = false;
+	stamped = false;
+	txHead = txTail = 0;
+	clockSync.Reset();
 	
 	delay(1000);
 	
-	uint32_t asd = 0;
-
-    //asd = millis() + 5000;
-    while (asd < 50) {
+	uint32_t start = millis();
+    while (true) {
 		
         RESULT result = EchoTest();
 		delay(250);
         if (result == RESULT::OK) {
-            MR4_DEBUG_PRINT_TAIL(F("OK"));
-            return RESULT::OK;
+            result = LinkSetup();
+            MR4_DEBUG_PRINT_TAIL((int)result);
+            return result;
         } else {
             MR4_DEBUG_PRINT(F("EchoTest Failed! Result: "));
             MR4_DEBUG_PRINTLN((int)result);
         }
-		asd++;
+		if ((uint32_t)(millis() - start) >= timeout_ms) break;
     }
     
 	MR4_DEBUG_PRINT_TAIL(F("ERROR_INIT"));
@@ -42,2287 +482,2978 @@ MMLower::RESULT MMLower::Init(uint32_t timeout_ms)
 	//return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetDCMotorDir(uint8_t num, DIR dir)
-{
-    MR4_DEBUG_PRINT_HEADER(F("[SetDCMotorDir]"));
-
-    uint8_t data[2] = {(1 << --num), (uint8_t)dir};
-    CommSendData(COMM_CMD::SET_DC_MOTOR_DIR, data, 2);
-    if (!WaitData(COMM_CMD::SET_DC_MOTOR_DIR, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
+/**
+ * @brief Init() without the fixed delays: probe the lower board with short
+ * EchoTests until it answers, backing off from 1 ms to
+ * MatrixR4_PROBE_GAP_MAX_MS between probes.
+ *
+ * @param timeout_ms Give up after this long, ERROR_INIT.
+ * @return As Init().
+ */
+MMLower::RESULT MMLower::InitFast(uint32_t timeout_ms)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[InitFast]"));
+
+    commSerial->begin(_baudrate);
+    framed  = false;
+    stamped = false;
+    txHead = txTail = 0;
+    clockSync.Reset();
+
+    uint32_t start = millis();
+    uint16_t gapMs = 1;
+    while (EchoProbe(MatrixR4_PROBE_TIMEOUT_US) != RESULT::OK) {
+        if ((uint32_t)(millis() - start) + gapMs > timeout_ms) {
+            MR4_DEBUG_PRINT_TAIL(F("ERROR_INIT"));
+            return RESULT::ERROR_INIT;
+        }
+        delay(gapMs);
+        gapMs = (gapMs * 2 < MatrixR4_PROBE_GAP_MAX_MS) ? gapMs * 2 : MatrixR4_PROBE_GAP_MAX_MS;
     }
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+    RESULT result = LinkSetup();
+    MR4_DEBUG_PRINT_TAIL((int)result);
+    return result;
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+/**
+ * @brief Put every DC motor and servo in its power-on configuration
+ * (speed range 0..100, encoder cleared, power 0, forward, servo range
+ * 0..180) with one request per setting for all ports, sent back to back.
+ *
+ * Same result as MiniR4DC::begin() and MiniR4RC::begin() on every port.
+ */
+MMLower::RESULT MMLower::SetDefaultConfig(void)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetDefaultConfig]"));
+
+    const uint8_t motors = (1 << MatrixR4_DC_MOTOR_NUM) - 1;
+    const uint8_t servos = (1 << MatrixR4_SERVO_NUM) - 1;
+    AsyncHandle   handles[MatrixR4_ASYNC_SLOT_NUM];
+    uint8_t       count  = 0;
+    RESULT        result = RESULT::OK;
+    bool          sent   = PipelineCall<COMM_CMD::SET_DC_MOTOR_SPEED_RANGE>(
+        handles, count, result, motors, (uint16_t)0, (uint16_t)100);
+    sent = sent && PipelineCall<COMM_CMD::SET_ENCODER_RESET_COUNTER>(handles, count, result, motors);
+    sent = sent && PipelineCall<COMM_CMD::SET_DC_MOTOR_POWER>(
+        handles, count, result, motors, (uint8_t)0, (int16_t)0);
+    sent = sent && PipelineCall<COMM_CMD::SET_DC_MOTOR_DIR>(
+        handles, count, result, motors, (uint8_t)DIR::FORWARD);
+    sent = sent && PipelineCall<COMM_CMD::SET_SERVO_ANGLE_RANGE>(
+        handles, count, result, servos, (uint16_t)0, (uint16_t)180);
+    PipelineAwait(handles, count, result);
+    if (!sent) result = RESULT::ERROR;
+
+    MR4_DEBUG_PRINT_TAIL((int)result);
+    return result;
 }
 
-MMLower::RESULT MMLower::SetEncoderDir(uint8_t num, DIR dir)
+/**
+ * @brief Configure the lower board from a profile.
+ *
+ * On a framed link the board is asked for the hash of the profile it holds
+ * first; when it matches nothing is sent, otherwise the whole profile goes
+ * out as one SET_PROFILE frame. Legacy links and firmware without profile
+ * support get the sections as individual commands, sent back to back.
+ *
+ * @param force Send even when the board reports the same profile.
+ */
+MMLower::RESULT MMLower::ApplyProfile(const MMLowerProfile& profile, bool force)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetEncoderDir]"));
+    MR4_DEBUG_PRINT_HEADER(F("[ApplyProfile]"));
 
-    uint8_t data[2] = {(1 << --num), (uint8_t)dir};
-    CommSendData(COMM_CMD::SET_ENCODER_DIR, data, 2);
-    if (!WaitData(COMM_CMD::SET_ENCODER_DIR, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
-
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
+    uint32_t boardHash;
+    if (!framed || GetProfileHash(boardHash) != RESULT::OK) {
+        RESULT result = ApplyProfileCommands(profile);
+        MR4_DEBUG_PRINT_TAIL((int)result);
+        return result;
     }
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
+    uint8_t payload[1 + MR4_PROFILE_BLOB_SIZE];
+    payload[0] = MR4_PROFILE_VERSION;
+    profile.Serialize(payload + 1);
+    if (!force && boardHash == MMLowerProfile::Hash(payload, sizeof(payload))) {
+        MR4_DEBUG_PRINT_TAIL(F("up to date"));
         return RESULT::OK;
     }
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    constexpr const MMLowerCmdDesc_t& desc = FindCmd(COMM_CMD::SET_PROFILE);
+    uint8_t*                          p    = TxBegin(desc.cmd, desc.requestSize);
+    if (p == NULL) return RESULT::ERROR;
+    memcpy(p, payload, sizeof(payload));
+    TxEnd();
+
+    uint8_t reply[1];
+    return (RESULT)Transact(desc, reply);
 }
 
-MMLower::RESULT MMLower::SetServoDir(uint8_t num, DIR dir)
+/**
+ * @brief Hash of the profile the lower board holds (MMLowerProfile::Hash()),
+ * 0 when it has none.
+ */
+MMLower::RESULT MMLower::GetProfileHash(uint32_t& hash)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetServoDir]"));
+    MR4_DEBUG_PRINT_HEADER(F("[GetProfileHash]"));
 
-    uint8_t data[2] = {(1 << --num), (uint8_t)dir};
-    CommSendData(COMM_CMD::SET_SERVO_DIR, data, 2);
-    if (!WaitData(COMM_CMD::SET_SERVO_DIR, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
-
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+    // Firmware without profiles does not answer, keep that short.
+    constexpr const MMLowerCmdDesc_t& desc = FindCmd(COMM_CMD::GET_PROFILE_HASH);
+    if (TxBegin(desc.cmd, desc.requestSize) == NULL) return RESULT::ERROR;
+    TxEnd();
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+    uint8_t b[4];
+    RESULT  result = (RESULT)Transact(desc, b, MatrixR4_PROBE_TIMEOUT_US);
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    WireUnpack(b, hash);
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetDCMotorSpeedRange(uint8_t num, uint16_t min, uint16_t max)
-{
-    MR4_DEBUG_PRINT_HEADER(F("[SetDCMotorSpeedRange]"));
-
-    uint8_t data[5];
-    data[0] = (1 << --num);
-    BitConverter::GetBytes(data + 1, min);
-    BitConverter::GetBytes(data + 3, max);
-    CommSendData(COMM_CMD::SET_DC_MOTOR_SPEED_RANGE, data, 5);
-    if (!WaitData(COMM_CMD::SET_DC_MOTOR_SPEED_RANGE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
+// Fallback of ApplyProfile(): the sections as the commands they stand for.
+MMLower::RESULT MMLower::ApplyProfileCommands(const MMLowerProfile& profile)
+{
+    AsyncHandle handles[MatrixR4_ASYNC_SLOT_NUM];
+    uint8_t     count  = 0;
+    RESULT      result = RESULT::OK;
+    bool        sent   = true;
+
+    const uint16_t sections = profile.sections;
+    const uint8_t  ports    = (1 << MR4_PROFILE_MOTOR_NUM) - 1;
+    const uint8_t  servos   = (1 << MR4_PROFILE_SERVO_NUM) - 1;
+
+    if (sections & MMLowerProfile::DIR) {
+        const uint8_t rev[3] = {profile.motorReverse, profile.encoderReverse, profile.servoReverse};
+        const uint8_t all[3] = {ports, ports, servos};
+        for (uint8_t d = 0; sent && d < 2; d++) {
+            uint8_t motor   = d ? (rev[0] ^ all[0]) : rev[0];
+            uint8_t encoder = d ? (rev[1] ^ all[1]) : rev[1];
+            uint8_t servo   = d ? (rev[2] ^ all[2]) : rev[2];
+            uint8_t dir     = d ? (uint8_t)DIR::FORWARD : (uint8_t)DIR::REVERSE;
+            if (motor) {
+                sent = sent && PipelineCall<COMM_CMD::SET_DC_MOTOR_DIR>(
+                    handles, count, result, motor, dir);
+            }
+            if (encoder) {
+                sent = sent && PipelineCall<COMM_CMD::SET_ENCODER_DIR>(
+                    handles, count, result, encoder, dir);
+            }
+            if (servo) {
+                sent = sent && PipelineCall<COMM_CMD::SET_SERVO_DIR>(
+                    handles, count, result, servo, dir);
+            }
+        }
     }
-
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
+    if (sections & MMLowerProfile::SPEED_RANGE) {
+        for (uint8_t i = 0; sent && i < MR4_PROFILE_MOTOR_NUM; i++) {
+            if (profile.speedMax[i] == 0) continue;
+            sent = PipelineCall<COMM_CMD::SET_DC_MOTOR_SPEED_RANGE>(
+                handles, count, result, (uint8_t)(1 << i), profile.speedMin[i],
+                profile.speedMax[i]);
+        }
     }
-
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
+    if (sections & MMLowerProfile::PPR) {
+        for (uint8_t i = 0; sent && i < MR4_PROFILE_MOTOR_NUM; i++) {
+            if (profile.ppr[i] == 0) continue;
+            sent = PipelineCall<COMM_CMD::SET_ENCODER_PPR_MAXSPEED>(
+                handles, count, result, i, (uint8_t)0, profile.ppr[i], profile.maxRPM[i]);
+        }
     }
-
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
-}
-
-MMLower::RESULT MMLower::SetServoPulseRange(uint8_t num, uint16_t min, uint16_t max)
-{
-    MR4_DEBUG_PRINT_HEADER(F("[SetServoPulseRange]"));
-
-    uint8_t data[5];
-    data[0] = (1 << --num);
-    BitConverter::GetBytes(data + 1, min);
-    BitConverter::GetBytes(data + 3, max);
-    CommSendData(COMM_CMD::SET_SERVO_PULSE_RANGE, data, 5);
-    if (!WaitData(COMM_CMD::SET_SERVO_PULSE_RANGE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
+    if (sections & MMLowerProfile::PID) {
+        for (uint8_t pidNum = 0; pidNum < 2; pidNum++) {
+            for (uint8_t i = 0; sent && i < MR4_PROFILE_MOTOR_NUM; i++) {
+                const MMLowerProfile::Pid_t& pid =
+                    pidNum ? profile.rotatePid[i] : profile.speedPid[i];
+                if (pid.kp == 0 && pid.ki == 0 && pid.kd == 0) continue;
+                sent = PipelineCall<COMM_CMD::SET_PID_PARAM>(
+                    handles, count, result, (uint8_t)(1 << i), pidNum, (uint16_t)(pid.kp * 100.0f),
+                    (uint16_t)(pid.ki * 100.0f), (uint16_t)(pid.kd * 100.0f));
+            }
+        }
     }
-
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
+    if (sections & MMLowerProfile::DRIVE_PID) {
+        const MMLowerProfile::Pid_t& sync = profile.moveSyncPid;
+        const MMLowerProfile::Pid_t& gyro = profile.moveGyroPid;
+        const MMLowerProfile::Pid_t& turn = profile.turnGyroPid;
+        if (sync.kp != 0 || sync.ki != 0 || sync.kd != 0) {
+            sent = sent && PipelineCall<COMM_CMD::SET_DC_TWO_MoveSync_PID>(
+                handles, count, result, sync.kp, sync.ki, sync.kd, (uint8_t)0);
+        }
+        if (gyro.kp != 0 || gyro.ki != 0 || gyro.kd != 0) {
+            sent = sent && PipelineCall<COMM_CMD::SET_DC_TWO_MoveGyro_PID>(
+                handles, count, result, gyro.kp, gyro.ki, gyro.kd, (uint8_t)0);
+        }
+        if (turn.kp != 0 || turn.ki != 0 || turn.kd != 0) {
+            sent = sent && PipelineCall<COMM_CMD::SET_DC_TWO_TurnGyro_PID>(
+                handles, count, result, turn.kp, turn.ki, turn.kd, (uint8_t)0);
+        }
     }
-
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
+    if (sections & MMLowerProfile::SERVO_RANGE) {
+        for (uint8_t i = 0; sent && i < MR4_PROFILE_SERVO_NUM; i++) {
+            if (profile.servoAngleMax[i] == 0) continue;
+            sent = PipelineCall<COMM_CMD::SET_SERVO_ANGLE_RANGE>(
+                handles, count, result, (uint8_t)(1 << i), profile.servoAngleMin[i],
+                profile.servoAngleMax[i]);
+        }
     }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_SERVO_MIN_PULSE"));
-        return RESULT::ERROR_SERVO_MIN_PULSE;
+    if (sections & MMLowerProfile::SERVO_PULSE) {
+        for (uint8_t i = 0; sent && i < MR4_PROFILE_SERVO_NUM; i++) {
+            if (profile.servoPulseMax[i] == 0) continue;
+            sent = PipelineCall<COMM_CMD::SET_SERVO_PULSE_RANGE>(
+                handles, count, result, (uint8_t)(1 << i), profile.servoPulseMin[i],
+                profile.servoPulseMax[i]);
+        }
     }
-    if (b[0] == 0x03) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_SERVO_MAX_PULSE"));
-        return RESULT::ERROR_SERVO_MAX_PULSE;
+    if (sections & MMLowerProfile::IMU_CALIB) {
+        const float* c = profile.imuCalib;
+        sent = sent && PipelineCall<COMM_CMD::SET_IMU_Calib_Data>(
+            handles, count, result, (uint8_t)1, (uint8_t)1, c[0], c[1], c[2], c[3], c[4], c[5]);
     }
-
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    PipelineAwait(handles, count, result);
+    return sent ? result : RESULT::ERROR;
 }
 
-MMLower::RESULT MMLower::SetServoAngleRange(uint8_t num, uint16_t min, uint16_t max)
+// A mode switch old firmware does not answer is skipped, not failed.
+static inline void KeepSetupError(MMLower::RESULT& result, MMLower::RESULT r)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetServoAngleRange]"));
+    if (result == MMLower::RESULT::OK && r != MMLower::RESULT::ERROR_WAIT_TIMEOUT) result = r;
+}
 
-    uint8_t data[5];
-    data[0] = (1 << --num);
-    BitConverter::GetBytes(data + 1, min);
-    BitConverter::GetBytes(data + 3, max);
-    CommSendData(COMM_CMD::SET_SERVO_ANGLE_RANGE, data, 5);
-    if (!WaitData(COMM_CMD::SET_SERVO_ANGLE_RANGE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+/**
+ * @brief Mode switches after the first EchoTest, shared by Init() and InitFast().
+ *
+ * @return OK, or the first switch the lower board answered but that failed.
+ */
+MMLower::RESULT MMLower::LinkSetup(void)
+{
+    RESULT result = RESULT::OK;
+
+    snapshotProbe = PROBE::UNKNOWN;
+    sampleProbe   = PROBE::UNKNOWN;
+    batchProbe    = PROBE::UNKNOWN;
+#if MR4_COMM_FAST_BAUDRATE
+    KeepSetupError(result, SetCommBaudrate(MR4_COMM_FAST_BAUDRATE));
+#endif
+#if MR4_COMM_FRAMING_ENABLE
+    // Old firmware does not answer, the link then stays unframed.
+    KeepSetupError(result, SetCommFraming(true));
+#endif
+#if MR4_COMM_TIMESTAMP_ENABLE
+    if (framed) {
+        RESULT r = SetCommTimestamp(true);
+        if (r == RESULT::OK) r = SyncClock();
+        KeepSetupError(result, r);
+    }
+#endif
+#if MR4_TASK_PUSH_ENABLE
+    if (framed) KeepSetupError(result, Subscribe(TELEMETRY::TASK, 1));
+#endif
+    return result;
+}
+
+// EchoTest with its own reply timeout.
+MMLower::RESULT MMLower::EchoProbe(uint32_t timeoutUs)
+{
+    constexpr const MMLowerCmdDesc_t& desc = FindCmd(COMM_CMD::ECHO_TEST);
+
+    uint8_t* p = TxBegin(desc.cmd, desc.requestSize);
+    if (p == NULL) return RESULT::ERROR;
+    WireLayout<uint8_t>::PackTo(p, 0x55);
+    TxEnd();
 
     uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+    RESULT  result = (RESULT)Transact(desc, b, timeoutUs);
+    if (result != RESULT::OK) return result;
+    return (b[0] == 0x55) ? RESULT::OK : RESULT::ERROR;
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_SERVO_MIN_ANGLE"));
-        return RESULT::ERROR_SERVO_MIN_ANGLE;
-    }
-    if (b[0] == 0x03) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_SERVO_MAX_ANGLE"));
-        return RESULT::ERROR_SERVO_MAX_ANGLE;
-    }
+MMLower::RESULT MMLower::SetDCMotorDir(uint8_t num, DIR dir)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetDCMotorDir]"));
+    return Call<COMM_CMD::SET_DC_MOTOR_DIR>((uint8_t)(1 << --num), (uint8_t)dir);
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+MMLower::RESULT MMLower::SetEncoderDir(uint8_t num, DIR dir)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetEncoderDir]"));
+    return Call<COMM_CMD::SET_ENCODER_DIR>((uint8_t)(1 << --num), (uint8_t)dir);
 }
 
-MMLower::RESULT MMLower::SetIMUEchoMode(IMU_ECHO_MODE mode, uint16_t echoIntervalMs)
+MMLower::RESULT MMLower::SetServoDir(uint8_t num, DIR dir)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetIMUEchoMode]"));
+    MR4_DEBUG_PRINT_HEADER(F("[SetServoDir]"));
+    return Call<COMM_CMD::SET_SERVO_DIR>((uint8_t)(1 << --num), (uint8_t)dir);
+}
 
-    uint8_t data[3];
-    data[0] = (uint8_t)mode;
-    BitConverter::GetBytes(data + 1, echoIntervalMs);
-    CommSendData(COMM_CMD::SET_IMU_ECHO_MODE, data, 3);
-    if (!WaitData(COMM_CMD::SET_IMU_ECHO_MODE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::RESULT MMLower::SetDCMotorSpeedRange(uint8_t num, uint16_t min, uint16_t max)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetDCMotorSpeedRange]"));
+    return Call<COMM_CMD::SET_DC_MOTOR_SPEED_RANGE>((uint8_t)(1 << --num), min, max);
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+MMLower::RESULT MMLower::SetServoPulseRange(uint8_t num, uint16_t min, uint16_t max)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetServoPulseRange]"));
+    return Call<COMM_CMD::SET_SERVO_PULSE_RANGE>((uint8_t)(1 << --num), min, max);
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MODE"));
-        return RESULT::ERROR_MODE;
-    }
-    if (b[0] == 0x03) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_INTERVAL"));
-        return RESULT::ERROR_INTERVAL;
-    }
+MMLower::RESULT MMLower::SetServoAngleRange(uint8_t num, uint16_t min, uint16_t max)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetServoAngleRange]"));
+    return Call<COMM_CMD::SET_SERVO_ANGLE_RANGE>((uint8_t)(1 << --num), min, max);
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+MMLower::RESULT MMLower::SetIMUEchoMode(IMU_ECHO_MODE mode, uint16_t echoIntervalMs)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetIMUEchoMode]"));
+    return Call<COMM_CMD::SET_IMU_ECHO_MODE>((uint8_t)mode, echoIntervalMs);
 }
 
 MMLower::RESULT MMLower::SetIMUInit(
     IMU_ACC_FSR accFSR, IMU_GYRO_FSR gyroFSR, IMU_ODR odr, IMU_FIFO fifo)
 {
     MR4_DEBUG_PRINT_HEADER(F("[SetIMUInit]"));
-
-    uint8_t data[4];
-    data[0] = (uint8_t)accFSR;
-    data[1] = (uint8_t)gyroFSR;
-    data[2] = (uint8_t)odr;
-    data[3] = (uint8_t)fifo;
-    CommSendData(COMM_CMD::SET_IMU_INIT, data, 4);
-    if (!WaitData(COMM_CMD::SET_IMU_INIT, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
-
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_IMU_ACC_FSR"));
-        return RESULT::ERROR_IMU_ACC_FSR;
-    }
-    if (b[0] == 0x03) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_IMU_GYRO_FSR"));
-        return RESULT::ERROR_IMU_GYRO_FSR;
-    }
-    if (b[0] == 0x04) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_IMU_ODR"));
-        return RESULT::ERROR_IMU_ODR;
-    }
-
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    return Call<COMM_CMD::SET_IMU_INIT>(
+        (uint8_t)accFSR, (uint8_t)gyroFSR, (uint8_t)odr, (uint8_t)fifo);
 }
 
 MMLower::RESULT MMLower::SetPowerParam(float fullVolt, float cutOffVolt, float alarmVolt)
 {
     MR4_DEBUG_PRINT_HEADER(F("[SetPowerParam]"));
-
-    uint8_t data[3];
-    data[0] = (uint8_t)(fullVolt * 10.0f);
-    data[1] = (uint8_t)(cutOffVolt * 10.0f);
-    data[2] = (uint8_t)(alarmVolt * 10.0f);
-    CommSendData(COMM_CMD::SET_POWER_PARAM, data, 3);
-    if (!WaitData(COMM_CMD::SET_POWER_PARAM, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
-
-    uint8_t b[1];
-    if (!CommReadData(b, 1, 5)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_POWER_VOLT_RANGE"));
-        return RESULT::ERROR_POWER_VOLT_RANGE;
-    }
-
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    return Call<COMM_CMD::SET_POWER_PARAM>(
+        (uint8_t)(fullVolt * 10.0f), (uint8_t)(cutOffVolt * 10.0f), (uint8_t)(alarmVolt * 10.0f));
 }
 // Setting-Commonly used
 
 MMLower::RESULT MMLower::SetDCMotorPower(uint8_t num, int16_t power)
 {
     MR4_DEBUG_PRINT_HEADER(F("[SetDCMotorPower]"));
+    return Call<COMM_CMD::SET_DC_MOTOR_POWER>((uint8_t)(1 << --num), (uint8_t)0, power);
+}
 
-    uint8_t data[4];
-    data[0] = (1 << --num);
-    data[1] = 0;   // Ma
-    BitConverter::GetBytes(data + 2, power);
-    CommSendData(COMM_CMD::SET_DC_MOTOR_POWER, data, 4);
-    if (!WaitData(COMM_CMD::SET_DC_MOTOR_POWER, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
-
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+MMLower::RESULT MMLower::SetDCMotorSpeed(uint8_t num, int16_t speed)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetDCMotorSpeed]"));
+    return Call<COMM_CMD::SET_DC_MOTOR_SPEED>((uint8_t)(1 << --num), (uint8_t)0, speed);
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_POWER"));
-        return RESULT::ERROR_MOTOR_POWER;
-    }
+MMLower::RESULT MMLower::SetDCMotorRotate(uint8_t num, int16_t maxSpeed, uint16_t degree)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetDCMotorRotate]"));
+    RESULT result = Call<COMM_CMD::SET_DC_MOTOR_ROTATE>((uint8_t)(1 << (num - 1)), maxSpeed, degree);
+    TaskStarted(TASK::ROTATE, num, (uint8_t)result);
+    return result;
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+// Direction bits of the SET_ALL_DC_MOTOR_* requests.
+static uint8_t MotorsDirBits(const MMLower::Motors_Param_t& param)
+{
+    return (uint8_t)param.m1_dir | ((uint8_t)param.m2_dir << 1) | ((uint8_t)param.m3_dir << 2) |
+           ((uint8_t)param.m4_dir << 3);
 }
 
-MMLower::RESULT MMLower::SetDCMotorSpeed(uint8_t num, int16_t speed)
+MMLower::RESULT MMLower::SetAllDCMotorSpeed(Motors_Param_t param)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetDCMotorSpeed]"));
+    MR4_DEBUG_PRINT_HEADER(F("[SetAllDCMotorSpeed]"));
+    // The lower board expects a trailing reserved byte.
+    return Call<COMM_CMD::SET_ALL_DC_MOTOR_SPEED>(
+        MotorsDirBits(param), param.m1_speed, param.m2_speed, param.m3_speed, param.m4_speed,
+        (uint8_t)0);
+}
 
-    uint8_t data[4];
-    data[0] = (1 << --num);
-    data[1] = 0;   // Ma
-    BitConverter::GetBytes(data + 2, speed);
-    CommSendData(COMM_CMD::SET_DC_MOTOR_SPEED, data, 4);
-    if (!WaitData(COMM_CMD::SET_DC_MOTOR_SPEED, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::RESULT MMLower::SetAllDCMotorPower(Motors_Param_t param)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetAllDCMotorPower]"));
+    return Call<COMM_CMD::SET_ALL_DC_MOTOR_POWER>(
+        MotorsDirBits(param), param.m1_power, param.m2_power, param.m3_power, param.m4_power,
+        (uint8_t)0);
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+MMLower::RESULT MMLower::SetServoAngle(uint8_t num, uint16_t angle)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetServoAngle]"));
+    return Call<COMM_CMD::SET_SERVO_ANGLE>((uint8_t)(1 << --num), angle);
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_SPEED"));
-        return RESULT::ERROR_MOTOR_SPEED;
-    }
+MMLower::RESULT MMLower::SetAllServoAngle(
+    uint16_t angle1, uint16_t angle2, uint16_t angle3, uint16_t angle4)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetAllServoAngle]"));
+    return Call<COMM_CMD::SET_ALL_SERVO_ANGLE>(angle1, angle2, angle3, angle4);
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+MMLower::RESULT MMLower::SetMoveDistance(
+    MOVE_TYPE type, MOVE_ACTION action, uint16_t speed, uint16_t enCounter)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetMoveDistance]"));
+    return Call<COMM_CMD::SET_MOVE_DISTANCE>((uint8_t)type, (uint8_t)action, speed, enCounter);
 }
 
-MMLower::RESULT MMLower::SetDCMotorRotate(uint8_t num, int16_t maxSpeed, uint16_t degree)
+MMLower::RESULT MMLower::SetEncoderResetCounter(uint8_t num)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetDCMotorRotate]"));
+    MR4_DEBUG_PRINT_HEADER(F("[SetEncoderResetCounter]"));
 
-    uint8_t data[5];
-    data[0] = (1 << --num);
-    BitConverter::GetBytes(data + 1, maxSpeed);
-    BitConverter::GetBytes(data + 3, degree);
-    CommSendData(COMM_CMD::SET_DC_MOTOR_ROTATE, data, 5);
-    if (!WaitData(COMM_CMD::SET_DC_MOTOR_ROTATE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    RESULT result = Call<COMM_CMD::SET_ENCODER_RESET_COUNTER>((uint8_t)(1 << --num));
+    if (result == RESULT::OK) enCounter[num] = enCounter64[num] = 0;
+    return result;
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+MMLower::RESULT MMLower::SetIMU_Calib_data(float* bufdata)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetIMU_Calib_data]"));
+    return Call<COMM_CMD::SET_IMU_Calib_Data>(
+        (uint8_t)1, (uint8_t)1, bufdata[0], bufdata[1], bufdata[2], bufdata[3], bufdata[4],
+        bufdata[5]);
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+MMLower::RESULT MMLower::SetPIDParam(uint8_t num, uint8_t pidNum, float kp, float ki, float kd)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetPIDParam]"));
+    return Call<COMM_CMD::SET_PID_PARAM>(
+        (uint8_t)(1 << --num), pidNum, (uint16_t)(kp * 100.0f), (uint16_t)(ki * 100.0f),
+        (uint16_t)(kd * 100.0f));
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+MMLower::RESULT MMLower::SetDCBrake(uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetDCBrake]"));
+    return Call<COMM_CMD::SET_DC_BRAKE>((uint8_t)(1 << --num));
 }
 
-MMLower::RESULT MMLower::SetAllDCMotorSpeed(Motors_Param_t param)
+MMLower::RESULT MMLower::SetALLDCBrake(void)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetAllDCMotorSpeed]"));
+    MR4_DEBUG_PRINT_HEADER(F("[SetALLDCBrake]"));
+    return Call<COMM_CMD::SET_ALL_DC_BRAKE>((uint8_t)1);
+}
 
-    uint8_t data[12];
-    data[0] = (uint8_t)param.m1_dir;
-    data[0] |= ((uint8_t)param.m2_dir) << 1;
-    data[0] |= ((uint8_t)param.m3_dir) << 2;
-    data[0] |= ((uint8_t)param.m4_dir) << 3;
-    BitConverter::GetBytes(data + 1, param.m1_speed);
-    BitConverter::GetBytes(data + 3, param.m2_speed);
-    BitConverter::GetBytes(data + 5, param.m3_speed);
-    BitConverter::GetBytes(data + 7, param.m4_speed);
-	
-    CommSendData(COMM_CMD::SET_ALL_DC_MOTOR_SPEED, data, 10);
-    if (!WaitData(COMM_CMD::SET_ALL_DC_MOTOR_SPEED, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::RESULT MMLower::SetALLDC_Type_Brake(uint8_t* type)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetALLDC_TypeBrake]"));
+    return Call<COMM_CMD::SET_DC_ALL_BRAKE_TYPE>((uint8_t)1, type[0], type[1], type[2], type[3]);
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+MMLower::RESULT MMLower::SetDC_Type_Brake(uint8_t num, uint8_t type)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetDC_TypeBrake]"));
+    return Call<COMM_CMD::SET_DC_BRAKE_TYPE>((uint8_t)1, type);
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR1_SPEED"));
-        return RESULT::ERROR_MOTOR1_SPEED;
-    }
-    if (b[0] == 0x03) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR2_SPEED"));
-        return RESULT::ERROR_MOTOR2_SPEED;
-    }
-    if (b[0] == 0x04) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR3_SPEED"));
-        return RESULT::ERROR_MOTOR3_SPEED;
-    }
-    if (b[0] == 0x05) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR4_SPEED"));
-        return RESULT::ERROR_MOTOR4_SPEED;
-    }
+MMLower::RESULT MMLower::SetEncode_PPR_MaxRPM(uint8_t num, uint16_t ppr, uint16_t Maxspeed)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Encode_PPR]"));
+    return Call<COMM_CMD::SET_ENCODER_PPR_MAXSPEED>((uint8_t)(num - 1), (uint8_t)0, ppr, Maxspeed);
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+MMLower::RESULT MMLower::SetALL_Encode_PPR(uint16_t* ppr)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Set_ALL_Encode_PPR]"));
+    return Call<COMM_CMD::SET_ALL_ENCODER_PPR>(
+        (uint8_t)1, (uint8_t)0, ppr[0], ppr[1], ppr[2], ppr[3]);
 }
-MMLower::RESULT MMLower::SetAllDCMotorPower(Motors_Param_t param)
+
+MMLower::RESULT MMLower::SetStateLED(uint8_t brightness, uint32_t colorRGB)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetAllDCMotorPower]"));
+    MR4_DEBUG_PRINT_HEADER(F("[SetStateLED]"));
+    return Call<COMM_CMD::SET_STATE_LED>(
+        brightness, (uint8_t)(colorRGB >> 16), (uint8_t)(colorRGB >> 8), (uint8_t)(colorRGB));
+}
 
-    uint8_t data[12];
-    data[0] = (uint8_t)param.m1_dir;
-    data[0] |= ((uint8_t)param.m2_dir) << 1;
-    data[0] |= ((uint8_t)param.m3_dir) << 2;
-    data[0] |= ((uint8_t)param.m4_dir) << 3;
-    BitConverter::GetBytes(data + 1, param.m1_power);
-    BitConverter::GetBytes(data + 3, param.m2_power);
-    BitConverter::GetBytes(data + 5, param.m3_power);
-    BitConverter::GetBytes(data + 7, param.m4_power);
-	
-    CommSendData(COMM_CMD::SET_ALL_DC_MOTOR_POWER, data, 10);
-    if (!WaitData(COMM_CMD::SET_ALL_DC_MOTOR_POWER, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::RESULT MMLower::SetIMUToZero(void)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetIMUToZero]"));
+    return Call<COMM_CMD::SET_IMU_TO_ZERO>();
+}
+// Getting
+MMLower::RESULT MMLower::GetButtonState(uint8_t num, bool& btnState)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[GetButtonState]"));
 
     uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR1_SPEED"));
-        return RESULT::ERROR_MOTOR1_SPEED;
-    }
-    if (b[0] == 0x03) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR2_SPEED"));
-        return RESULT::ERROR_MOTOR2_SPEED;
-    }
-    if (b[0] == 0x04) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR3_SPEED"));
-        return RESULT::ERROR_MOTOR3_SPEED;
-    }
-    if (b[0] == 0x05) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR4_SPEED"));
-        return RESULT::ERROR_MOTOR4_SPEED;
-    }
+    RESULT  result = Query<COMM_CMD::GET_BUTTON_STATE>(b, (uint8_t)(num - 1));
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    btnState = (bool)b[0];
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetServoAngle(uint8_t num, uint16_t angle)
+MMLower::RESULT MMLower::GetButtonsState(bool* btnsState)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetServoAngle]"));
+    MR4_DEBUG_PRINT_HEADER(F("[GetButtonsState]"));
 
-    uint8_t data[3];
-    data[0] = (1 << --num);
-    BitConverter::GetBytes(data + 1, angle);
-    CommSendData(COMM_CMD::SET_SERVO_ANGLE, data, 3);
-    if (!WaitData(COMM_CMD::SET_SERVO_ANGLE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    uint8_t b[2];
+    RESULT  result = Query<COMM_CMD::GET_BUTTONS_STATE>(b);
+    if (result != RESULT::OK) return result;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+    uint16_t flag;
+    WireUnpack(b, flag);
+    btnsState[0]  = (bool)(flag);
+    btnsState[1]  = (bool)(flag >> 1);
+    return RESULT::OK;
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_SERVO_ANGLE"));
-        return RESULT::ERROR_SERVO_ANGLE;
+// Pause between the two reads of QuerySample() without sample numbers, per SENSOR
+static constexpr uint8_t sampleSettleMs[] = {1, 2};
+// Largest reply of a getter GET_SAMPLE wraps, it bounds the GET_SAMPLE frames
+static constexpr uint8_t sampleReplyMax = 17;
+
+/**
+ * @brief Read a getter whose sample is not the one numbered newerThan.
+ *
+ * The lower board numbers the samples of each sensor and holds the request
+ * until it has one after newerThan, at most one sample period. Pass
+ * GetSampleSeq() to get a sample that was not read before.
+ *
+ * Firmware without sample numbers, and legacy links, get the getter twice,
+ * the second read after the sensor settled, as the first reply may carry
+ * the sample from before the request.
+ */
+template<MMLower::COMM_CMD CMD, size_t N>
+MMLower::RESULT MMLower::QuerySample(SENSOR sensor, uint16_t newerThan, uint8_t (&reply)[N])
+{
+    constexpr const MMLowerCmdDesc_t& inner = FindCmd(CMD);
+    static_assert(inner.requestSize == 0 && !inner.hasStatus, "not a sampled getter");
+    static_assert(N >= inner.replySize, "reply buffer is smaller than cmdTable");
+    static_assert(inner.replySize <= sampleReplyMax, "raise sampleReplyMax");
+
+    if (framed && sampleProbe != PROBE::UNSUPPORTED) {
+        constexpr const MMLowerCmdDesc_t& desc = FindCmd(COMM_CMD::GET_SAMPLE);
+        uint8_t*                          p    = TxBegin(desc.cmd, desc.requestSize);
+        if (p == NULL) return RESULT::ERROR;
+        WireLayout<uint8_t, uint16_t>::PackTo(p, (uint8_t)CMD, newerThan);
+        TxEnd();
+
+        // Firmware without sample numbers does not answer, keep the first try short.
+        bool     probing   = (sampleProbe == PROBE::UNKNOWN);
+        uint32_t timeoutUs = (probing ? MatrixR4_PROBE_TIMEOUT_US : RtoUs(desc)) +
+                             MatrixR4_SAMPLE_HOLD_MAX_US;
+        uint8_t  b[2];
+        RESULT   result = (RESULT)Transact(desc, b, timeoutUs);
+        if (!probing || result != RESULT::ERROR_WAIT_TIMEOUT) {
+            if (result != RESULT::OK) return result;
+            sampleProbe = PROBE::SUPPORTED;
+            if (!CommReadData(reply, inner.replySize)) return RESULT::ERROR_READ_TIMEOUT;
+            WireUnpack(b, sampleSeq[(uint8_t)sensor]);
+            return RESULT::OK;
+        }
+        sampleProbe = PROBE::UNSUPPORTED;
     }
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    RESULT result = Query<CMD>(reply);
+    if (result != RESULT::OK) return result;
+    delay(sampleSettleMs[(uint8_t)sensor]);
+    result = Query<CMD>(reply);
+    if (result == RESULT::OK) sampleSeq[(uint8_t)sensor]++;
+    return result;
 }
 
-MMLower::RESULT MMLower::SetAllServoAngle(
-    uint16_t angle1, uint16_t angle2, uint16_t angle3, uint16_t angle4)
+MMLower::RESULT MMLower::GetALLEncoderSpeed(int32_t* enSpeed)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetAllServoAngle]"));
-
-    uint8_t data[8];
-    BitConverter::GetBytes(data + 0, angle1);
-    BitConverter::GetBytes(data + 2, angle2);
-    BitConverter::GetBytes(data + 4, angle3);
-    BitConverter::GetBytes(data + 6, angle4);
-    CommSendData(COMM_CMD::SET_ALL_SERVO_ANGLE, data, 8);
-    if (!WaitData(COMM_CMD::SET_ALL_SERVO_ANGLE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    MR4_DEBUG_PRINT_HEADER(F("[Get_ALL_Encoder_SPEED]"));
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+    // status, speeds
+    typedef WireLayout<uint8_t, int32_t[MatrixR4_DC_MOTOR_NUM]> Reply_t;
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_SERVO1_ANGLE"));
-        return RESULT::ERROR_SERVO1_ANGLE;
-    }
-    if (b[0] == 0x03) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_SERVO2_ANGLE"));
-        return RESULT::ERROR_SERVO2_ANGLE;
-    }
-    if (b[0] == 0x04) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_SERVO3_ANGLE"));
-        return RESULT::ERROR_SERVO3_ANGLE;
-    }
-    if (b[0] == 0x05) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_SERVO4_ANGLE"));
-        return RESULT::ERROR_SERVO4_ANGLE;
-    }
+    uint8_t b[Reply_t::Size];
+    RESULT  result = Query<COMM_CMD::GET_SPEED_ALL_DC_MOTOR>(b);
+    if (result != RESULT::OK) return result;
 
-    return RESULT::ERROR;
+    Reply_t::Read<1>(b, enSpeed);
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetMoveDistance(
-    MOVE_TYPE type, MOVE_ACTION action, uint16_t speed, uint16_t enCounter)
+/**
+ * @brief Encoder speeds of a sample after the one numbered newerThan, see
+ * GetSampleSeq(SENSOR::SPEED).
+ */
+MMLower::RESULT MMLower::GetALLEncoderSpeed(int32_t* enSpeed, uint16_t newerThan)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetMoveDistance]"));
-
-    uint8_t data[6];
-    data[0] = (uint8_t)type;
-    data[1] = (uint8_t)action;
-    BitConverter::GetBytes(data + 2, speed);
-    BitConverter::GetBytes(data + 4, enCounter);
-    CommSendData(COMM_CMD::SET_MOVE_DISTANCE, data, 6);
-    if (!WaitData(COMM_CMD::SET_MOVE_DISTANCE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    MR4_DEBUG_PRINT_HEADER(F("[Get_ALL_Encoder_SPEED]"));
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+    typedef WireLayout<uint8_t, int32_t[MatrixR4_DC_MOTOR_NUM]> Reply_t;
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOVE_ACTION"));
-        return RESULT::ERROR_MOVE_ACTION;
-    }
-    if (b[0] == 0x03) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOVE_SPEED"));
-        return RESULT::ERROR_MOVE_SPEED;
-    }
-    if (b[0] == 0x04) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOVE_ENCODER"));
-        return RESULT::ERROR_MOVE_ENCODER;
-    }
+    uint8_t b[Reply_t::Size];
+    RESULT  result = QuerySample<COMM_CMD::GET_SPEED_ALL_DC_MOTOR>(SENSOR::SPEED, newerThan, b);
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    Reply_t::Read<1>(b, enSpeed);
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetEncoderResetCounter(uint8_t num)
+MMLower::RESULT MMLower::Get_IMU_nancalib_acc(float* accdata)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetEncoderResetCounter]"));
+    MR4_DEBUG_PRINT_HEADER(F("[Get_IMU_nancalib_acc]"));
 
-    uint8_t data[1] = {(1 << --num)};
-    CommSendData(COMM_CMD::SET_ENCODER_RESET_COUNTER, data, 1);
-    if (!WaitData(COMM_CMD::SET_ENCODER_RESET_COUNTER, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    // status, x y z
+    typedef WireLayout<uint8_t, float[3]> Reply_t;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+    uint8_t b[Reply_t::Size];
+    RESULT  result = Query<COMM_CMD::GET_IMU_ACC_NOcal>(b);
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    Reply_t::Read<1>(b, accdata);
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetIMU_Calib_data(float * bufdata)
+/**
+ * @brief Uncalibrated acceleration of a sample after the one numbered
+ * newerThan, see GetSampleSeq(SENSOR::IMU).
+ */
+MMLower::RESULT MMLower::Get_IMU_nancalib_acc(float* accdata, uint16_t newerThan)
 {
-    uint8_t data[30];
-	data[0] = 1;
-	data[1] = 1;
-    BitConverter::FloatGetBytes(data+2, bufdata[0]);
-    BitConverter::FloatGetBytes(data+6, bufdata[1]);	
-	BitConverter::FloatGetBytes(data+10, bufdata[2]);	
-	BitConverter::FloatGetBytes(data+14, bufdata[3]);	
-	BitConverter::FloatGetBytes(data+18, bufdata[4]);	
-	BitConverter::FloatGetBytes(data+22, bufdata[5]);
+    MR4_DEBUG_PRINT_HEADER(F("[Get_IMU_nancalib_acc]"));
 
-    CommSendData(COMM_CMD::SET_IMU_Calib_Data, data, 26);
-    if (!WaitData(COMM_CMD::SET_IMU_Calib_Data, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    typedef WireLayout<uint8_t, float[3]> Reply_t;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+    uint8_t b[Reply_t::Size];
+    RESULT  result = QuerySample<COMM_CMD::GET_IMU_ACC_NOcal>(SENSOR::IMU, newerThan, b);
+    if (result != RESULT::OK) return result;
 
-    return RESULT::ERROR;
+    Reply_t::Read<1>(b, accdata);
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetPIDParam(uint8_t num, uint8_t pidNum, float kp, float ki, float kd)
+MMLower::RESULT MMLower::GetEncoderDegrees(uint8_t num, int32_t& enDeges)
 {
-    uint8_t data[8] = {(1 << --num), pidNum};
-    BitConverter::GetBytes(data + 2, (uint16_t)(kp * 100.0f));
-    BitConverter::GetBytes(data + 4, (uint16_t)(ki * 100.0f));
-    BitConverter::GetBytes(data + 6, (uint16_t)(kd * 100.0f));
+    MR4_DEBUG_PRINT_HEADER(F("[GetEncoderDegrees]"));
 
-    CommSendData(COMM_CMD::SET_PID_PARAM, data, 8);
-    if (!WaitData(COMM_CMD::SET_PID_PARAM, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    uint8_t b[4];
+    RESULT  result = Query<COMM_CMD::GET_ENCODER_DEGREES>(b, (uint8_t)(num - 1));
+    if (result != RESULT::OK) return result;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+    WireUnpack(b, enDeges);
+    return RESULT::OK;
+}
 
-    return RESULT::ERROR;
+MMLower::RESULT MMLower::GetEncoderCounter(uint8_t num, int32_t& enCounter)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[GetEncoderCounter]"));
+
+    uint8_t b[4];
+    RESULT  result = Query<COMM_CMD::GET_ENCODER_COUNTER>(b, --num);
+    if (result != RESULT::OK) return result;
+
+    WireUnpack(b, enCounter);
+    EncoderReconcile(num, enCounter);
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetDCBrake(uint8_t num)
+MMLower::RESULT MMLower::GetAllEncoderCounter(int32_t* enCounter)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetDCBrake]"));
+    MR4_DEBUG_PRINT_HEADER(F("[GetAllEncoderCounter]"));
 
-    uint8_t data[1] = {(1 << --num)};
-    CommSendData(COMM_CMD::SET_DC_BRAKE, data, 1);
-    if (!WaitData(COMM_CMD::SET_DC_BRAKE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    typedef WireLayout<int32_t[MatrixR4_ENCODER_NUM]> Reply_t;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
+    uint8_t b[Reply_t::Size];
+    RESULT  result = Query<COMM_CMD::GET_ALL_ENCODER_COUNTER>(b);
+    if (result != RESULT::OK) return result;
+
+    Reply_t::Read<0>(b, enCounter);
+    for (uint8_t i = 0; i < MatrixR4_ENCODER_NUM; i++) {
+        EncoderReconcile(i, enCounter[i]);
     }
+    enCounterUs = RxSampleUs();
+    return RESULT::OK;
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+// IMU frames carry int16 triples: angles and rates in 0.01 deg (/s),
+// acceleration in 0.001 g. Scaled in float, the M4F has no double unit.
+static constexpr float IMU_DEG_PER_LSB = 0.01f;
+static constexpr float IMU_G_PER_LSB   = 0.001f;
+
+static inline void DecodeIMUFrom(const uint8_t* p, float scale, float& x, float& y, float& z)
+{
+    int16_t v[3];
+    WireLayout<int16_t[3]>::UnpackFrom(p, v);
+    x = v[0] * scale;
+    y = v[1] * scale;
+    z = v[2] * scale;
 }
 
-MMLower::RESULT MMLower::SetALLDCBrake(void)
+static inline void DecodeIMU(const uint8_t (&b)[6], float scale, float& x, float& y, float& z)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetALLDCBrake]"));
+    static_assert(WireLayout<int16_t[3]>::Size == sizeof(b), "IMU frame size");
+    DecodeIMUFrom(b, scale, x, y, z);
+}
 
-    uint8_t data[2];
-	data[0] = 1;
-    CommSendData(COMM_CMD::SET_ALL_DC_BRAKE, data, 1);
-    if (!WaitData(COMM_CMD::SET_ALL_DC_BRAKE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+// Copy a float IMU shadow into its public double members.
+static inline void PublishIMU(const float (&f)[3], double& x, double& y, double& z)
+{
+    x = f[0];
+    y = f[1];
+    z = f[2];
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+MMLower::RESULT MMLower::GetIMUEuler(float& roll, float& pitch, float& yaw)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[GetIMUEuler]"));
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    uint8_t b[6];
+    RESULT  result = Query<COMM_CMD::GET_IMU_EULER>(b);
+    if (result != RESULT::OK) return result;
+
+    DecodeIMU(b, IMU_DEG_PER_LSB, roll, pitch, yaw);
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetALLDC_Type_Brake(uint8_t * type)
+MMLower::RESULT MMLower::GetIMUGyro(float& x, float& y, float& z)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetALLDC_TypeBrake]"));
-
-    uint8_t data[8];
-	data[0] = 1;
-	data[1] = type[0];
-	data[2] = type[1];
-	data[3] = type[2];
-	data[4] = type[3];
-    CommSendData(COMM_CMD::SET_DC_ALL_BRAKE_TYPE, data, 5);
-    if (!WaitData(COMM_CMD::SET_DC_ALL_BRAKE_TYPE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    MR4_DEBUG_PRINT_HEADER(F("[GetIMUGyro]"));
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+    uint8_t b[6];
+    RESULT  result = Query<COMM_CMD::GET_IMU_GYRO>(b);
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    DecodeIMU(b, IMU_DEG_PER_LSB, x, y, z);
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetDC_Type_Brake(uint8_t num, uint8_t type)
+MMLower::RESULT MMLower::GetIMUAcc(float& x, float& y, float& z)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetDC_TypeBrake]"));
+    MR4_DEBUG_PRINT_HEADER(F("[GetIMUAcc]"));
 
-    uint8_t data[3];
-	data[0] = 1;
-	data[1] = type;
-    CommSendData(COMM_CMD::SET_DC_BRAKE_TYPE, data, 2);
-    if (!WaitData(COMM_CMD::SET_DC_BRAKE_TYPE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    uint8_t b[6];
+    RESULT  result = Query<COMM_CMD::GET_IMU_ACC>(b);
+    if (result != RESULT::OK) return result;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+    DecodeIMU(b, IMU_G_PER_LSB, x, y, z);
+    return RESULT::OK;
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+// double versions, kept for existing sketches
+MMLower::RESULT MMLower::GetIMUEuler(double& roll, double& pitch, double& yaw)
+{
+    float  r, p, y;
+    RESULT result = GetIMUEuler(r, p, y);
+    if (result == RESULT::OK) roll = r, pitch = p, yaw = y;
+    return result;
 }
 
-MMLower::RESULT MMLower::SetEncode_PPR_MaxRPM(uint8_t num, uint16_t ppr, uint16_t Maxspeed)
+MMLower::RESULT MMLower::GetIMUGyro(double& x, double& y, double& z)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[Set_Encode_PPR]"));
+    float  fx, fy, fz;
+    RESULT result = GetIMUGyro(fx, fy, fz);
+    if (result == RESULT::OK) x = fx, y = fy, z = fz;
+    return result;
+}
 
-    uint8_t data[6];
-	data[0] = num - 1;
-	data[1] = 0;
-	BitConverter::GetBytes(data + 2, (uint16_t)(ppr));
-	BitConverter::GetBytes(data + 4, (uint16_t)(Maxspeed));
-	
-    CommSendData(COMM_CMD::SET_ENCODER_PPR_MAXSPEED, data, 6);
-    if (!WaitData(COMM_CMD::SET_ENCODER_PPR_MAXSPEED, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::RESULT MMLower::GetIMUAcc(double& x, double& y, double& z)
+{
+    float  fx, fy, fz;
+    RESULT result = GetIMUAcc(fx, fy, fz);
+    if (result == RESULT::OK) x = fx, y = fy, z = fz;
+    return result;
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+MMLower::RESULT MMLower::GetPowerInfo(float& curVolt, float& curVoltPerc)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[GetPowerInfo]"));
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    uint8_t b[3];
+    RESULT  result = Query<COMM_CMD::GET_POWER_INFO>(b);
+    if (result != RESULT::OK) return result;
+
+    uint16_t milliVolt;
+    uint8_t  percent;
+    WireUnpack(b, milliVolt, percent);
+    curVolt     = milliVolt / 1000.0f;
+    curVoltPerc = (float)percent;
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetALL_Encode_PPR(uint16_t * ppr)
+MMLower::RESULT MMLower::GetRotateState(uint8_t num, bool& isEnd)
 {
-	MR4_DEBUG_PRINT_HEADER(F("[Set_ALL_Encode_PPR]"));
-	
-    uint8_t data[12];
-	data[0] = 1;
-	data[1] = 0;
-	BitConverter::GetBytes(data + 2, (uint16_t)(ppr[0]));	
-	BitConverter::GetBytes(data + 4, (uint16_t)(ppr[1]));	
-	BitConverter::GetBytes(data + 6, (uint16_t)(ppr[2]));	
-	BitConverter::GetBytes(data + 8, (uint16_t)(ppr[3]));	
-	
-    CommSendData(COMM_CMD::SET_ALL_ENCODER_PPR, data, 10);
-    if (!WaitData(COMM_CMD::SET_ALL_ENCODER_PPR, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    MR4_DEBUG_PRINT_HEADER(F("[GetRotateState]"));
 
     uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
+    RESULT  result = Query<COMM_CMD::GET_ROTATE_STATE>(b, (uint8_t)(num - 1));
+    if (result != RESULT::OK) return result;
+
+    isEnd = b[0];
+    return RESULT::OK;
+}
+
+// GET_SNAPSHOT fields in bit order of Snapshot_t::FIELD, laid out like the
+// replies of the single commands without their status bytes.
+typedef WireLayout<int32_t[MatrixR4_ENCODER_NUM]>  SnapEncoder_t;
+typedef WireLayout<int32_t[MatrixR4_DC_MOTOR_NUM]> SnapSpeed_t;
+typedef WireLayout<int16_t[3]>                     SnapIMU_t;
+typedef WireLayout<uint8_t>                        SnapButton_t;   // bit per button
+typedef WireLayout<uint16_t, uint8_t>              SnapPower_t;    // mV, percent
+
+static constexpr uint8_t SNAPSHOT_FIELD_NUM                = 7;
+static constexpr uint8_t snapFieldSize[SNAPSHOT_FIELD_NUM] = {
+    SnapEncoder_t::Size, SnapSpeed_t::Size,  SnapIMU_t::Size,   SnapIMU_t::Size,
+    SnapIMU_t::Size,     SnapButton_t::Size, SnapPower_t::Size,
+};
+static_assert(MMLower::Snapshot_t::ALL == (1 << SNAPSHOT_FIELD_NUM) - 1, "snapshot fields");
+static_assert(2 + SnapEncoder_t::Size + SnapSpeed_t::Size + 3 * SnapIMU_t::Size +
+                      SnapButton_t::Size + SnapPower_t::Size <=
+                  MatrixR4_FRAME_PAYLOAD_MAX,
+              "snapshot does not fit a frame");
+
+static void DecodeSnapshotField(uint8_t bit, const uint8_t* p, MMLower::Snapshot_t& snap)
+{
+    switch (1 << bit) {
+    case MMLower::Snapshot_t::ENCODER: SnapEncoder_t::UnpackFrom(p, snap.enCounter); break;
+    case MMLower::Snapshot_t::SPEED: SnapSpeed_t::UnpackFrom(p, snap.enSpeed); break;
+    case MMLower::Snapshot_t::EULER:
+        DecodeIMUFrom(p, IMU_DEG_PER_LSB, snap.roll, snap.pitch, snap.yaw);
+        break;
+    case MMLower::Snapshot_t::GYRO:
+        DecodeIMUFrom(p, IMU_DEG_PER_LSB, snap.gyroX, snap.gyroY, snap.gyroZ);
+        break;
+    case MMLower::Snapshot_t::ACC:
+        DecodeIMUFrom(p, IMU_G_PER_LSB, snap.accX, snap.accY, snap.accZ);
+        break;
+    case MMLower::Snapshot_t::BUTTON:
+        for (uint8_t i = 0; i < MatrixR4_BUTTON_NUM; i++) {
+            snap.btnState[i] = (bool)((p[0] >> i) & 0x01);
+        }
+        break;
+    case MMLower::Snapshot_t::POWER:
+    {
+        uint16_t milliVolt;
+        uint8_t  percent;
+        SnapPower_t::UnpackFrom(p, milliVolt, percent);
+        snap.voltage     = milliVolt / 1000.0f;
+        snap.voltagePerc = (float)percent;
+    } break;
     }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
+}
+
+/**
+ * @brief Read the robot state in one request: encoder counters and speeds,
+ * IMU angles, rates and acceleration, buttons and battery.
+ *
+ * Firmware without GET_SNAPSHOT, or a legacy link, gets the single getters
+ * instead, all queued before the first reply is awaited. Either way the
+ * telemetry shadows are updated with what was read.
+ *
+ * @param fields Snapshot_t::FIELD values OR'ed, snap.fields holds the ones read.
+ */
+MMLower::RESULT MMLower::GetSnapshot(Snapshot_t& snap, uint16_t fields)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[GetSnapshot]"));
+
+    fields &= Snapshot_t::ALL;
+    if (framed && snapshotProbe == PROBE::UNKNOWN) {
+        // Firmware without snapshots does not answer. Ask for no fields with
+        // a short timeout first, a full reply may take longer than that.
+        Snapshot_t probe;
+        RESULT     result = SnapshotQuery(probe, 0, MatrixR4_PROBE_TIMEOUT_US);
+        if (result == RESULT::OK) snapshotProbe = PROBE::SUPPORTED;
+        else if (result == RESULT::ERROR_WAIT_TIMEOUT) snapshotProbe = PROBE::UNSUPPORTED;
     }
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;	
+    RESULT result = (framed && snapshotProbe == PROBE::SUPPORTED)
+                        ? SnapshotQuery(snap, fields, 0)
+                        : SnapshotPipeline(snap, fields);
+    SnapshotShadow(snap);
+    MR4_DEBUG_PRINT_TAIL((int)result);
+    return result;
 }
 
-MMLower::RESULT MMLower::SetStateLED(uint8_t brightness, uint32_t colorRGB)
+MMLower::RESULT MMLower::SnapshotQuery(Snapshot_t& snap, uint16_t fields, uint32_t timeoutUs)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetStateLED]"));
+    snap.fields = 0;
 
-    uint8_t data[4];
-    data[0] = brightness;
-    data[1] = (uint8_t)(colorRGB >> 16);
-    data[2] = (uint8_t)(colorRGB >> 8);
-    data[3] = (uint8_t)(colorRGB);
-    CommSendData(COMM_CMD::SET_STATE_LED, data, 4);
-    if (!WaitData(COMM_CMD::SET_STATE_LED, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    constexpr const MMLowerCmdDesc_t& desc = FindCmd(COMM_CMD::GET_SNAPSHOT);
+    uint8_t*                          p    = TxBegin(desc.cmd, desc.requestSize);
+    if (p == NULL) return RESULT::ERROR;
+    WireLayout<uint16_t>::PackTo(p, fields);
+    TxEnd();
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1, 10)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
+    // The adaptive timeout does not know the reply grows with the fields,
+    // add the time they take on the wire.
+    if (timeoutUs == 0) {
+        uint16_t size = 0;
+        for (uint8_t bit = 0; bit < SNAPSHOT_FIELD_NUM; bit++) {
+            if (fields & (1 << bit)) size += snapFieldSize[bit];
+        }
+        timeoutUs = RtoUs(desc) + (uint32_t)size * 10 * 1000000UL / _baudrate;
     }
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    uint8_t b[2];
+    RESULT  result = (RESULT)Transact(desc, b, timeoutUs);
+    if (result != RESULT::OK) return result;
+
+    // The board may leave out fields it has no data for, never add unknown ones.
+    uint16_t present;
+    WireUnpack(b, present);
+    if (present & ~Snapshot_t::ALL) return RESULT::ERROR;
+
+    for (uint8_t bit = 0; bit < SNAPSHOT_FIELD_NUM; bit++) {
+        if ((present & (1 << bit)) == 0) continue;
+        uint8_t field[SnapEncoder_t::Size];   // the largest
+        if (!CommReadData(field, snapFieldSize[bit])) return RESULT::ERROR_READ_TIMEOUT;
+        DecodeSnapshotField(bit, field, snap);
+    }
+    snap.fields   = present;
+    snap.sampleUs = RxSampleUs();
+    return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::SetIMUToZero(void)
-{
-    MR4_DEBUG_PRINT_HEADER(F("[SetIMUToZero]"));
+// Fallback of GetSnapshot(): one round trip for all the single getters.
+MMLower::RESULT MMLower::SnapshotPipeline(Snapshot_t& snap, uint16_t fields)
+{
+    snap.fields = 0;
+
+    AsyncHandle handles[SNAPSHOT_FIELD_NUM];
+    handles[0] = (fields & Snapshot_t::ENCODER)
+                     ? CallAsync<COMM_CMD::GET_ALL_ENCODER_COUNTER>(NULL) : -1;
+    handles[1] = (fields & Snapshot_t::SPEED)
+                     ? CallAsync<COMM_CMD::GET_SPEED_ALL_DC_MOTOR>(NULL) : -1;
+    handles[2] = (fields & Snapshot_t::EULER) ? CallAsync<COMM_CMD::GET_IMU_EULER>(NULL) : -1;
+    handles[3] = (fields & Snapshot_t::GYRO) ? CallAsync<COMM_CMD::GET_IMU_GYRO>(NULL) : -1;
+    handles[4] = (fields & Snapshot_t::ACC) ? CallAsync<COMM_CMD::GET_IMU_ACC>(NULL) : -1;
+    handles[5] = (fields & Snapshot_t::BUTTON)
+                     ? CallAsync<COMM_CMD::GET_BUTTONS_STATE>(NULL) : -1;
+    handles[6] = (fields & Snapshot_t::POWER) ? CallAsync<COMM_CMD::GET_POWER_INFO>(NULL) : -1;
+
+    RESULT result = RESULT::OK;
+    for (uint8_t bit = 0; bit < SNAPSHOT_FIELD_NUM; bit++) {
+        if ((fields & (1 << bit)) == 0) continue;
+
+        // A request that could not be queued awaits as ERROR
+        uint8_t reply[MatrixR4_ASYNC_REPLY_SIZE];
+        RESULT  r = await(handles[bit], reply, sizeof(reply));
+        if (r != RESULT::OK) {
+            if (result == RESULT::OK) result = r;
+            continue;
+        }
+        // The speed reply starts with a status byte, the low byte of the
+        // 16 bit button flags comes first.
+        DecodeSnapshotField(bit, (1 << bit) == Snapshot_t::SPEED ? reply + 1 : reply, snap);
+        snap.fields |= 1 << bit;
+    }
+    snap.sampleUs = RxSampleUs();
+    return result;
+}
 
-    CommSendData(COMM_CMD::SET_IMU_TO_ZERO);
-    if (!WaitData(COMM_CMD::SET_IMU_TO_ZERO, 1000)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
+void MMLower::SnapshotShadow(const Snapshot_t& snap)
+{
+    if (snap.fields & Snapshot_t::ENCODER) {
+        for (uint8_t i = 0; i < MatrixR4_ENCODER_NUM; i++) {
+            EncoderReconcile(i, snap.enCounter[i]);
+        }
+        enCounterUs = snap.sampleUs;
+    }
+    if (snap.fields & Snapshot_t::EULER) {
+        imuEuler[0] = snap.roll;
+        imuEuler[1] = snap.pitch;
+        imuEuler[2] = snap.yaw;
+        PublishIMU(imuEuler, imuRoll, imuPitch, imuYaw);
+        imuEulerUs = snap.sampleUs;
+    }
+    if (snap.fields & Snapshot_t::GYRO) {
+        imuGyro[0] = snap.gyroX;
+        imuGyro[1] = snap.gyroY;
+        imuGyro[2] = snap.gyroZ;
+        PublishIMU(imuGyro, imuGyroX, imuGyroY, imuGyroZ);
+        imuGyroUs = snap.sampleUs;
+    }
+    if (snap.fields & Snapshot_t::ACC) {
+        imuAcc[0] = snap.accX;
+        imuAcc[1] = snap.accY;
+        imuAcc[2] = snap.accZ;
+        PublishIMU(imuAcc, imuAccX, imuAccY, imuAccZ);
+        imuAccUs = snap.sampleUs;
+    }
+    if (snap.fields & Snapshot_t::BUTTON) {
+        for (uint8_t i = 0; i < MatrixR4_BUTTON_NUM; i++) {
+            btnState[i] = snap.btnState[i];
+        }
+        btnStateUs = snap.sampleUs;
     }
+}
+
+// Other-Info
+MMLower::RESULT MMLower::EchoTest(void)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[EchoTest]"));
 
     uint8_t b[1];
-    if (!CommReadData(b, 1, 10)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+    RESULT  result = Query<COMM_CMD::ECHO_TEST>(b, (uint8_t)0x55);
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+    return (b[0] == 0x55) ? RESULT::OK : RESULT::ERROR;
 }
-// Getting
-MMLower::RESULT MMLower::GetButtonState(uint8_t num, bool& btnState)
+
+MMLower::RESULT MMLower::GetFWVersion(String& version)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetButtonState]"));
+    MR4_DEBUG_PRINT_HEADER(F("[GetFWVersion]"));
+
+    uint8_t b[1];
+    RESULT  result = Query<COMM_CMD::F_VERSION>(b);
+    if (result != RESULT::OK) return result;
+
+    version = String(b[0] / 10.0f);
+    return RESULT::OK;
+}
 
-    uint8_t data[1] = {--num};
-    CommSendData(COMM_CMD::GET_BUTTON_STATE, data, 1);
-    if (!WaitData(COMM_CMD::GET_BUTTON_STATE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+/**
+ * @brief Firmware version as numbers, e.g. 6 and 1 for "6.10".
+ */
+MMLower::RESULT MMLower::GetFWVersion(uint8_t& major, uint8_t& minor)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[GetFWVersion]"));
 
     uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-	
-	btnState = (bool)b[0];
+    RESULT  result = Query<COMM_CMD::F_VERSION>(b);
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
+    major = b[0] / 10;
+    minor = b[0] % 10;
     return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::GetButtonsState(bool* btnsState)
+// Build day reply: year, month, day
+typedef WireLayout<uint16_t, uint8_t, uint8_t> BuildDay_t;
+
+// "YYYY-MM-DD"
+static String BuildDayString(uint16_t year, uint8_t month, uint8_t day)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetButtonsState]"));
+    char str[16];
+    snprintf(str, sizeof(str), "%04u-%02u-%02u", year, month, day);
+    return String(str);
+}
 
-    CommSendData(COMM_CMD::GET_BUTTONS_STATE);
-    if (!WaitData(COMM_CMD::GET_BUTTONS_STATE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::RESULT MMLower::GetFWBuildDay(String& date)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[GetFWBuildDay]"));
 
-    uint8_t b[2];
-    if (!CommReadData(b, 2)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    uint16_t flag = BitConverter::ToUInt16(b, 0);
-    btnsState[0]  = (bool)(flag);
-    btnsState[1]  = (bool)(flag >> 1);
+    uint8_t b[BuildDay_t::Size];
+    RESULT  result = Query<COMM_CMD::F_BUILD_DAY>(b);
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
+    uint16_t year;
+    uint8_t  month, day;
+    BuildDay_t::Unpack(b, year, month, day);
+    date = BuildDayString(year, month, day);
     return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::GetALLEncoderSpeed(int32_t * enSpeed)
+MMLower::RESULT MMLower::GetFWDescriptor(String& descriptor)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[Get_ALL_Encoder_SPEED]"));
+    MR4_DEBUG_PRINT_HEADER(F("[GetFWDescriptor]"));
 
-    CommSendData(COMM_CMD::GET_SPEED_ALL_DC_MOTOR);
-    if (!WaitData(COMM_CMD::GET_SPEED_ALL_DC_MOTOR, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    uint8_t b[1];
+    RESULT  result = Query<COMM_CMD::F_DESCRIPTOR>(b);
+    if (result != RESULT::OK) return result;
 
-    uint8_t b[17];
-    if (!CommReadData(b, 17)) {
+    uint8_t len = b[0];
+    uint8_t str[len + 1];
+    if (!CommReadData(str, len)) {
         MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
         return RESULT::ERROR_READ_TIMEOUT;
     }
-    enSpeed[0] = BitConverter::ToInt32(b, 1);
-    enSpeed[1] = BitConverter::ToInt32(b, 5);
-    enSpeed[2] = BitConverter::ToInt32(b, 9);
-    enSpeed[3] = BitConverter::ToInt32(b, 13);
-
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
+    str[len]   = '\0';
+    descriptor = String((char*)str);
     return RESULT::OK;
 }
 
-
-MMLower::RESULT MMLower::Get_IMU_nancalib_acc(float * accdata)
+MMLower::RESULT MMLower::GetModelIndex(uint8_t& index)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[Get_IMU_nancalib_acc]"));
-
-    CommSendData(COMM_CMD::GET_IMU_ACC_NOcal);
-    if (!WaitData(COMM_CMD::GET_IMU_ACC_NOcal, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    MR4_DEBUG_PRINT_HEADER(F("[GetModelIndex]"));
 
-    uint8_t b[13];
-    if (!CommReadData(b, 13)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    accdata[0] = BitConverter::Tofloat(b, 1);
-    accdata[1] = BitConverter::Tofloat(b, 5);
-    accdata[2] = BitConverter::Tofloat(b, 9);
+    uint8_t b[1];
+    RESULT  result = Query<COMM_CMD::READ_MODEL_INDEX>(b);
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
+    index = b[0];
     return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::GetEncoderDegrees(uint8_t num, int32_t& enDeges)
+MMLower::RESULT MMLower::GetAllInfo(AllInfo_t& info)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetEncoderDegrees]"));
+    MR4_DEBUG_PRINT_HEADER(F("[GetAllInfo]"));
 
-    uint8_t data[1] = {--num};
-    CommSendData(COMM_CMD::GET_ENCODER_DEGREES, data, 1);
-    if (!WaitData(COMM_CMD::GET_ENCODER_DEGREES, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    // version, build day, model index
+    typedef WireLayout<uint8_t, uint16_t, uint8_t, uint8_t, uint8_t> Reply_t;
 
-    uint8_t b[4];
-    if (!CommReadData(b, 4)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    enDeges = BitConverter::ToInt32(b, 0);
+    uint8_t b[Reply_t::Size];
+    RESULT  result = Query<COMM_CMD::READ_ALL_INFO>(b);
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
+    uint8_t  version, month, day;
+    uint16_t year;
+    Reply_t::Unpack(b, version, year, month, day, info.modelIndex);
+    info.fwVersion  = String(version / 10.0f);
+    info.fwBuildDay = BuildDayString(year, month, day);
     return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::GetEncoderCounter(uint8_t num, int32_t& enCounter)
+MMLower::RESULT MMLower::RunAutoQC(void)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetEncoderCounter]"));
-
-    uint8_t data[1] = {--num};
-    CommSendData(COMM_CMD::GET_ENCODER_COUNTER, data, 1);
-    if (!WaitData(COMM_CMD::GET_ENCODER_COUNTER, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    MR4_DEBUG_PRINT_HEADER(F("[RunAutoQC]"));
 
-    uint8_t b[4];
-    if (!CommReadData(b, 4)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    enCounter = BitConverter::ToInt32(b, 0);
+    uint8_t b[1];
+    RESULT  result = Query<COMM_CMD::RUN_AUTO_QC>(b);
+    if (result != RESULT::OK) return result;
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+    return ((b[0] & 0x01) == 0x00) ? RESULT::ERROR_QC_IMU : RESULT::OK;
 }
 
-MMLower::RESULT MMLower::GetAllEncoderCounter(int32_t* enCounter)
+/**
+ * @brief Switch the link between the legacy and the framed protocol.
+ *
+ * The request itself goes out in the current mode. The new mode is used
+ * only after the lower board acknowledged it.
+ */
+MMLower::RESULT MMLower::SetCommFraming(bool enable)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetAllEncoderCounter]"));
+    MR4_DEBUG_PRINT_HEADER(F("[SetCommFraming]"));
 
-    CommSendData(COMM_CMD::GET_ALL_ENCODER_COUNTER);
-    if (!WaitData(COMM_CMD::GET_ALL_ENCODER_COUNTER, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
+    RESULT result =
+        Call<COMM_CMD::SET_COMM_FRAMING>((uint8_t)(enable ? MatrixR4_FRAME_VERSION : 0x00));
+    if (result == RESULT::OK) {
+        if (framed != enable) RtoReset();   // frame sizes change the round trips
+        framed   = enable;
+        rxRawLen = 0;
+        rxState  = COMM_STATE::WAIT_LEAD;
+        // The lower board drops the timestamps together with the framing.
+        if (!enable) stamped = false;
     }
+    return result;
+}
 
-    uint8_t b[16];
-    if (!CommReadData(b, 16)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    enCounter[0] = BitConverter::ToInt32(b, 0);
-    enCounter[1] = BitConverter::ToInt32(b, 4);
-    enCounter[2] = BitConverter::ToInt32(b, 8);
-    enCounter[3] = BitConverter::ToInt32(b, 12);
+/**
+ * @brief Have the lower board append its µs tick to every reply and
+ * auto-send frame (framed link only, legacy frames carry no length).
+ *
+ * Like SetCommFraming() the acknowledge still comes in the old format.
+ * Call SyncClock() afterwards, loop() then keeps the clock in sync.
+ */
+MMLower::RESULT MMLower::SetCommTimestamp(bool enable)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetCommTimestamp]"));
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+    if (!framed) return RESULT::ERROR;
+
+    RESULT result = Call<COMM_CMD::SET_COMM_TIMESTAMP>((uint8_t)enable);
+    if (result == RESULT::OK) stamped = enable;
+    return result;
 }
 
-MMLower::RESULT MMLower::GetIMUEuler(double& roll, double& pitch, double& yaw)
+/**
+ * @brief Sample the lower board clock with a burst of EchoTest round trips.
+ *
+ * Gives a first offset estimate. The drift needs samples spread over time,
+ * loop() adds one every SetClockSyncInterval().
+ */
+MMLower::RESULT MMLower::SyncClock(uint8_t rounds)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetIMUEuler]"));
+    MR4_DEBUG_PRINT_HEADER(F("[SyncClock]"));
 
-    CommSendData(COMM_CMD::GET_IMU_EULER);
-    if (!WaitData(COMM_CMD::GET_IMU_EULER, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    if (!stamped) return RESULT::ERROR;
 
-    uint8_t b[6];
-    if (!CommReadData(b, 6)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
+    clockSyncAt = millis();
+    for (uint8_t i = 0; i < rounds; i++) {
+        uint32_t sendUs = micros();
+        RESULT   result = EchoTest();
+        if (result != RESULT::OK) return result;
+        if (rxHasTick) clockSync.AddSample(sendUs, rxTick, rxTickUs);
     }
-
-    roll  = BitConverter::ToInt16(b, 0) / 100.0f;
-    pitch = BitConverter::ToInt16(b, 2) / 100.0f;
-    yaw   = BitConverter::ToInt16(b, 4) / 100.0f;
-
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
     return RESULT::OK;
 }
 
-MMLower::RESULT MMLower::GetIMUGyro(double& x, double& y, double& z)
+/**
+ * @brief Set how often loop() samples the lower board clock, 0 turns it off.
+ * Each sample blocks loop() for one EchoTest round trip. Default 1000.
+ */
+void MMLower::SetClockSyncInterval(uint16_t intervalMs)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetIMUGyro]"));
+    clockSyncMs = intervalMs;
+}
 
-    CommSendData(COMM_CMD::GET_IMU_GYRO);
-    if (!WaitData(COMM_CMD::GET_IMU_GYRO, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+/**
+ * @brief Move the link to another baud rate.
+ *
+ * The lower board acknowledges at the current rate and then switches. The
+ * link is verified with EchoTest at the new rate and falls back to the old
+ * one when that fails (the board reverts on its own when it hears nothing).
+ */
+MMLower::RESULT MMLower::SetCommBaudrate(uint32_t baudrate)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetCommBaudrate]"));
 
-    uint8_t b[6];
-    if (!CommReadData(b, 6)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
+    RESULT result = Call<COMM_CMD::SET_COMM_BAUDRATE>(baudrate);
+    if (result != RESULT::OK) return result;
+
+    // Round trips change with the rate, the check below waits the full timeout.
+    RtoReset();
+    uint32_t oldBaudrate = _baudrate;
+    commSerial->end();
+    commSerial->begin(baudrate);
+    if (EchoTest() == RESULT::OK) {
+        _baudrate = baudrate;
+        return RESULT::OK;
     }
-    x = BitConverter::ToInt16(b, 0) / 100.0f;
-    y = BitConverter::ToInt16(b, 2) / 100.0f;
-    z = BitConverter::ToInt16(b, 4) / 100.0f;
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+    commSerial->end();
+    commSerial->begin(oldBaudrate);
+    RtoReset();
+    return RESULT::ERROR;
 }
 
-MMLower::RESULT MMLower::GetIMUAcc(double& x, double& y, double& z)
+//--------------------------------------------------------------//
+//--------------------------------------------------------------//
+//  New Drive DC 2 Motor Function  //
+//--------------------------------------------------------------//
+//--------------------------------------------------------------//
+MMLower::Drive_RESULT MMLower::Set_Drive2Motor_PARAM(
+    uint8_t m1_num, uint8_t m2_num, DIR m1_dir, DIR m2_dir, uint8_t num)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetIMUAcc]"));
+    MR4_DEBUG_PRINT_HEADER(F("[SetDriveDC_2motor_Param]"));
+    return Call<COMM_CMD::SET_DC_TWO_MOTOR_PARAM, Drive_RESULT>(
+        m1_num, m2_num, (uint8_t)m1_dir, (uint8_t)m2_dir, (uint8_t)(num - 1));
+}
 
-    CommSendData(COMM_CMD::GET_IMU_ACC);
-    if (!WaitData(COMM_CMD::GET_IMU_ACC, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::RESULT MMLower::Set_Drive_MoveSync_PID(float Kp, float Ki, float Kd, uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_MoveSync_PID]"));
+    return Call<COMM_CMD::SET_DC_TWO_MoveSync_PID>(Kp, Ki, Kd, (uint8_t)(num - 1));
+}
 
-    uint8_t b[6];
-    if (!CommReadData(b, 6)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    x = BitConverter::ToInt16(b, 0) / 1000.0f;
-    y = BitConverter::ToInt16(b, 2) / 1000.0f;
-    z = BitConverter::ToInt16(b, 4) / 1000.0f;
+MMLower::RESULT MMLower::Set_Drive_MoveGyro_PID(float Kp, float Ki, float Kd, uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_MoveGyro_PID]"));
+    return Call<COMM_CMD::SET_DC_TWO_MoveGyro_PID>(Kp, Ki, Kd, (uint8_t)(num - 1));
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+MMLower::RESULT MMLower::Set_Drive_MoveTurn_PID(float Kp, float Ki, float Kd, uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_MoveTurn_PID]"));
+    return Call<COMM_CMD::SET_DC_TWO_TurnGyro_PID>(Kp, Ki, Kd, (uint8_t)(num - 1));
 }
 
-MMLower::RESULT MMLower::GetPowerInfo(float& curVolt, float& curVoltPerc)
+MMLower::Drive_RESULT MMLower::Set_Drive_Encode_PPR(uint8_t num, uint16_t* ppr)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetPowerInfo]"));
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_Encode_PPR]"));
+    return Call<COMM_CMD::SET_DC_TWO_MOTOR_PPR, Drive_RESULT>(ppr[0], ppr[1], (uint8_t)(num - 1));
+}
 
-    CommSendData(COMM_CMD::GET_POWER_INFO);
-    if (!WaitData(COMM_CMD::GET_POWER_INFO, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::Drive_RESULT MMLower::Set_Drive_Motor_Type(uint8_t num, uint8_t type)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_Motor_Type]"));
+    return Call<COMM_CMD::SET_DC_MOTOR_TYPE, Drive_RESULT>((uint8_t)(num - 1), type);
+}
 
-    uint8_t b[3];
-    if (!CommReadData(b, 3)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+/*********************************************************************
+*********************************************************************/
 
-    uint16_t voltRaw = BitConverter::ToUInt16(b, 0);
-    curVolt          = (float)voltRaw / 1000.0f;
-    curVoltPerc      = (float)b[2];
+MMLower::Drive_RESULT MMLower::Set_Drive_Move_Func(
+    int16_t power_left, int16_t power_right, uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_MovePower]"));
+    return Call<COMM_CMD::SET_Drive_Move, Drive_RESULT>(
+        power_left, power_right, (uint8_t)(num - 1));
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+MMLower::Drive_RESULT MMLower::Set_Drive_Move_Degs(
+    int16_t power_left, int16_t power_right, uint16_t Degree_c, bool brake, bool async,
+    uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_MoveDegs]"));
+    Drive_RESULT result = Call<COMM_CMD::SET_Drive_MoveDegs, Drive_RESULT>(
+        power_left, power_right, Degree_c, brake, async, (uint8_t)(num - 1));
+    if (Degree_c > 0) TaskStarted(TASK::DRIVE, num, (uint8_t)result);
+    return result;
 }
 
-MMLower::RESULT MMLower::GetRotateState(uint8_t num, bool& isEnd)
+MMLower::Drive_RESULT MMLower::Set_Drive_Move_Time(
+    int16_t power_left, int16_t power_right, uint32_t Time_mS, bool brake, bool async,
+    uint8_t num)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetRotateState]"));
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_MoveTime]"));
+    Drive_RESULT result = Call<COMM_CMD::SET_Drive_MoveTime, Drive_RESULT>(
+        power_left, power_right, Time_mS, brake, async, (uint8_t)(num - 1));
+    if (Time_mS > 0) TaskStarted(TASK::DRIVE, num, (uint8_t)result);
+    return result;
+}
 
-    uint8_t data[1] = {--num};
-    CommSendData(COMM_CMD::GET_ROTATE_STATE, data, 1);
-    if (!WaitData(COMM_CMD::GET_ROTATE_STATE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::Drive_RESULT MMLower::Set_Drive_MoveSync_Func(
+    int16_t power_left, int16_t power_right, uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_Move_SyncPower]"));
+    return Call<COMM_CMD::SET_Drive_MoveSync, Drive_RESULT>(
+        power_left, power_right, (uint8_t)(num - 1));
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    isEnd = b[0];
+MMLower::Drive_RESULT MMLower::Set_Drive_MoveSync_Degs(
+    int16_t power_left, int16_t power_right, uint16_t Degree_c, bool brake, bool async,
+    uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveSync_Degs]"));
+    Drive_RESULT result = Call<COMM_CMD::SET_Drive_MoveSyncDegs, Drive_RESULT>(
+        power_left, power_right, Degree_c, brake, async, (uint8_t)(num - 1));
+    if (Degree_c > 0) TaskStarted(TASK::DRIVE, num, (uint8_t)result);
+    return result;
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+MMLower::Drive_RESULT MMLower::Set_Drive_MoveSync_Time(
+    int16_t power_left, int16_t power_right, uint32_t Time_mS, bool brake, bool async,
+    uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveSync_Time]"));
+    Drive_RESULT result = Call<COMM_CMD::SET_Drive_MoveSyncTime, Drive_RESULT>(
+        power_left, power_right, Time_mS, brake, async, (uint8_t)(num - 1));
+    if (Time_mS > 0) TaskStarted(TASK::DRIVE, num, (uint8_t)result);
+    return result;
 }
-// Other-Info
-MMLower::RESULT MMLower::EchoTest(void)
+
+MMLower::Drive_RESULT MMLower::Set_Drive_MoveGyro_Func(
+    int16_t power, int16_t Target_dri, uint8_t num)
 {
+    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveGyro]"));
+    return Call<COMM_CMD::SET_Drive_Gyro, Drive_RESULT>(power, Target_dri, (uint8_t)(num - 1));
+}
 
-    MR4_DEBUG_PRINT_HEADER(F("[EchoTest]"));
+MMLower::Drive_RESULT MMLower::Set_Drive_MoveGyro_Degs(
+    int16_t power, int16_t Target_dri, uint16_t Degree_c, bool brake, bool async, uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveGyro_Degs]"));
+    Drive_RESULT result = Call<COMM_CMD::SET_Drive_GyroDegs, Drive_RESULT>(
+        power, Target_dri, Degree_c, brake, async, (uint8_t)(num - 1));
+    if (Degree_c > 0) TaskStarted(TASK::DRIVE, num, (uint8_t)result);
+    return result;
+}
 
-    uint8_t data[1] = {0x55};
-    CommSendData(COMM_CMD::ECHO_TEST, data, 1);
-    if (!WaitData(COMM_CMD::ECHO_TEST, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::Drive_RESULT MMLower::Set_Drive_MoveGyro_Time(
+    int16_t power, int16_t Target_dri, uint32_t Time_mS, bool brake, bool async, uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveGyro_Time]"));
+    Drive_RESULT result = Call<COMM_CMD::SET_Drive_GyroTime, Drive_RESULT>(
+        power, Target_dri, Time_mS, brake, async, (uint8_t)(num - 1));
+    if (Time_mS > 0) TaskStarted(TASK::DRIVE, num, (uint8_t)result);
+    return result;
+}
 
-    uint8_t b[8];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-	
-    if (b[0] == data[0]) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return RESULT::ERROR;
+MMLower::Drive_RESULT MMLower::Set_Drive_TurnGyro(
+    int16_t power, int16_t Target_dri, uint8_t mode, bool brake, bool async, uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_TurnGyro]"));
+    Drive_RESULT result = Call<COMM_CMD::SET_Drive_Turn, Drive_RESULT>(
+        power, Target_dri, mode, brake, async, (uint8_t)(num - 1));
+    TaskStarted(TASK::DRIVE, num, (uint8_t)result);
+    return result;
 }
 
-MMLower::RESULT MMLower::GetFWVersion(String& version)
+//=========================================//
+//=========================================//
+//=========================================//
+
+
+MMLower::Drive_RESULT MMLower::Get_Drive_isTaskDone(uint8_t num, bool* isEnd)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetFWVersion]"));
+    MR4_DEBUG_PRINT_HEADER(F("[GET_Task_Done_Status]"));
 
-    CommSendData(COMM_CMD::F_VERSION);
-    if (!WaitData(COMM_CMD::F_VERSION, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    uint8_t      b[1];
+    Drive_RESULT result =
+        Query<COMM_CMD::GET_Task_Done_Status, Drive_RESULT>(b, (uint8_t)1, (uint8_t)(num - 1));
+    if (result != Drive_RESULT::OK) return result;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
+    if (b[0] == 0x01) {
+        isEnd[0] = false;
+    } else if (b[0] == 0x02) {
+        isEnd[0] = true;
+    } else if (b[0] == 0x07) {
+        return Drive_RESULT::ERROR_Drive_Define;
     }
+    return Drive_RESULT::OK;
+}
 
-    version = String(b[0] / 10.0f);
+MMLower::Drive_RESULT MMLower::Set_Drive_Brake(bool brake, uint8_t num)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_Brake]"));
+    return Call<COMM_CMD::SET_Drive_Brake, Drive_RESULT>(brake, (uint8_t)(num - 1));
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+MMLower::Drive_RESULT MMLower::Set_Drive_Reset_Count(uint8_t num, bool reset)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SET_DC_TWO_MOTOR_Reset_count]"));
+    return Call<COMM_CMD::SET_DC_TWO_MOTOR_Reset_count, Drive_RESULT>(reset, (uint8_t)(num - 1));
 }
 
-MMLower::RESULT MMLower::GetFWBuildDay(String& date)
+MMLower::Drive_RESULT MMLower::Get_Drive_EncoderCounter(uint8_t num, int32_t& enCounter)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetFWBuildDay]"));
+    MR4_DEBUG_PRINT_HEADER(F("[Get_Drive_EncoderCounter]"));
 
-    CommSendData(COMM_CMD::F_BUILD_DAY);
-    if (!WaitData(COMM_CMD::F_BUILD_DAY, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    uint8_t      b[4];
+    Drive_RESULT result = Query<COMM_CMD::GET_Drive_Counter, Drive_RESULT>(b, (uint8_t)(num - 1));
+    if (result != Drive_RESULT::OK) return result;
+    // The lower board answers an undefined drive with 0x07 in the first byte.
+    if (b[0] == 0x07) return Drive_RESULT::ERROR_Drive_Define;
 
-    uint8_t b[4];
-    if (!CommReadData(b, 4)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+    WireUnpack(b, enCounter);
+    return Drive_RESULT::OK;
+}
+
+MMLower::Drive_RESULT MMLower::Get_Drive_Degrees(uint8_t num, int32_t& Degs)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[Get_Drive_Degrees]"));
 
-    uint16_t year  = BitConverter::ToUInt16(b, 0);
-    uint8_t  month = b[2];
-    uint8_t  day   = b[3];
+    uint8_t      b[4];
+    Drive_RESULT result = Query<COMM_CMD::GET_Drive_Degress, Drive_RESULT>(b, (uint8_t)(num - 1));
+    if (result != Drive_RESULT::OK) return result;
+    if (b[0] == 0x07) return Drive_RESULT::ERROR_Drive_Define;
 
-    char str[10];
-    sprintf(str, "%04d-%02d-%02d", year, month, day);
-    date = String(str);
+    WireUnpack(b, Degs);
+    return Drive_RESULT::OK;
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+//--------------------------------------------------------------//
+//--------------------------------------------------------------//
+
+
+//--------------------------------------------------------------//
+//  Telemetry  //
+//--------------------------------------------------------------//
+MMLower::RESULT MMLower::SetButtonEchoMode(BUTTON_ECHO_MODE mode)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetButtonEchoMode]"));
+    return Call<COMM_CMD::SET_BUTTON_INIT>((uint8_t)mode);
+}
+
+MMLower::RESULT MMLower::SetEncoderEchoMode(ENCODER_ECHO_MODE mode, uint16_t echoIntervalMs)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[SetEncoderEchoMode]"));
+    return Call<COMM_CMD::SET_ENCODER_ECHO_MODE>((uint8_t)mode, echoIntervalMs);
 }
 
-MMLower::RESULT MMLower::GetFWDescriptor(String& descriptor)
+/**
+ * @brief ACTIVE: the lower board sends AUTO_SEND_TASK_DONE when a rotate or
+ * DriveDC task ends, finished or stopped by another command.
+ */
+MMLower::RESULT MMLower::SetTaskEchoMode(TASK_ECHO_MODE mode)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetFWDescriptor]"));
+    MR4_DEBUG_PRINT_HEADER(F("[SetTaskEchoMode]"));
+    return Call<COMM_CMD::SET_TASK_ECHO_MODE>((uint8_t)mode);
+}
 
-    CommSendData(COMM_CMD::F_DESCRIPTOR);
-    if (!WaitData(COMM_CMD::F_DESCRIPTOR, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+/**
+ * @brief Turn a lower board auto-send stream on or off.
+ *
+ * The shadow state is seeded with one synchronous read first, afterwards
+ * it is kept current by the stream as frames are parsed (loop() or any
+ * other command).
+ *
+ * @param stream The stream to configure.
+ * @param intervalMs Send interval, 0 turns the stream off. Ignored for
+ *                   buttons and tasks, which are sent on change.
+ */
+MMLower::RESULT MMLower::Subscribe(TELEMETRY stream, uint16_t intervalMs)
+{
+    uint8_t mask   = (1 << (uint8_t)stream);
+    bool    enable = (intervalMs > 0);
+    RESULT  result = RESULT::ERROR;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
+    subscribed &= ~mask;
+    switch (stream) {
+    case TELEMETRY::BUTTON:
+    {
+        if (enable) {
+            bool   states[MatrixR4_BUTTON_NUM];
+            result = GetButtonsState(states);
+            if (result != RESULT::OK) return result;
+            for (uint8_t i = 0; i < MatrixR4_BUTTON_NUM; i++) {
+                btnState[i] = states[i];
+            }
+            btnStateUs = RxSampleUs();
+        }
+        result = SetButtonEchoMode(enable ? BUTTON_ECHO_MODE::ACTIVE : BUTTON_ECHO_MODE::PASSIVE);
+    } break;
+    case TELEMETRY::ENCODER:
+    {
+        if (enable) {
+            int32_t counters[MatrixR4_ENCODER_NUM];
+            result = GetAllEncoderCounter(counters);
+            if (result != RESULT::OK) return result;
+            enReconcileAt = millis();
+        }
+        result = SetEncoderEchoMode(
+            enable ? ENCODER_ECHO_MODE::ACTIVE : ENCODER_ECHO_MODE::PASSIVE, intervalMs);
+    } break;
+    case TELEMETRY::IMU:
+    {
+        result = SetIMUEchoMode(enable ? IMU_ECHO_MODE::TIMING : IMU_ECHO_MODE::PASSIVE, intervalMs);
+    } break;
+    case TELEMETRY::TASK:
+    {
+        result = SetTaskEchoMode(enable ? TASK_ECHO_MODE::ACTIVE : TASK_ECHO_MODE::PASSIVE);
+        if (result != RESULT::OK || !enable) break;
+        // Tasks that ended before the board started to push
+        for (uint8_t t = 0; t < 2; t++) {
+            for (uint8_t i = 0; i < MatrixR4_DC_MOTOR_NUM; i++) {
+                bool isDone;
+                if (!(taskRunning[t] & (1 << i))) continue;
+                if (QueryTaskState((TASK)t, i + 1, isDone) == RESULT::OK && isDone) {
+                    TaskDone((TASK)t, i + 1, micros());
+                }
+            }
+        }
+    } break;
+    default: break;
     }
 
-    uint8_t len = b[0];
-    uint8_t str[len + 1];
-    if (!CommReadData(str, len)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    str[len]   = '\0';
-    descriptor = String((char*)str);
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+    if (result == RESULT::OK && enable) subscribed |= mask;
+    return result;
 }
 
-MMLower::RESULT MMLower::GetModelIndex(uint8_t& index)
+void MMLower::SetTelemetryMaxAge(uint16_t maxAgeMs)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetModelIndex]"));
-
-    CommSendData(COMM_CMD::READ_MODEL_INDEX);
-    if (!WaitData(COMM_CMD::READ_MODEL_INDEX, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    telemetryMaxAgeUs = (uint32_t)maxAgeMs * 1000;
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    index = b[0];
+bool MMLower::GetCachedButtonState(uint8_t num, bool& state)
+{
+    if (num < 1 || num > MatrixR4_BUTTON_NUM) return false;
+    // Buttons are sent on change, the cache never goes stale while subscribed.
+    if (!IsFresh(TELEMETRY::BUTTON, btnStateUs, false)) return false;
+    state = btnState[num - 1];
+    return true;
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+bool MMLower::GetCachedEncoderCounter(uint8_t num, int32_t& counter)
+{
+    if (num < 1 || num > MatrixR4_ENCODER_NUM) return false;
+    if (!IsFresh(TELEMETRY::ENCODER, enCounterUs, true)) return false;
+    counter = enCounter[num - 1];
+    return true;
 }
 
-MMLower::RESULT MMLower::GetAllInfo(AllInfo_t& info)
+/**
+ * @brief Full range encoder count, extended from the 16 bit stream.
+ *
+ * Unlike the stream itself the count never wraps. See SetEncoderReconcile().
+ */
+bool MMLower::GetCachedEncoderCounter64(uint8_t num, int64_t& counter)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GetAllInfo]"));
+    if (num < 1 || num > MatrixR4_ENCODER_NUM) return false;
+    if (!IsFresh(TELEMETRY::ENCODER, enCounterUs, true)) return false;
+    counter = enCounter64[num - 1];
+    return true;
+}
 
-    CommSendData(COMM_CMD::F_VERSION);
-    if (!WaitData(COMM_CMD::F_VERSION, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+/**
+ * @brief Set how often the streamed encoder counts are checked against a
+ * full 32 bit read of all counters.
+ *
+ * The stream only carries the low 16 bits, a wheel that moves more than
+ * 32767 counts between two samples (or a dropped frame) would slip a whole
+ * turn of the 16 bit range. The periodic read repairs that, it is sent
+ * asynchronously from loop() while the encoder stream is subscribed.
+ *
+ * @param intervalMs Reconcile interval, 0 turns it off. Default 1000.
+ */
+void MMLower::SetEncoderReconcile(uint16_t intervalMs)
+{
+    enReconcileMs = intervalMs;
+}
 
-    uint8_t b[6];
-    if (!CommReadData(b, 6)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    uint16_t year  = BitConverter::ToUInt16(b, 0);
-    uint8_t  month = b[2];
-    uint8_t  day   = b[3];
+bool MMLower::GetCachedIMUEuler(float& roll, float& pitch, float& yaw)
+{
+    if (!IsFresh(TELEMETRY::IMU, imuEulerUs, true)) return false;
+    roll  = imuEuler[0];
+    pitch = imuEuler[1];
+    yaw   = imuEuler[2];
+    return true;
+}
 
-    char str[10];
-    sprintf(str, "%04d-%02d-%02d", year, month, day);
+bool MMLower::GetCachedIMUGyro(float& x, float& y, float& z)
+{
+    if (!IsFresh(TELEMETRY::IMU, imuGyroUs, true)) return false;
+    x = imuGyro[0];
+    y = imuGyro[1];
+    z = imuGyro[2];
+    return true;
+}
 
-    info.fwVersion  = String(b[0] / 10.0f);
-    info.fwBuildDay = String(str);
-    info.modelIndex = b[5];
+bool MMLower::GetCachedIMUAcc(float& x, float& y, float& z)
+{
+    if (!IsFresh(TELEMETRY::IMU, imuAccUs, true)) return false;
+    x = imuAcc[0];
+    y = imuAcc[1];
+    z = imuAcc[2];
+    return true;
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+bool MMLower::GetCachedIMUEuler(double& roll, double& pitch, double& yaw)
+{
+    float r, p, y;
+    if (!GetCachedIMUEuler(r, p, y)) return false;
+    roll = r, pitch = p, yaw = y;
+    return true;
 }
 
-MMLower::RESULT MMLower::RunAutoQC(void)
+bool MMLower::GetCachedIMUGyro(double& x, double& y, double& z)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[RunAutoQC]"));
+    float fx, fy, fz;
+    if (!GetCachedIMUGyro(fx, fy, fz)) return false;
+    x = fx, y = fy, z = fz;
+    return true;
+}
 
-    CommSendData(COMM_CMD::RUN_AUTO_QC);
-    if (!WaitData(COMM_CMD::RUN_AUTO_QC, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+bool MMLower::GetCachedIMUAcc(double& x, double& y, double& z)
+{
+    float fx, fy, fz;
+    if (!GetCachedIMUAcc(fx, fy, fz)) return false;
+    x = fx, y = fy, z = fz;
+    return true;
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
+bool MMLower::IsFresh(TELEMETRY stream, const uint32_t& stampUs, bool checkAge)
+{
+    if ((subscribed & (1 << (uint8_t)stream)) == 0) return false;
 
-    if ((b[0] & 0x01) == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_QC_IMU"));
-        return RESULT::ERROR_QC_IMU;
-    }
+    // Parse whatever is already buffered so the cache is current, leave the
+    // rest of loop() to loop(). Not while a reply is awaited: RxPump() would
+    // hand its frame to us instead of the waiter.
+    if (rxWaitCmd == COMM_CMD::NONE) RxPump();
+    if (stampUs == 0) return false;
+    return (!checkAge || (uint32_t)(micros() - stampUs) <= telemetryMaxAgeUs);
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return RESULT::OK;
+// Extend an authoritative 32 bit count into the 64 bit count.
+void MMLower::EncoderReconcile(uint8_t num, int32_t counter)
+{
+    enCounter64[num] += (int32_t)((uint32_t)counter - (uint32_t)enCounter64[num]);
+    enCounter[num]    = counter;
 }
 
-//--------------------------------------------------------------//
-//--------------------------------------------------------------//
-//  New Drive DC 2 Motor Function  //
-//--------------------------------------------------------------//
-//--------------------------------------------------------------//
-MMLower::Drive_RESULT MMLower::Set_Drive2Motor_PARAM(uint8_t m1_num, uint8_t m2_num, DIR m1_dir, DIR m2_dir, uint8_t num)
+void MMLower::EncoderReconcilePump(void)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SetDriveDC_2motor_Param]"));
+    if (enReconcileHandle >= 0) {
+        uint8_t b[16];
+        RESULT  result = poll(enReconcileHandle, b, sizeof(b));
+        if (result == RESULT::PENDING) return;
 
-    uint8_t data[5] = {m1_num, m2_num, (uint8_t)m1_dir, (uint8_t)m2_dir, (num - 1)};
-	
-    CommSendData(COMM_CMD::SET_DC_TWO_MOTOR_PARAM, data, 5);
-    if (!WaitData(COMM_CMD::SET_DC_TWO_MOTOR_PARAM, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+        enReconcileHandle = -1;
+        // A push sampled after the read went out may be newer than the reply,
+        // applying the reply then would move the count back. Skip this round.
+        if (result == RESULT::OK && (int32_t)(enCounterUs - enReconcileSentUs) <= 0) {
+            int32_t counter[MatrixR4_ENCODER_NUM];
+            WireUnpack(b, counter);
+            for (uint8_t i = 0; i < MatrixR4_ENCODER_NUM; i++) {
+                EncoderReconcile(i, counter[i]);
+            }
+            enCounterUs = micros();
+        }
     }
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
-    }
-
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if(b[0] == 0x08){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_Param_ERROR"));
-        return Drive_RESULT::ERROR_Drive_Param;		
-    }else if(b[0] == 0x09){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_IMU_Idle"));
-        return Drive_RESULT::ERROR_Drive_IMU_idle;		
-	}
-	
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+    if (enReconcileMs == 0 || (subscribed & (1 << (uint8_t)TELEMETRY::ENCODER)) == 0) return;
+    if ((uint32_t)(millis() - enReconcileAt) < enReconcileMs) return;
 
+    enReconcileAt     = millis();
+    enReconcileSentUs = micros();
+    enReconcileHandle = GetAllEncoderCounterAsync();
 }
 
-MMLower::RESULT MMLower::Set_Drive_MoveSync_PID(float Kp, float Ki, float Kd, uint8_t num)
+// One blocking round trip per interval: an async reply would only be stamped
+// when loop() next runs, which skews the receive time by the loop period.
+void MMLower::ClockSyncPump(void)
 {
-    uint8_t data[13];
-	BitConverter::FloatGetBytes(data, Kp);
-	BitConverter::FloatGetBytes(data+4, Ki);
-	BitConverter::FloatGetBytes(data+8, Kd);
-	data[12] = num - 1;
+    if (!stamped || clockSyncMs == 0) return;
+    if ((uint32_t)(millis() - clockSyncAt) < clockSyncMs) return;
 
-    CommSendData(COMM_CMD::SET_DC_TWO_MoveSync_PID, data, 13);
-    if (!WaitData(COMM_CMD::SET_DC_TWO_MoveSync_PID, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    SyncClock(1);
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+//--------------------------------------------------------------//
+//  Task completion  //
+//--------------------------------------------------------------//
+static_assert(MatrixR4_DRIVE_NUM <= MatrixR4_DC_MOTOR_NUM, "taskDoneUs is sized by the motors");
 
-    return RESULT::ERROR;
+/**
+ * @brief Called from loop() or WaitTaskDone() when a task ends, never while
+ * a command waits for its reply.
+ *
+ * The board pushes completions only with TELEMETRY::TASK subscribed,
+ * otherwise the callback fires from WaitTaskDone() alone.
+ */
+void MMLower::onTaskDone(TaskDoneCallback callback)
+{
+    taskCallback = callback;
 }
 
-MMLower::RESULT MMLower::Set_Drive_MoveGyro_PID(float Kp, float Ki, float Kd, uint8_t num)
+/**
+ * @brief Whether the last task of a motor / drive has ended.
+ *
+ * Answered from the pushed completions when TELEMETRY::TASK is subscribed,
+ * otherwise asked from the lower board (GET_ROTATE_STATE / GET_Task_Done_Status).
+ * A task whose start was not acknowledged is always asked.
+ */
+MMLower::RESULT MMLower::GetTaskState(TASK task, uint8_t num, bool& isDone)
 {
-    uint8_t data[13];
-	BitConverter::FloatGetBytes(data, Kp);
-	BitConverter::FloatGetBytes(data+4, Ki);
-	BitConverter::FloatGetBytes(data+8, Kd);
-	data[12] = num - 1;
-
-    CommSendData(COMM_CMD::SET_DC_TWO_MoveGyro_PID, data, 13);
-    if (!WaitData(COMM_CMD::SET_DC_TWO_MoveGyro_PID, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    if (!TaskValid(task, num)) return RESULT::ERROR;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
+    if ((subscribed & (1 << (uint8_t)TELEMETRY::TASK)) &&
+        !(taskUnsure[(uint8_t)task] & (1 << (num - 1)))) {
+        isDone = !(taskRunning[(uint8_t)task] & (1 << (num - 1)));
         return RESULT::OK;
     }
+    return QueryTaskState(task, num, isDone);
+}
 
-    return RESULT::ERROR;
-    return RESULT::ERROR;
+/**
+ * @brief Block until the last task of a motor / drive has ended.
+ *
+ * With TELEMETRY::TASK subscribed this returns as soon as the completion
+ * frame is parsed, and the lower board is asked every MatrixR4_TASK_CHECK_MS
+ * in case the frame was lost. Without it, or when the start of the task was
+ * not acknowledged, the board is asked every MatrixR4_TASK_POLL_MS. loop(),
+ * the MiniR4Scheduler tasks and the onIdle() callback keep running meanwhile.
+ *
+ * @param timeout_ms 0 waits for ever.
+ */
+MMLower::RESULT MMLower::WaitTaskDone(TASK task, uint8_t num, uint32_t timeout_ms)
+{
+    if (!TaskValid(task, num)) return RESULT::ERROR;
+
+    uint8_t  bit    = 1 << (num - 1);
+    uint32_t start  = millis();
+    uint32_t pollAt = start;   // a task just started is not asked about at once
+    while (true) {
+        bool     pushed = subscribed & (1 << (uint8_t)TELEMETRY::TASK);
+        uint32_t pollMs = MatrixR4_TASK_POLL_MS;
+        if (pushed && !(taskUnsure[(uint8_t)task] & bit)) {
+            if (!(taskRunning[(uint8_t)task] & bit)) {
+                FireCallbacks();
+                return RESULT::OK;
+            }
+            pollMs = MatrixR4_TASK_CHECK_MS;
+        }
+        if ((uint32_t)(millis() - pollAt) >= pollMs) {
+            pollAt = millis();
+            bool isDone;
+            if (QueryTaskState(task, num, isDone) == RESULT::OK && isDone) {
+                // A push parsed while the query waited has reported it already
+                if (!pushed || (taskRunning[(uint8_t)task] & bit)) {
+                    if (pushed) taskPolled[(uint8_t)task] |= bit;
+                    TaskDone(task, num, micros());
+                }
+                FireCallbacks();
+                return RESULT::OK;
+            }
+        }
+        if (timeout_ms > 0 && (uint32_t)(millis() - start) >= timeout_ms) {
+            return RESULT::ERROR_WAIT_TIMEOUT;
+        }
+        loop();
+        if (schedulerCallback != NULL) schedulerCallback();
+        if (idleCallback != NULL) idleCallback();
+        yield();
+    }
 }
 
-MMLower::RESULT MMLower::Set_Drive_MoveTurn_PID(float Kp, float Ki, float Kd, uint8_t num)
+// Ask the lower board, whatever is subscribed.
+MMLower::RESULT MMLower::QueryTaskState(TASK task, uint8_t num, bool& isDone)
 {
-    uint8_t data[13];
-	BitConverter::FloatGetBytes(data, Kp);
-	BitConverter::FloatGetBytes(data+4, Ki);
-	BitConverter::FloatGetBytes(data+8, Kd);
-	data[12] = num - 1;
-
-    CommSendData(COMM_CMD::SET_DC_TWO_TurnGyro_PID, data, 13);
-    if (!WaitData(COMM_CMD::SET_DC_TWO_TurnGyro_PID, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    if (task == TASK::ROTATE) return GetRotateState(num, isDone);
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return RESULT::ERROR_READ_TIMEOUT;
-    }
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return RESULT::OK;
-    }
+    bool         busy   = true;
+    Drive_RESULT result = Get_Drive_isTaskDone(num, &busy);
+    if (result != Drive_RESULT::OK) return RESULT::ERROR;
+    isDone = !busy;
+    return RESULT::OK;
+}
 
-    return RESULT::ERROR;
+/**
+ * @brief When the last task of a motor / drive ended, micros(), 0 while it
+ * runs or when none was seen. With timestamps on and the clock synced this
+ * is when the lower board finished it.
+ */
+uint32_t MMLower::GetTaskDoneUs(TASK task, uint8_t num)
+{
+    if (!TaskValid(task, num)) return 0;
+    return taskDoneUs[(uint8_t)task][num - 1];
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_Encode_PPR(uint8_t num, uint16_t* ppr)
+bool MMLower::TaskValid(TASK task, uint8_t num)
 {
-	MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_Encode_PPR]"));
-	
-    uint8_t data[12];
+    uint8_t count = (task == TASK::ROTATE) ? MatrixR4_DC_MOTOR_NUM : MatrixR4_DRIVE_NUM;
+    return (task <= TASK::DRIVE && num >= 1 && num <= count);
+}
 
-	BitConverter::GetBytes(data, (uint16_t)(ppr[0]));	
-	BitConverter::GetBytes(data + 2, (uint16_t)(ppr[1]));	
-	data[4] = num - 1;
-	
-    CommSendData(COMM_CMD::SET_DC_TWO_MOTOR_PPR, data, 5);
-    if (!WaitData(COMM_CMD::SET_DC_TWO_MOTOR_PPR, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
-    }
+// After a start command. Acknowledged: a completion of the task it replaced
+// was sent before that reply, so it cannot clear the new task. Timed out:
+// the board may or may not run it, WaitTaskDone() asks until it is done.
+// Refused: nothing started.
+void MMLower::TaskStarted(TASK task, uint8_t num, uint8_t result)
+{
+    if (!TaskValid(task, num)) return;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+    uint8_t bit = 1 << (num - 1);
+    if (result == (uint8_t)RESULT::OK) {
+        taskUnsure[(uint8_t)task] &= ~bit;
+    } else if (result == (uint8_t)RESULT::ERROR_WAIT_TIMEOUT ||
+               result == (uint8_t)RESULT::ERROR_READ_TIMEOUT) {
+        taskUnsure[(uint8_t)task] |= bit;
+    } else {
+        return;
     }
-	
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
-
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;	
+    taskRunning[(uint8_t)task] |= bit;
+    taskPolled[(uint8_t)task] &= ~bit;
+    taskDoneUs[(uint8_t)task][num - 1] = 0;
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_Motor_Type(uint8_t num, uint8_t type)
+void MMLower::TaskDone(TASK task, uint8_t num, uint32_t doneUs)
 {
-	MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_Motor_Type]"));
-	
-    uint8_t data[2];
+    if (!TaskValid(task, num)) return;
+    taskRunning[(uint8_t)task] &= ~(1 << (num - 1));
+    taskUnsure[(uint8_t)task] &= ~(1 << (num - 1));
+    taskDoneUs[(uint8_t)task][num - 1] = doneUs;
+    if (taskCallback != NULL) PushEvent(EVENT::TASK, num, (uint8_t)task, doneUs);
+}
 
-	data[0] = num - 1;
-	data[1] = type;
-	
-    CommSendData(COMM_CMD::SET_DC_MOTOR_TYPE, data, 2);
-    if (!WaitData(COMM_CMD::SET_DC_MOTOR_TYPE, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-		Serial.println(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
-    }
+//--------------------------------------------------------------//
+//  Async API  //
+//--------------------------------------------------------------//
+MMLower::AsyncHandle MMLower::SendAsync(
+    COMM_CMD cmd, uint8_t* data, uint16_t size, uint8_t replySize, AsyncCallback callback,
+    uint32_t timeout_ms)
+{
+    return AsyncIssue(cmd, data, size, replySize, NULL, callback, timeout_ms * 1000);
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
-    }
-	
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
+MMLower::AsyncHandle MMLower::SetDCMotorPowerAsync(uint8_t num, int16_t power, AsyncCallback callback)
+{
+    return CallAsync<COMM_CMD::SET_DC_MOTOR_POWER>(callback, (uint8_t)(1 << --num), (uint8_t)0, power);
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;		
+MMLower::AsyncHandle MMLower::SetDCMotorSpeedAsync(uint8_t num, int16_t speed, AsyncCallback callback)
+{
+    return CallAsync<COMM_CMD::SET_DC_MOTOR_SPEED>(callback, (uint8_t)(1 << --num), (uint8_t)0, speed);
 }
 
-/*********************************************************************
-*********************************************************************/
+MMLower::AsyncHandle MMLower::SetServoAngleAsync(uint8_t num, uint16_t angle, AsyncCallback callback)
+{
+    return CallAsync<COMM_CMD::SET_SERVO_ANGLE>(callback, (uint8_t)(1 << --num), angle);
+}
 
-MMLower::Drive_RESULT MMLower::Set_Drive_Move_Func(int16_t power_left, int16_t power_right, uint8_t num)
+MMLower::AsyncHandle MMLower::GetAllEncoderCounterAsync(AsyncCallback callback)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_MovePower]"));
+    return CallAsync<COMM_CMD::GET_ALL_ENCODER_COUNTER>(callback);
+}
 
-    uint8_t data[5];
-	
-    BitConverter::GetBytes(data + 0, power_left);
-	BitConverter::GetBytes(data + 2, power_right);
-	data[4] = num - 1;
-	
-    CommSendData(COMM_CMD::SET_Drive_Move, data, 5);
-    if (!WaitData(COMM_CMD::SET_Drive_Move, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
-    }
+MMLower::AsyncHandle MMLower::GetIMUEulerAsync(AsyncCallback callback)
+{
+    return CallAsync<COMM_CMD::GET_IMU_EULER>(callback);
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
-    }
+MMLower::AsyncHandle MMLower::GetIMUGyroAsync(AsyncCallback callback)
+{
+    return CallAsync<COMM_CMD::GET_IMU_GYRO>(callback);
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_POWER"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-	}else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
+MMLower::AsyncHandle MMLower::GetIMUAccAsync(AsyncCallback callback)
+{
+    return CallAsync<COMM_CMD::GET_IMU_ACC>(callback);
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+bool MMLower::isDone(AsyncHandle handle)
+{
+    if (handle < 0 || handle >= MatrixR4_ASYNC_SLOT_NUM) return true;
+    return (asyncSlots[handle].state != ASYNC_STATE::PENDING);
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_Move_Degs(int16_t power_left, int16_t power_right, uint16_t Degree_c, bool brake, bool async, uint8_t num)
+/**
+ * @brief Collect the result of an async command without a callback.
+ *
+ * Returns PENDING while the reply is outstanding. Once done, the reply is
+ * copied out (up to size bytes) and the slot is released.
+ */
+MMLower::RESULT MMLower::poll(AsyncHandle handle, uint8_t* reply, uint8_t size)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_MoveDegs]"));
+    if (handle < 0 || handle >= MatrixR4_ASYNC_SLOT_NUM) return RESULT::ERROR;
 
-    uint8_t data[9];
-	
-    BitConverter::GetBytes(data + 0, power_left);
-	BitConverter::GetBytes(data + 2, power_right);
-	BitConverter::GetBytes(data + 4, Degree_c);
-	data[6] = brake;
-	data[7] = async;
-	data[8] = num - 1;
-	
-    CommSendData(COMM_CMD::SET_Drive_MoveDegs, data, 9);
-    if (!WaitData(COMM_CMD::SET_Drive_MoveDegs, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
-    }
+    AsyncSlot_t& slot = asyncSlots[handle];
+    if (slot.state == ASYNC_STATE::PENDING) return RESULT::PENDING;
+    if (slot.state != ASYNC_STATE::DONE) return RESULT::ERROR;   // free, or the callback's
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+    if (reply != NULL) {
+        if (size > slot.replySize) size = slot.replySize;
+        memcpy(reply, slot.reply, size);
     }
-
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOVE_DEGS"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
-
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+    slot.state = ASYNC_STATE::FREE;
+    return slot.result;
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_Move_Time(int16_t power_left, int16_t power_right, uint32_t Time_mS, bool brake, bool async, uint8_t num)
+/**
+ * @brief Block until an async command completes, then collect it like poll().
+ */
+MMLower::RESULT MMLower::await(AsyncHandle handle, uint8_t* reply, uint8_t size)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_MoveTime]"));
+    if (handle < 0 || handle >= MatrixR4_ASYNC_SLOT_NUM) return RESULT::ERROR;
+    if (asyncSlots[handle].callback != NULL) return RESULT::ERROR;
 
-    uint8_t data[11];
-	
-    BitConverter::GetBytes(data + 0, power_left);
-	BitConverter::GetBytes(data + 2, power_right);
-	BitConverter::GetBytes(data + 4, Time_mS);
-	data[8] = brake;
-	data[9] = async;
-	data[10] = num -1;
-	
-    CommSendData(COMM_CMD::SET_Drive_MoveTime, data, 11);
-    if (!WaitData(COMM_CMD::SET_Drive_MoveTime, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+    while (!isDone(handle)) {
+        loop();
     }
+    return poll(handle, reply, size);
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
-    }
+//--------------------------------------------------------------//
+//  Batch API  //
+//--------------------------------------------------------------//
+bool MMLower::BatchDCMotorPower(uint8_t num, int16_t power)
+{
+    return BatchMotor(num, BATCH_OP::POWER, power);
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_TIME"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
+bool MMLower::BatchDCMotorSpeed(uint8_t num, int16_t speed)
+{
+    return BatchMotor(num, BATCH_OP::SPEED, speed);
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+bool MMLower::BatchDCBrake(uint8_t num)
+{
+    return BatchMotor(num, BATCH_OP::BRAKE, 0);
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_MoveSync_Func(int16_t power_left, int16_t power_right, uint8_t num)
+bool MMLower::BatchServoAngle(uint8_t num, uint16_t angle)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_Move_SyncPower]"));
+    if (num < 1 || num > MatrixR4_SERVO_NUM) return false;
+    batchServoSet[num - 1]   = true;
+    batchServoAngle[num - 1] = angle;
+    return true;
+}
 
-    uint8_t data[5];
-	
-    BitConverter::GetBytes(data + 0, power_left);
-	BitConverter::GetBytes(data + 2, power_right);
-	data[4] = num - 1;
-	
-    CommSendData(COMM_CMD::SET_Drive_MoveSync, data, 5);
-    if (!WaitData(COMM_CMD::SET_Drive_MoveSync, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+void MMLower::BatchClear(void)
+{
+    for (uint8_t i = 0; i < MatrixR4_DC_MOTOR_NUM; i++) {
+        batchMotorOp[i] = BATCH_OP::NONE;
     }
-
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+    for (uint8_t i = 0; i < MatrixR4_SERVO_NUM; i++) {
+        batchServoSet[i] = false;
     }
-
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_POWER"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
-
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_MoveSync_Degs(int16_t power_left, int16_t power_right, uint16_t Degree_c, bool brake, bool async, uint8_t num)
+bool MMLower::BatchIsEmpty(void)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveSync_Degs]"));
-
-    uint8_t data[9];
-	
-    BitConverter::GetBytes(data + 0, power_left);
-	BitConverter::GetBytes(data + 2, power_right);
-	BitConverter::GetBytes(data + 4, Degree_c);
-	data[6] = brake;
-	data[7] = async;
-	data[8] = num - 1;
-	
-    CommSendData(COMM_CMD::SET_Drive_MoveSyncDegs, data, 9);
-    if (!WaitData(COMM_CMD::SET_Drive_MoveSyncDegs, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+    for (uint8_t i = 0; i < MatrixR4_DC_MOTOR_NUM; i++) {
+        if (batchMotorOp[i] != BATCH_OP::NONE) return false;
+    }
+    for (uint8_t i = 0; i < MatrixR4_SERVO_NUM; i++) {
+        if (batchServoSet[i]) return false;
     }
+    return true;
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+/**
+ * @brief Send every queued actuator write in one SET_BATCH request.
+ *
+ * The lower board checks all values before it applies any, so either the
+ * whole batch takes effect or the failing port is returned. Firmware
+ * without SET_BATCH, and the legacy link, get the per-port commands back
+ * to back instead, see BatchPipeline().
+ *
+ * Writes leave the batch once the lower board took them: all of them when
+ * it answered SET_BATCH, each per-port write once it is sent. What was not
+ * taken stays queued for the next BatchFlush() and an error is returned.
+ */
+MMLower::RESULT MMLower::BatchFlush(void)
+{
+    MR4_DEBUG_PRINT_HEADER(F("[BatchFlush]"));
+
+    RESULT result = RESULT::OK;
+    if (BatchIsEmpty()) {
+        MR4_DEBUG_PRINT_TAIL((int)result);
+        return result;
+    }
+
+    // The legacy link cannot skip the payload of an opcode the firmware does
+    // not know, so SET_BATCH only goes out framed.
+    if (framed && batchProbe != PROBE::UNSUPPORTED) {
+        // Firmware without SET_BATCH does not answer and applies nothing,
+        // keep the first try short and send the batch the old way after.
+        bool probing = (batchProbe == PROBE::UNKNOWN);
+        bool answered;
+        result = BatchQuery(probing ? MatrixR4_PROBE_TIMEOUT_US : 0, answered);
+        if (answered) {
+            // Applied, or rejected as a whole: the same values would fail again
+            batchProbe = PROBE::SUPPORTED;
+            BatchClear();
+        }
+        if (!probing || result != RESULT::ERROR_WAIT_TIMEOUT) {
+            MR4_DEBUG_PRINT_TAIL((int)result);
+            return result;
+        }
+        batchProbe = PROBE::UNSUPPORTED;
     }
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOVE_DEGS"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
-
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+    result = BatchPipeline();
+    MR4_DEBUG_PRINT_TAIL((int)result);
+    return result;
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_MoveSync_Time(int16_t power_left, int16_t power_right, uint32_t Time_mS, bool brake, bool async, uint8_t num)
+MMLower::RESULT MMLower::BatchQuery(uint32_t timeoutUs, bool& answered)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveSync_Time]"));
+    // Two bits of BATCH_OP per motor, a bit per servo
+    typedef WireLayout<uint8_t, int16_t[MatrixR4_DC_MOTOR_NUM], uint8_t, uint16_t[MatrixR4_SERVO_NUM]>
+        Request_t;
+    constexpr const MMLowerCmdDesc_t& desc = FindCmd(COMM_CMD::SET_BATCH);
+    static_assert(Request_t::Size == desc.requestSize, "request does not match cmdTable");
 
-    uint8_t data[11];
-	
-    BitConverter::GetBytes(data + 0, power_left);
-	BitConverter::GetBytes(data + 2, power_right);
-	BitConverter::GetBytes(data + 4, Time_mS);
-	data[8] = brake;
-	data[9] = async;
-	data[10] = num -1;
-	
-    CommSendData(COMM_CMD::SET_Drive_MoveSyncTime, data, 11);
-    if (!WaitData(COMM_CMD::SET_Drive_MoveSyncTime, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+    // Ports left out carry 0, not what an earlier batch held for them
+    uint8_t  motorOps  = 0;
+    uint8_t  servoMask = 0;
+    int16_t  motorValue[MatrixR4_DC_MOTOR_NUM];
+    uint16_t servoAngle[MatrixR4_SERVO_NUM];
+    for (uint8_t i = 0; i < MatrixR4_DC_MOTOR_NUM; i++) {
+        motorOps |= (uint8_t)batchMotorOp[i] << (i * 2);
+        motorValue[i] = (batchMotorOp[i] == BATCH_OP::NONE) ? 0 : batchMotorValue[i];
     }
-
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+    for (uint8_t i = 0; i < MatrixR4_SERVO_NUM; i++) {
+        if (batchServoSet[i]) servoMask |= 1 << i;
+        servoAngle[i] = batchServoSet[i] ? batchServoAngle[i] : 0;
     }
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_TIME"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
+    answered = false;
+    uint8_t* p = TxBegin(desc.cmd, desc.requestSize);
+    if (p == NULL) return RESULT::ERROR;
+    Request_t::PackTo(p, motorOps, motorValue, servoMask, servoAngle);
+    TxEnd();
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+    uint8_t status[1];
+    RESULT  result = (RESULT)Transact(desc, status, timeoutUs);
+    answered = (result != RESULT::ERROR_WAIT_TIMEOUT && result != RESULT::ERROR_READ_TIMEOUT);
+    return result;
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_MoveGyro_Func(int16_t power, int16_t Target_dri, uint8_t num)
+/**
+ * @brief BatchFlush() without SET_BATCH: per-port commands back to back,
+ * then one wait for all ACKs.
+ *
+ * A full set of servo angles or motor brakes collapses into the matching
+ * SET_ALL_* command. The first failing result is returned.
+ */
+MMLower::RESULT MMLower::BatchPipeline(void)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveGyro]"));
+    AsyncHandle handles[MatrixR4_ASYNC_SLOT_NUM];
+    uint8_t     count  = 0;
+    RESULT      result = RESULT::OK;
+    bool        sent   = true;
 
-    uint8_t data[5];
-	
-    BitConverter::GetBytes(data + 0, power);
-	BitConverter::GetBytes(data + 2, Target_dri);
-	data[4] = num - 1;
-	
-    CommSendData(COMM_CMD::SET_Drive_Gyro, data, 5);
-    if (!WaitData(COMM_CMD::SET_Drive_Gyro, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+    bool allBrake = true;
+    for (uint8_t i = 0; i < MatrixR4_DC_MOTOR_NUM; i++) {
+        if (batchMotorOp[i] != BATCH_OP::BRAKE) allBrake = false;
+    }
+    if (allBrake) {
+        sent = PipelineCall<COMM_CMD::SET_ALL_DC_BRAKE>(handles, count, result, (uint8_t)1);
+        for (uint8_t i = 0; sent && i < MatrixR4_DC_MOTOR_NUM; i++) {
+            batchMotorOp[i] = BATCH_OP::NONE;
+        }
+    } else {
+        for (uint8_t i = 0; sent && i < MatrixR4_DC_MOTOR_NUM; i++) {
+            uint8_t mask = 1 << i;
+            switch (batchMotorOp[i]) {
+            case BATCH_OP::POWER:
+                sent = PipelineCall<COMM_CMD::SET_DC_MOTOR_POWER>(
+                    handles, count, result, mask, (uint8_t)0, batchMotorValue[i]);
+                break;
+            case BATCH_OP::SPEED:
+                sent = PipelineCall<COMM_CMD::SET_DC_MOTOR_SPEED>(
+                    handles, count, result, mask, (uint8_t)0, batchMotorValue[i]);
+                break;
+            case BATCH_OP::BRAKE:
+                sent = PipelineCall<COMM_CMD::SET_DC_BRAKE>(handles, count, result, mask);
+                break;
+            default: break;
+            }
+            if (sent) batchMotorOp[i] = BATCH_OP::NONE;
+        }
     }
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+    bool allServo = true;
+    for (uint8_t i = 0; i < MatrixR4_SERVO_NUM; i++) {
+        if (!batchServoSet[i]) allServo = false;
+    }
+    if (sent && allServo) {
+        sent = PipelineCall<COMM_CMD::SET_ALL_SERVO_ANGLE>(
+            handles, count, result,
+            batchServoAngle[0], batchServoAngle[1], batchServoAngle[2], batchServoAngle[3]);
+        for (uint8_t i = 0; sent && i < MatrixR4_SERVO_NUM; i++) {
+            batchServoSet[i] = false;
+        }
+    } else {
+        for (uint8_t i = 0; sent && i < MatrixR4_SERVO_NUM; i++) {
+            if (!batchServoSet[i]) continue;
+            sent = PipelineCall<COMM_CMD::SET_SERVO_ANGLE>(
+                handles, count, result, (uint8_t)(1 << i), batchServoAngle[i]);
+            if (sent) batchServoSet[i] = false;
+        }
     }
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_POWER"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
+    PipelineAwait(handles, count, result);
+    return sent ? result : RESULT::ERROR;
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+bool MMLower::BatchMotor(uint8_t num, BATCH_OP op, int16_t value)
+{
+    if (num < 1 || num > MatrixR4_DC_MOTOR_NUM) return false;
+    batchMotorOp[num - 1]    = op;
+    batchMotorValue[num - 1] = value;
+    return true;
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_MoveGyro_Degs(int16_t power, int16_t Target_dri, uint16_t Degree_c, bool brake, bool async, uint8_t num)
+MMLower::AsyncHandle MMLower::AsyncIssue(
+    COMM_CMD cmd, uint8_t* data, uint16_t size, uint8_t replySize, const MMLowerCmdDesc_t* desc,
+    AsyncCallback callback, uint32_t timeoutUs)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveGyro_Degs]"));
+    AsyncHandle handle = AsyncClaim(cmd, replySize, desc, callback, timeoutUs);
+    if (handle < 0) return -1;
 
-    uint8_t data[9];
-	
-    BitConverter::GetBytes(data + 0, power);
-	BitConverter::GetBytes(data + 2, Target_dri);
-	BitConverter::GetBytes(data + 4, Degree_c);
-	data[6] = brake;
-	data[7] = async;
-	data[8] = num - 1;
-	
-    CommSendData(COMM_CMD::SET_Drive_GyroDegs, data, 9);
-    if (!WaitData(COMM_CMD::SET_Drive_GyroDegs, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+    if (!CommSendData(cmd, data, size)) {
+        asyncSlots[handle].state = ASYNC_STATE::FREE;
+        return -1;
     }
+    asyncSlots[handle].seq = txSeq;
+    return handle;
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+// Whether AsyncClaim() would find a slot
+bool MMLower::AsyncSlotFree(void)
+{
+    for (uint8_t i = 0; i < MatrixR4_ASYNC_SLOT_NUM; i++) {
+        if (asyncSlots[i].state == ASYNC_STATE::FREE) return true;
     }
-
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOVE_DEGS"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
-
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+    return false;
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_MoveGyro_Time(int16_t power, int16_t Target_dri, uint32_t Time_mS, bool brake, bool async, uint8_t num)
+// Reserve a slot before the request is queued, the caller sets slot.seq after TxEnd().
+MMLower::AsyncHandle MMLower::AsyncClaim(
+    COMM_CMD cmd, uint8_t replySize, const MMLowerCmdDesc_t* desc, AsyncCallback callback,
+    uint32_t timeoutUs)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveGyro_Time]"));
+    if (replySize > MatrixR4_ASYNC_REPLY_SIZE) return -1;
 
-    uint8_t data[11];
-	
-    BitConverter::GetBytes(data + 0, power);
-	BitConverter::GetBytes(data + 2, Target_dri);
-	BitConverter::GetBytes(data + 4, Time_mS);
-	data[8] = brake;
-	data[9] = async;
-	data[10] = num -1;
-	
-    CommSendData(COMM_CMD::SET_Drive_GyroTime, data, 11);
-    if (!WaitData(COMM_CMD::SET_Drive_GyroTime, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+    for (uint8_t i = 0; i < MatrixR4_ASYNC_SLOT_NUM; i++) {
+        AsyncSlot_t& slot = asyncSlots[i];
+        if (slot.state != ASYNC_STATE::FREE) continue;
+
+        slot.state     = ASYNC_STATE::PENDING;
+        slot.cmd       = cmd;
+        slot.desc      = desc;
+        slot.replySize = replySize;
+        slot.result    = RESULT::PENDING;
+        slot.order     = asyncOrder++;
+        slot.startUs   = micros();
+        slot.timeoutUs = timeoutUs;
+        slot.callback  = callback;
+        return i;
     }
+    MR4_DEBUG_PRINTLN(F("Async slots full"));
+    return -1;
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+// Replies arrive in request order, so the oldest pending slot owns the reply.
+int8_t MMLower::FindAsyncSlot(uint8_t cmd)
+{
+    int8_t found = -1;
+    for (uint8_t i = 0; i < MatrixR4_ASYNC_SLOT_NUM; i++) {
+        AsyncSlot_t& slot = asyncSlots[i];
+        if (slot.state != ASYNC_STATE::PENDING || (uint8_t)slot.cmd != cmd) continue;
+        if (framed && slot.seq != rxSeq) continue;
+        if (found < 0 || (int16_t)(slot.order - asyncSlots[found].order) < 0) found = i;
     }
+    return found;
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_TIME"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
+bool MMLower::HandleAsyncReply(uint8_t cmd)
+{
+    int8_t idx = FindAsyncSlot(cmd);
+    if (idx < 0) return false;
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+    AsyncSlot_t& slot = asyncSlots[idx];
+    if (!CommReadData(slot.reply, slot.replySize)) {
+        CompleteAsync(idx, RESULT::ERROR_READ_TIMEOUT);
+    } else if (slot.desc != NULL && slot.desc->hasStatus) {
+        CompleteAsync(idx, (RESULT)MapStatus(*slot.desc, slot.reply[0]));
+    } else {
+        CompleteAsync(idx, RESULT::OK);
+    }
+    return true;
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_TurnGyro(int16_t power, int16_t Target_dri, uint8_t mode, bool brake, bool async, uint8_t num)
+void MMLower::CompleteAsync(AsyncHandle handle, RESULT result)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SET_Drive_MoveGyro_Time]"));
+    AsyncSlot_t& slot = asyncSlots[handle];
+    slot.result       = result;
+    slot.state        = ASYNC_STATE::DONE;
+    uint32_t     now  = micros();
+    if (slot.desc != NULL) {
+        uint32_t latency = now - slot.startUs;
+        CountCall(*slot.desc, (uint8_t)result, latency);
+        RtoUpdate(*slot.desc, (uint8_t)result, latency);
+    }
+    RtoRestartAsync(now);
+    if (slot.callback != NULL) slot.state = ASYNC_STATE::NOTIFY;
+}
 
-    uint8_t data[10];
-	
-    BitConverter::GetBytes(data + 0, power);
-	BitConverter::GetBytes(data + 2, Target_dri);
-	data[4] = mode;
-	data[5] = brake;
-	data[6] = async;
-	data[7] = num -1;
-	
-    CommSendData(COMM_CMD::SET_Drive_Turn, data, 8);
-    if (!WaitData(COMM_CMD::SET_Drive_Turn, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+// Queue a button / task callback for FireCallbacks(). A full queue drops it.
+void MMLower::PushEvent(EVENT kind, uint8_t num, uint8_t value, uint32_t us)
+{
+    if (eventCount >= MatrixR4_EVENT_QUEUE_SIZE) {
+        MR4_DEBUG_PRINTLN(F("Event queue full"));
+        return;
     }
+    Event_t& ev = events[(eventHead + eventCount++) % MatrixR4_EVENT_QUEUE_SIZE];
+    ev.kind     = kind;
+    ev.num      = num;
+    ev.value    = value;
+    ev.us       = us;
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+/**
+ * @brief Run the callbacks of everything completed since the last call.
+ *
+ * Never while a command waits for its reply: a callback that sends its
+ * own command would take over the reply, sequence number and payload of
+ * the waiting one. Callbacks queued by a callback run in the same call.
+ */
+void MMLower::FireCallbacks(void)
+{
+    if (firing || rxWaitCmd != COMM_CMD::NONE) return;
+    firing = true;
+
+    while (true) {
+        // Async completions in request order
+        int8_t next = -1;
+        for (uint8_t i = 0; i < MatrixR4_ASYNC_SLOT_NUM; i++) {
+            if (asyncSlots[i].state != ASYNC_STATE::NOTIFY) continue;
+            if (next < 0 || (int16_t)(asyncSlots[i].order - asyncSlots[next].order) < 0) next = i;
+        }
+        if (next >= 0) {
+            AsyncSlot_t& slot = asyncSlots[next];
+            slot.callback(next, slot.result, slot.reply, slot.replySize);
+            slot.state = ASYNC_STATE::FREE;
+            continue;
+        }
+        if (eventCount > 0) {
+            Event_t ev = events[eventHead];
+            eventHead  = (eventHead + 1) % MatrixR4_EVENT_QUEUE_SIZE;
+            eventCount--;
+            if (ev.kind == EVENT::BUTTON && callbackFunc != NULL) {
+                callbackFunc(ev.num, (BTN_STATE)ev.value);
+            } else if (ev.kind == EVENT::TASK && taskCallback != NULL) {
+                taskCallback((TASK)ev.value, ev.num, ev.us);
+            }
+            continue;
+        }
+        if (imuPending) {
+            imuPending = false;
+            if (imuCallback != NULL) imuCallback();
+            continue;
+        }
+        break;
     }
+    firing = false;
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_TIME"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
+//--------------------------------------------------------------//
+//  Link statistics  //
+//--------------------------------------------------------------//
+void MMLower::CountCall(const MMLowerCmdDesc_t& desc, uint8_t result, uint32_t latencyUs)
+{
+#if MR4_LINK_STATS_ENABLE
+    uint8_t     idx  = &desc - cmdTable;
+    uint8_t     bit  = 1 << (idx & 7);
+    CmdStats_t& st   = cmdStats[idx];
+    bool        fail = (result == (uint8_t)RESULT::ERROR_WAIT_TIMEOUT ||
+                 result == (uint8_t)RESULT::ERROR_READ_TIMEOUT);
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;	
+    st.calls++;
+    if (cmdFailed[idx >> 3] & bit) st.retries++;
+    if (result == (uint8_t)RESULT::ERROR_WAIT_TIMEOUT) st.timeouts++;
+    if (result == (uint8_t)RESULT::ERROR_READ_TIMEOUT) st.readTimeouts++;
+    if (fail) {
+        cmdFailed[idx >> 3] |= bit;
+    } else {
+        cmdFailed[idx >> 3] &= ~bit;
+        st.latencyUsSum += latencyUs;
+        if (latencyUs > st.latencyUsMax) st.latencyUsMax = latencyUs;
+    }
+#endif
 }
 
-//=========================================//
-//=========================================//
-//=========================================//
+void MMLower::GetLinkStats(LinkStats_t& stats)
+{
+    stats = linkStats;
+}
 
+/**
+ * @brief Counters of one command, all zero when MR4_LINK_STATS_ENABLE is off.
+ *
+ * @return false for a command MMLower does not know.
+ */
+bool MMLower::GetCmdStats(COMM_CMD cmd, CmdStats_t& stats)
+{
+    memset(&stats, 0, sizeof(stats));
+    int8_t idx = LookupCmd((uint8_t)cmd);
+    if (idx < 0) return false;
+#if MR4_LINK_STATS_ENABLE
+    stats = cmdStats[idx];
+#endif
+    return true;
+}
 
-MMLower::Drive_RESULT MMLower::Get_Drive_isTaskDone(uint8_t num, bool * isEnd)
+void MMLower::ResetLinkStats(void)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[GET_Task_Done_Status]"));
+    memset(&linkStats, 0, sizeof(linkStats));
+#if MR4_LINK_STATS_ENABLE
+    memset(cmdStats, 0, sizeof(cmdStats));
+    memset(cmdFailed, 0, sizeof(cmdFailed));
+#endif
+}
 
-    uint8_t data[2];
-	data[0] = 1;
-	data[1] = num -1;
-	
-    CommSendData(COMM_CMD::GET_Task_Done_Status, data, 2);
-    if (!WaitData(COMM_CMD::GET_Task_Done_Status, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
-    }
+/**
+ * @brief One line of link totals, then one line per command that was used:
+ * opcode, calls, timeouts, read timeouts, retries, average and max latency µs.
+ */
+void MMLower::PrintLinkStats(Print& out)
+{
+    out.print(F("tx="));
+    out.print(linkStats.txFrames);
+    out.print(F(" rx="));
+    out.print(linkStats.rxFrames);
+    out.print(F(" flush="));
+    out.print(linkStats.flushedBytes);
+    out.print(F(" crc="));
+    out.print(linkStats.crcErrors);
+    out.print(F(" unk="));
+    out.print(linkStats.unknownCmds);
+    out.print(F(" late="));
+    out.print(linkStats.lateReplies);
+    out.print(F(" stall="));
+    out.println(linkStats.txStalls);
+
+#if MR4_LINK_STATS_ENABLE
+    for (uint8_t i = 0; i < MatrixR4_CMD_NUM; i++) {
+        const CmdStats_t& st = cmdStats[i];
+        if (st.calls == 0) continue;
+        uint32_t replies = st.calls - st.timeouts - st.readTimeouts;
+        out.print(F("0x"));
+        if ((uint8_t)cmdTable[i].cmd < 0x10) out.print('0');
+        out.print((uint8_t)cmdTable[i].cmd, HEX);
+        out.print(F(" n="));
+        out.print(st.calls);
+        out.print(F(" to="));
+        out.print(st.timeouts);
+        out.print(F(" rto="));
+        out.print(st.readTimeouts);
+        out.print(F(" rt="));
+        out.print(st.retries);
+        out.print(F(" avg="));
+        out.print(replies ? st.latencyUsSum / replies : 0);
+        out.print(F(" max="));
+        out.print(st.latencyUsMax);
+        out.print(F(" tmo="));
+        out.println(RtoUs(cmdTable[i]));
+    }
+#endif
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+//--------------------------------------------------------------//
+//  Adaptive timeouts  //
+//--------------------------------------------------------------//
+/**
+ * @brief Reply timeout of a command: smoothed RTT + 4 x RTT variance,
+ * doubled per timeout in a row, between MR4_RTO_MIN_US and the cmdTable
+ * timeout. The cmdTable timeout until the first reply was measured.
+ */
+uint32_t MMLower::RtoUs(const MMLowerCmdDesc_t& desc)
+{
+    uint32_t ceiling = (uint32_t)desc.timeout_ms * 1000;
+#if MR4_ADAPTIVE_TIMEOUT_ENABLE
+    const RttEst_t& est = rttEst[&desc - cmdTable];
+    if (est.srtt == 0) return ceiling;
+
+    uint32_t rto = ((uint32_t)est.srtt + 4 * (uint32_t)est.rttvar) * MatrixR4_RTO_UNIT_US;
+    if (rto < MR4_RTO_MIN_US) rto = MR4_RTO_MIN_US;
+    rto <<= est.backoff;
+    return (rto < ceiling) ? rto : ceiling;
+#else
+    return ceiling;
+#endif
+}
+
+void MMLower::RtoUpdate(const MMLowerCmdDesc_t& desc, uint8_t result, uint32_t latencyUs)
+{
+#if MR4_ADAPTIVE_TIMEOUT_ENABLE
+    RttEst_t& est = rttEst[&desc - cmdTable];
+    if (result == (uint8_t)RESULT::ERROR_WAIT_TIMEOUT) {
+        if (est.backoff < MatrixR4_RTO_BACKOFF_MAX) est.backoff++;
+        return;
+    }
+    // A legacy reply after a timeout may be the late answer to the lost
+    // request, it says nothing about the round trip (Karn's algorithm).
+    // Framed replies are matched by sequence number and always count.
+    bool ambiguous = !framed && est.backoff > 0;
+    est.backoff    = 0;
+    if (ambiguous) return;
+
+    uint32_t ceiling = (uint32_t)desc.timeout_ms * 1000;
+    int32_t  rtt     = ((latencyUs < ceiling) ? latencyUs : ceiling) / MatrixR4_RTO_UNIT_US;
+    if (rtt == 0) rtt = 1;
+    if (est.srtt == 0) {
+        est.srtt   = rtt;
+        est.rttvar = rtt / 2;
+    } else {
+        int32_t err = rtt - est.srtt;
+        est.srtt    = est.srtt + err / 8;
+        est.rttvar  = est.rttvar + (((err < 0) ? -err : err) - est.rttvar) / 4;
+        if (est.srtt == 0) est.srtt = 1;
+    }
+#endif
+}
+
+/**
+ * @brief Restart the clock of every pending async request.
+ *
+ * The lower board answers in order, so a request queued behind others
+ * waits for them before its own round trip starts. Counted from when it
+ * was queued, the tail of a burst would time out after one RTO, and its
+ * reply would feed the queueing time into the RTT estimate. Counted from
+ * the reply (or timeout) of the request ahead, each slot gets one RTO
+ * and one RTT sample of its own.
+ */
+void MMLower::RtoRestartAsync(uint32_t now)
+{
+    for (uint8_t i = 0; i < MatrixR4_ASYNC_SLOT_NUM; i++) {
+        if (asyncSlots[i].state == ASYNC_STATE::PENDING) asyncSlots[i].startUs = now;
     }
-	
-	if(b[0] == 0x01){
-		isEnd[0] = false;
-	}else if(b[0] == 0x02){
-		isEnd[0] = true;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
-    
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return Drive_RESULT::OK;
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_Brake(bool brake, uint8_t num)
+void MMLower::RtoReset(void)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[Set_Drive_Brake]"));
+#if MR4_ADAPTIVE_TIMEOUT_ENABLE
+    memset(rttEst, 0, sizeof(rttEst));
+#endif
+}
 
-    uint8_t data[3];
+/**
+ * @brief Current reply timeout of a command in µs, 0 for an unknown command.
+ */
+uint32_t MMLower::GetTimeoutUs(COMM_CMD cmd)
+{
+    int8_t idx = LookupCmd((uint8_t)cmd);
+    return (idx < 0) ? 0 : RtoUs(cmdTable[idx]);
+}
 
-	data[0] = brake;
-	data[1] = num -1;
-	
-    CommSendData(COMM_CMD::SET_Drive_Brake, data, 2);
-    if (!WaitData(COMM_CMD::SET_Drive_Brake, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+void MMLower::ExpireAsync(void)
+{
+    uint32_t now = micros();
+    for (uint8_t i = 0; i < MatrixR4_ASYNC_SLOT_NUM; i++) {
+        AsyncSlot_t& slot = asyncSlots[i];
+        if (slot.state != ASYNC_STATE::PENDING) continue;
+        if (now - slot.startUs > slot.timeoutUs) {
+            MR4_DEBUG_PRINTLN(F("Async timeout"));
+            CompleteAsync(i, RESULT::ERROR_WAIT_TIMEOUT);
+        }
     }
+}
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
-    }
+/**
+ * @brief Pump the link: parse incoming frames, complete async commands
+ * and fire auto-send handlers. Call it from the sketch loop.
+ */
+void MMLower::loop(void)
+{
+    TxPump();
+    RxPump();
+    ExpireAsync();
+    EncoderReconcilePump();
+    ClockSyncPump();
+    FireCallbacks();
+}
 
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_TIME"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
+void MMLower::onBtnChg(BtnChgCallback callback)
+{
+    callbackFunc = callback;
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+/**
+ * @brief Queue a frame from a caller owned buffer (one copy into the TX ring).
+ */
+bool MMLower::CommSendData(COMM_CMD cmd, uint8_t* data, uint16_t size)
+{
+    uint8_t* p = TxBegin(cmd, size);
+    if (p == NULL) return false;
+    if (size > 0) memcpy(p, data, size);
+    TxEnd();
+    return true;
 }
 
-MMLower::Drive_RESULT MMLower::Set_Drive_Reset_Count(uint8_t num, bool reset)
+bool MMLower::CommSendData(COMM_CMD cmd, uint8_t data)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[SET_DC_TWO_MOTOR_Reset_count]"));
+    return CommSendData(cmd, &data, 1);
+}
 
-    uint8_t data[3];
+static_assert(MatrixR4_TX_BUF_SIZE >= MatrixR4_FRAME_SIZE_MAX, "TX ring cannot hold a full frame");
 
-	data[0] = (uint8_t)reset;
-	data[1] = num -1;
-	
-    CommSendData(COMM_CMD::SET_DC_TWO_MOTOR_Reset_count, data, 2);
-    if (!WaitData(COMM_CMD::SET_DC_TWO_MOTOR_Reset_count, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
-    }
+/**
+ * @brief Reserve a frame in the TX ring and write its header in place.
+ *
+ * The payload is serialized straight into the returned pointer, TxEnd()
+ * then adds the CRC (framed link) and hands the frame to TxPump().
+ *
+ * @return Payload pointer, NULL when the ring did not drain in time.
+ */
+uint8_t* MMLower::TxBegin(COMM_CMD cmd, uint16_t size)
+{
+    uint16_t header = framed ? MatrixR4_FRAME_HEADER_SIZE : 3;
+    uint16_t total  = header + size + (framed ? MatrixR4_FRAME_CRC_SIZE : 0);
+    if (size > MatrixR4_FRAME_PAYLOAD_MAX || !TxReserve(total)) return NULL;
 
-    uint8_t b[1];
-    if (!CommReadData(b, 1)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+    uint8_t* frame = txBuf + txHead;
+    frame[0]       = MatrixR4_COMM_LEAD;
+    frame[1]       = ((~MatrixR4_COMM_LEAD) & 0xFF);
+    frame[2]       = (uint8_t)cmd;
+    if (framed) {
+        frame[3] = ++txSeq;
+        frame[4] = (uint8_t)size;
     }
-
-    if (b[0] == 0x00) {
-        MR4_DEBUG_PRINT_TAIL(F("OK"));
-        return Drive_RESULT::OK;
-    }else if (b[0] == 0x02) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_MOTOR_TIME"));
-        return Drive_RESULT::ERROR_MOTOR_POWER;
-    }else if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}
-
-    MR4_DEBUG_PRINT_TAIL(F("ERROR"));
-    return Drive_RESULT::ERROR;
+    txFrameSize = total;
+    return frame + header;
 }
 
-MMLower::Drive_RESULT MMLower::Get_Drive_EncoderCounter(uint8_t num, int32_t& enCounter)
+void MMLower::TxEnd(void)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[Get_Drive_EncoderCounter]"));
-	
-	uint8_t data[2];
-	data[0] = num - 1;
+    if (framed) {
+        uint8_t* frame = txBuf + txHead;
+        uint8_t  len   = frame[4];
+        uint16_t crc   = CRC16::Calc(frame + 2, 3 + len);
+        WireField<uint16_t>::Store(frame + MatrixR4_FRAME_HEADER_SIZE + len, crc);
+    }
+    if (capture != NULL) capture->Record(false, framed, txBuf + txHead, txFrameSize);
+    txHead += txFrameSize;
+    linkStats.txFrames++;
+    TxPump();
+}
 
-	CommSendData(COMM_CMD::GET_Drive_Counter, data, 1);
-    if (!WaitData(COMM_CMD::GET_Drive_Counter, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+/**
+ * @brief Make room for size contiguous bytes at txHead.
+ *
+ * A frame never straddles the end of the ring: when the tail end is too
+ * short the writer wraps to the start and txWrap marks where the data stops.
+ */
+bool MMLower::TxReserve(uint16_t size)
+{
+    uint32_t timeout = millis() + MatrixR4_TX_TIMEOUT_MS;
+    while (true) {
+        TxPump();
+        if (txHead == txTail) {
+            txHead = txTail = 0;
+            txWrap          = MatrixR4_TX_BUF_SIZE;
+        }
+        if (txHead >= txTail) {
+            if (MatrixR4_TX_BUF_SIZE - txHead >= size) return true;
+            if (txTail > size) {
+                txWrap = txHead;
+                txHead = 0;
+                return true;
+            }
+        } else if (txTail - txHead > size) {
+            return true;
+        }
+        if ((int32_t)(millis() - timeout) > 0) {
+            MR4_DEBUG_PRINTLN(F("TX ring full"));
+            linkStats.txStalls++;
+            return false;
+        }
     }
+}
 
-    uint8_t b[4];
-    if (!CommReadData(b, 4)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+/**
+ * @brief Hand queued bytes to the transport, as many as it takes right now.
+ *
+ * Never waits for the bytes to leave the wire. Called after every frame and
+ * from the receive loops, so a transport that accepts partial writes keeps
+ * draining while MMLower waits for the reply.
+ */
+void MMLower::TxPump(void)
+{
+    while (txTail != txHead) {
+        if (txHead < txTail && txTail == txWrap) {
+            txTail = 0;
+            txWrap = MatrixR4_TX_BUF_SIZE;
+            continue;
+        }
+        uint16_t end = (txHead > txTail) ? txHead : txWrap;
+        size_t   n   = commSerial->write(txBuf + txTail, end - txTail);
+        if (n == 0) return;
+        txTail += n;
     }
-	
-    if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}	
-	
-    enCounter = BitConverter::ToInt32(b, 0);
+}
 
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return Drive_RESULT::OK;
+/**
+ * @brief Read the next bytes of the frame being handled.
+ *
+ * The decoder only hands out complete frames, so this never touches the
+ * stream and never waits.
+ */
+bool MMLower::CommReadData(uint8_t* data, uint16_t size)
+{
+    if (rxPos + size > rxLen) return false;
+    memcpy(data, rxPayload + rxPos, size);
+    rxPos += size;
+    return true;
 }
 
-MMLower::Drive_RESULT MMLower::Get_Drive_Degrees(uint8_t num, int32_t& Degs)
+/**
+ * @brief Wait for the reply to the latest request.
+ *
+ * Frames decoded meanwhile (auto-send, async replies) are dispatched as they
+ * complete. The matching reply is left in rxPayload for CommReadData().
+ *
+ * @param replySize Reply payload size, the legacy protocol has no length field.
+ */
+bool MMLower::WaitData(COMM_CMD cmd, uint8_t replySize, uint32_t timeoutUs)
 {
-    MR4_DEBUG_PRINT_HEADER(F("[Get_Drive_Degrees]"));
+    rxWaitCmd  = cmd;
+    rxWaitSize = replySize;
 
-	uint8_t data[2];
-	data[0] = num - 1;
+    uint32_t start = micros();
+    do {
+        TxPump();
+        if (RxPump()) return true;
+        yield();
+    } while (micros() - start <= timeoutUs);
 
-	CommSendData(COMM_CMD::GET_Drive_Degress, data, 1);
-    if (!WaitData(COMM_CMD::GET_Drive_Degress, 100)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_WAIT_TIMEOUT"));
-        return Drive_RESULT::ERROR_WAIT_TIMEOUT;
+    rxWaitCmd = COMM_CMD::NONE;
+    if (rxState != COMM_STATE::WAIT_LEAD) {
+        // A truncated legacy reply, the next one must start from its lead byte
+        if (rxState == COMM_STATE::WAIT_PAYLOAD) linkStats.flushedBytes += 3 + rxLen;
+        rxState = COMM_STATE::WAIT_LEAD;
+        rxLen   = 0;
     }
+    return false;
+}
 
-    uint8_t b[4];
-    if (!CommReadData(b, 4)) {
-        MR4_DEBUG_PRINT_TAIL(F("ERROR_READ_TIMEOUT"));
-        return Drive_RESULT::ERROR_READ_TIMEOUT;
+/**
+ * @brief Feed every byte the transport has buffered to the frame decoder.
+ *
+ * Each byte is read once. Stops right after the reply a WaitData() caller
+ * waits for, the bytes behind it stay in the transport until the next call.
+ *
+ * @return true when the awaited reply was decoded.
+ */
+bool MMLower::RxPump(void)
+{
+    while (true) {
+        // A framed burst may hold several frames, drain rxRaw before reading more.
+        bool frame = framed && FrameParse();
+        if (!frame) {
+            if (commSerial->available() <= 0) return false;
+            uint8_t b = commSerial->read();
+            if (capture != NULL) capture->Stage(b, framed);
+            frame = framed ? FrameFeed(b) : LegacyFeed(b);
+            if (!frame) continue;
+        }
+        if (capture != NULL) capture->Commit(framed);
+        linkStats.rxFrames++;
+        if (RxDispatch()) return true;
     }
-	
-    if(b[0] == 0x07){
-        MR4_DEBUG_PRINT_TAIL(F("Drive_No Defined"));
-        return Drive_RESULT::ERROR_Drive_Define;		
-	}	
-	
-    Degs = BitConverter::ToInt32(b, 0);
-
-    MR4_DEBUG_PRINT_TAIL(F("OK"));
-    return Drive_RESULT::OK;
 }
 
-
-
-//--------------------------------------------------------------//
-//--------------------------------------------------------------//
-
-
-void MMLower::loop(void)
+bool MMLower::RxDispatch(void)
 {
-    WaitData(COMM_CMD::NONE);
+    if (rxWaitCmd != COMM_CMD::NONE && rxCmd == (uint8_t)rxWaitCmd) {
+        // Framed: only the reply to the latest request matches, stale replies fall through.
+        // Legacy: an older async request of the same command owns this reply.
+        if (framed ? (rxSeq == txSeq) : (FindAsyncSlot(rxCmd) < 0)) {
+            rxWaitCmd = COMM_CMD::NONE;
+            return true;
+        }
+    }
+    HandleCommand(rxCmd);
+    return false;
 }
 
-void MMLower::onBtnChg(BtnChgCallback callback)
+// Payload size of a message the lower board sends unasked, -1 for others.
+static int16_t PushSize(uint8_t cmd)
 {
-    callbackFunc = callback;
+    switch (cmd) {
+    case (uint8_t)MMLower::COMM_CMD::AUTO_SEND_BUTTON_STATE: return 2;
+    case (uint8_t)MMLower::COMM_CMD::AUTO_SEND_ENCODER_COUNTER: return 8;
+    case (uint8_t)MMLower::COMM_CMD::AUTO_SEND_IMU_EULER:
+    case (uint8_t)MMLower::COMM_CMD::AUTO_SEND_IMU_GYRO:
+    case (uint8_t)MMLower::COMM_CMD::AUTO_SEND_IMU_ACC: return 6;
+    case (uint8_t)MMLower::COMM_CMD::AUTO_SEND_TASK_DONE: return 2;
+    default: return -1;
+    }
 }
 
-void MMLower::CommSendData(COMM_CMD cmd, uint8_t* data, uint16_t size)
+/**
+ * @brief Payload size of a legacy frame, known only from who expects it.
+ *
+ * @return -1 for a command nobody waits for, the decoder then resyncs.
+ */
+int16_t MMLower::LegacyReplySize(uint8_t cmd)
 {
-    uint8_t  arr[3 + size];
-    uint8_t* ptr = arr;
+    int8_t idx = FindAsyncSlot(cmd);
+    if (idx >= 0) return asyncSlots[idx].replySize;
+    if (rxWaitCmd != COMM_CMD::NONE && cmd == (uint8_t)rxWaitCmd) return rxWaitSize;
+
+    return PushSize(cmd);
+}
+
+/**
+ * @brief Incremental decoder of the legacy (unframed) protocol.
+ *
+ * @return true when a frame was decoded into rxCmd/rxPayload.
+ */
+bool MMLower::LegacyFeed(uint8_t b)
+{
+    switch (rxState) {
+    case COMM_STATE::WAIT_LEAD:
+        if (b == MatrixR4_COMM_LEAD)
+            rxState = COMM_STATE::WAIT_NOT_LEAD;
+        else
+            linkStats.flushedBytes++;
+        return false;
+
+    case COMM_STATE::WAIT_NOT_LEAD:
+        if (b == ((~MatrixR4_COMM_LEAD) & 0xFF)) {
+            rxState = COMM_STATE::WAIT_CMD;
+        } else if (b != MatrixR4_COMM_LEAD) {
+            rxState = COMM_STATE::WAIT_LEAD;
+            linkStats.flushedBytes += 2;
+        } else {
+            linkStats.flushedBytes++;
+        }
+        return false;
+
+    case COMM_STATE::WAIT_CMD:
+    {
+        int16_t size = LegacyReplySize(b);
+        rxState      = COMM_STATE::WAIT_LEAD;
+        if (size < 0) {
+            // Nobody expects it, so its length is unknown: a late reply or noise.
+            if (LookupCmd(b) < 0) linkStats.unknownCmds++;
+            else linkStats.lateReplies++;
+            linkStats.flushedBytes += 3;
+            return false;
+        }
 
-    *ptr++ = MatrixR4_COMM_LEAD;
-    *ptr++ = ((~MatrixR4_COMM_LEAD) & 0xFF);
-    *ptr++ = (uint8_t)cmd;
+        rxCmd     = b;
+        rxSeq     = 0;
+        rxLen     = 0;
+        rxPos     = 0;
+        rxNeed    = size;
+        rxHasTick = false;
+        if (size == 0) return true;
+        rxState = COMM_STATE::WAIT_PAYLOAD;
+        return false;
+    }
+
+    case COMM_STATE::WAIT_PAYLOAD:
+        rxPayload[rxLen++] = b;
+        // F_DESCRIPTOR replies carry the length of the text that follows.
+        if (rxLen == 1 && rxCmd == (uint8_t)COMM_CMD::F_DESCRIPTOR) {
+            rxNeed += (b < MatrixR4_FRAME_PAYLOAD_MAX) ? b : (MatrixR4_FRAME_PAYLOAD_MAX - 1);
+        }
+        if (rxLen < rxNeed) return false;
+        rxState = COMM_STATE::WAIT_LEAD;
+        return true;
 
-    for (uint16_t i = 0; i < size; i++) {
-        *ptr++ = data[i];
+    default: rxState = COMM_STATE::WAIT_LEAD; return false;
     }
-    commSerial->write(arr, 3 + size);
-    commSerial->flush();
 }
 
-void MMLower::CommSendData(COMM_CMD cmd, uint8_t data)
+bool MMLower::FrameFeed(uint8_t b)
 {
-    uint8_t _data[1] = {data};
-    CommSendData((COMM_CMD)cmd, _data, 1);
+    if (rxRawLen >= MatrixR4_FRAME_SIZE_MAX) rxRawLen = 0;
+    rxRaw[rxRawLen++] = b;
+    return FrameParse();
 }
 
-bool MMLower::CommReadData(uint8_t* data, uint16_t size, uint32_t timeout_ms)
+// Payload sizes a frame of cmd may have without the tick: the reply in
+// cmdTable or the push. false for an opcode MMLower does not know.
+static bool FramePayloadRange(uint8_t cmd, uint8_t& min, uint8_t& max)
 {
-    uint32_t timeout = millis() + timeout_ms;
-    while (millis() <= timeout) {
-        if (commSerial->available() >= size) {
-            for (uint16_t i = 0; i < size; i++) {
-                data[i] = commSerial->read();
-            }
-            return true;
-        }
+    int16_t push = PushSize(cmd);
+    if (push >= 0) {
+        min = max = push;
+        return true;
     }
-    // Timeout
-    // Clear Buffer
-    while (commSerial->available() > 0) {
-        commSerial->read();
+
+    int8_t idx = LookupCmd(cmd);
+    if (idx < 0) return false;
+    min = max = cmdTable[idx].replySize;
+    if (cmd == (uint8_t)MMLower::COMM_CMD::GET_SNAPSHOT) {
+        for (uint8_t bit = 0; bit < SNAPSHOT_FIELD_NUM; bit++) max += snapFieldSize[bit];
+    } else if (cmd == (uint8_t)MMLower::COMM_CMD::GET_SAMPLE) {
+        max += sampleReplyMax;
+    } else if (cmd == (uint8_t)MMLower::COMM_CMD::F_DESCRIPTOR) {
+        max = MatrixR4_FRAME_PAYLOAD_MAX;   // length, then the text
     }
-    return false;
+    return true;
 }
 
-bool MMLower::WaitData(COMM_CMD cmd, uint32_t timeout_ms)
+bool MMLower::FrameLenValid(uint8_t cmd, uint8_t len)
 {
-    static COMM_STATE state = COMM_STATE::WAIT_LEAD;
+    uint8_t min, max;
+    if (!FramePayloadRange(cmd, min, max)) {
+        linkStats.unknownCmds++;
+        return false;
+    }
+    // The reply that switches the tick on or off may come either way.
+    if (len >= min && len <= max) return true;
+    if (len >= min + MatrixR4_FRAME_TICK_SIZE && len <= max + MatrixR4_FRAME_TICK_SIZE) return true;
 
-    uint32_t timeout = millis() + timeout_ms;
-    while (millis() <= timeout) {
-        if (commSerial->available() <= 0) {
-            continue;
-        }
-        switch (state) {
-        case COMM_STATE::WAIT_LEAD:
-        {
-            uint8_t b = commSerial->read();
-            if (b == MatrixR4_COMM_LEAD) {
-                state = COMM_STATE::WAIT_NOT_LEAD;
-            }
-        } break;
+    MR4_DEBUG_PRINTLN(F("Frame length error"));
+    linkStats.crcErrors++;
+    return false;
+}
 
-        case COMM_STATE::WAIT_NOT_LEAD:
-        {
-            uint8_t b = commSerial->read();
-            if (b == ((~MatrixR4_COMM_LEAD) & 0xFF))
-                state = COMM_STATE::WAIT_CMD;
-            else
-                state = COMM_STATE::WAIT_LEAD;
-        } break;
-
-        case COMM_STATE::WAIT_CMD:
-        {
-            uint8_t b = commSerial->read();
-            if (b == (uint8_t)cmd) {
-                state = COMM_STATE::WAIT_LEAD;
-                return true;
+/**
+ * @brief Try to decode one frame from the bytes buffered in rxRaw.
+ *
+ * Bytes stay in rxRaw until a full frame passes its CRC. A bad lead, an
+ * unknown opcode, a len that does not fit the opcode or a bad CRC drops a
+ * single byte and rescans the rest in place, so frames that follow a
+ * corrupted one are not lost. The len check comes first: len is covered
+ * only by the CRC at the end, a corrupted one must not hold the decoder
+ * waiting for bytes that belong to the next frames.
+ *
+ * @return true when a frame was decoded into rxCmd/rxSeq/rxPayload.
+ */
+bool MMLower::FrameParse(void)
+{
+    while (rxRawLen > 0) {
+        uint16_t drop = 0;
+        if (rxRaw[0] != MatrixR4_COMM_LEAD) {
+            drop = 1;
+        } else if (rxRawLen >= 2 && rxRaw[1] != ((~MatrixR4_COMM_LEAD) & 0xFF)) {
+            drop = 1;
+        } else if (rxRawLen >= MatrixR4_FRAME_HEADER_SIZE && !FrameLenValid(rxRaw[2], rxRaw[4])) {
+            drop = 1;
+        } else if (rxRawLen >= MatrixR4_FRAME_HEADER_SIZE) {
+            uint16_t len   = rxRaw[4];
+            uint16_t total = MatrixR4_FRAME_HEADER_SIZE + len + MatrixR4_FRAME_CRC_SIZE;
+            if (rxRawLen < total) return false;
+
+            uint16_t crc = CRC16::Calc(rxRaw + 2, 3 + len);
+            if (crc == WireField<uint16_t>::Load(rxRaw + MatrixR4_FRAME_HEADER_SIZE + len)) {
+                rxCmd = rxRaw[2];
+                rxSeq = rxRaw[3];
+                rxLen = len;
+                rxPos = 0;
+                memcpy(rxPayload, rxRaw + MatrixR4_FRAME_HEADER_SIZE, len);
+                drop = total;
+
+                rxHasTick = (stamped && len >= MatrixR4_FRAME_TICK_SIZE);
+                if (rxHasTick) {
+                    rxLen   -= MatrixR4_FRAME_TICK_SIZE;
+                    rxTick   = WireField<uint32_t>::Load(rxPayload + rxLen);
+                    rxTickUs = micros();
+                }
             } else {
-                state = COMM_STATE::WAIT_LEAD;
-                HandleCommand(b);
+                MR4_DEBUG_PRINTLN(F("Frame CRC error"));
+                linkStats.crcErrors++;
+                drop = 1;
             }
-        } break;
-
-        case COMM_STATE::ERROR:
-        {
-            // TODO: Handle Error
-            MR4_DEBUG_PRINTLN("COMM_STATE: ERROR");
-            state = COMM_STATE::WAIT_LEAD;
-        } break;
 
-        default: state = COMM_STATE::WAIT_LEAD; break;
+            rxRawLen -= drop;
+            memmove(rxRaw, rxRaw + drop, rxRawLen);
+            if (drop == total) return true;
+            linkStats.flushedBytes += drop;
+            continue;
+        } else {
+            return false;
         }
+
+        linkStats.flushedBytes += drop;
+        rxRawLen -= drop;
+        memmove(rxRaw, rxRaw + drop, rxRawLen);
     }
-    // Timeout
-    state = COMM_STATE::WAIT_LEAD;
     return false;
 }
 
+// When the lower board took the sample in the frame just decoded, else now.
+uint32_t MMLower::RxSampleUs(void)
+{
+    uint32_t now = micros();
+    if (!rxHasTick || !clockSync.IsSynced()) return now;
+
+    uint32_t us = clockSync.ToLocal(rxTick);
+    return ((int32_t)(us - now) > 0) ? now : us;
+}
+
 void MMLower::HandleCommand(uint8_t cmd)
 {
+    if (HandleAsyncReply(cmd)) return;
+
     switch (cmd) {
     case (uint8_t)COMM_CMD::AUTO_SEND_BUTTON_STATE:
     {
         uint8_t b[2];
         if (CommReadData(b, 2)) {
+            if (b[0] >= MatrixR4_BUTTON_NUM) break;
+            BTN_STATE newState = (BTN_STATE)b[1];
+            btnState[b[0]]     = (newState == BTN_STATE::F_EDGE || newState == BTN_STATE::REPEAT ||
+                              newState == BTN_STATE::PRESSED);
+            btnStateUs         = RxSampleUs();
             if (callbackFunc == NULL) break;
-            if (b[0] < MatrixR4_BUTTON_NUM) {
-                callbackFunc(b[0] + 1, (BTN_STATE)b[1]);
-            }
+            PushEvent(EVENT::BUTTON, b[0] + 1, (uint8_t)newState, btnStateUs);
         }
     } break;
     case (uint8_t)COMM_CMD::AUTO_SEND_ENCODER_COUNTER:
     {
         uint8_t b[8];
         if (CommReadData(b, 8)) {
+            // The stream carries the low 16 bits, extend them from the last known count.
+            uint16_t low[MatrixR4_ENCODER_NUM];
+            WireUnpack(b, low);
             for (uint8_t i = 0; i < MatrixR4_ENCODER_NUM; i++) {
-                enCounter[i] = BitConverter::ToInt16(b, i * 2);
+                enCounter64[i] += (int16_t)(low[i] - (uint16_t)enCounter64[i]);
+                enCounter[i]    = (int32_t)enCounter64[i];
             }
+            enCounterUs = RxSampleUs();
         }
     } break;
     case (uint8_t)COMM_CMD::AUTO_SEND_IMU_EULER:
     {
         uint8_t b[6];
-        if (CommReadData(b, 6)) {}
+        if (CommReadData(b, 6)) {
+            DecodeIMU(b, IMU_DEG_PER_LSB, imuEuler[0], imuEuler[1], imuEuler[2]);
+            PublishIMU(imuEuler, imuRoll, imuPitch, imuYaw);
+            imuEulerUs = RxSampleUs();
+        }
     } break;
     case (uint8_t)COMM_CMD::AUTO_SEND_IMU_GYRO:
     {
         uint8_t b[6];
         if (CommReadData(b, 6)) {
-            imuGyroX = BitConverter::ToInt16(b, 0) / 100.0f;
-            imuGyroY = BitConverter::ToInt16(b, 2) / 100.0f;
-            imuGyroZ = BitConverter::ToInt16(b, 4) / 100.0f;
+            DecodeIMU(b, IMU_DEG_PER_LSB, imuGyro[0], imuGyro[1], imuGyro[2]);
+            PublishIMU(imuGyro, imuGyroX, imuGyroY, imuGyroZ);
+            imuGyroUs = RxSampleUs();
         }
     } break;
     case (uint8_t)COMM_CMD::AUTO_SEND_IMU_ACC:
     {
         uint8_t b[6];
         if (CommReadData(b, 6)) {
-            imuAccX = BitConverter::ToInt16(b, 0) / 1000.0f;
-            imuAccY = BitConverter::ToInt16(b, 2) / 1000.0f;
-            imuAccZ = BitConverter::ToInt16(b, 4) / 1000.0f;
+            DecodeIMU(b, IMU_G_PER_LSB, imuAcc[0], imuAcc[1], imuAcc[2]);
+            PublishIMU(imuAcc, imuAccX, imuAccY, imuAccZ);
+            imuAccUs = RxSampleUs();
+            if (imuCallback != NULL) imuPending = true;
         }
     } break;
-    default: break;
+    case (uint8_t)COMM_CMD::AUTO_SEND_TASK_DONE:
+    {
+        // task, 0 based motor / drive
+        uint8_t b[2];
+        if (CommReadData(b, 2) && b[0] <= (uint8_t)TASK::DRIVE) {
+            uint8_t bit = 1 << (b[1] & 7);
+            if (taskPolled[b[0]] & bit) taskPolled[b[0]] &= ~bit;   // already reported
+            else TaskDone((TASK)b[0], b[1] + 1, RxSampleUs());
+        }
+    } break;
+    default:
+        if (LookupCmd(cmd) < 0) linkStats.unknownCmds++;
+        else linkStats.lateReplies++;
+        break;
     }
 }
 
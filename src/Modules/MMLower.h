@@ -6,8 +6,11 @@
 #ifndef MMLOWER_H
 #define MMLOWER_H
 
+#include "MMLowerCapture.h"
+#include "MMLowerProfile.h"
+#include "MMLowerTransport.h"
+#include "Util/ClockSync.h"
 #include <Arduino.h>
-#include <SoftwareSerial.h>
 
 #define MR4_DEBUG_ENABLE false
 #define MR4_DEBUG_SERIAL Serial
@@ -37,14 +40,87 @@
 
 #define MatrixR4_COMM_LEAD 0x7B
 
+// Framed link: LEAD, ~LEAD, cmd, seq, len, payload[len], crc16 (LE, over cmd..payload)
+#ifndef MR4_COMM_FRAMING_ENABLE
+#    define MR4_COMM_FRAMING_ENABLE true
+#endif
+#define MatrixR4_FRAME_VERSION     0x01
+#define MatrixR4_FRAME_HEADER_SIZE 5
+#define MatrixR4_FRAME_CRC_SIZE    2
+#define MatrixR4_FRAME_PAYLOAD_MAX 255
+// Lower board tick appended to framed replies and auto-send frames, see SetCommTimestamp().
+#ifndef MR4_COMM_TIMESTAMP_ENABLE
+#    define MR4_COMM_TIMESTAMP_ENABLE false
+#endif
+#define MatrixR4_FRAME_TICK_SIZE 4
+// Baud rate requested after EchoTest, 0 keeps the link at the Init() baud rate.
+#ifndef MR4_COMM_FAST_BAUDRATE
+#    define MR4_COMM_FAST_BAUDRATE 0
+#endif
+#define MatrixR4_FRAME_SIZE_MAX \
+    (MatrixR4_FRAME_HEADER_SIZE + MatrixR4_FRAME_PAYLOAD_MAX + MatrixR4_FRAME_CRC_SIZE)
+// TX ring, must hold at least one frame of MatrixR4_FRAME_SIZE_MAX
+#define MatrixR4_TX_BUF_SIZE   384
+#define MatrixR4_TX_TIMEOUT_MS 100
+
+// Firmware without an optional command does not answer it, its first use
+// waits this long before the library falls back (BatchFlush()). InitFast()
+// probes with EchoTest the same way, the gap between probes starts at 1 ms
+// and doubles up to MatrixR4_PROBE_GAP_MAX_MS.
+#define MatrixR4_PROBE_TIMEOUT_US 10000
+#define MatrixR4_PROBE_GAP_MAX_MS 20
+
+// GET_SAMPLE: the lower board holds a request for a new sample up to one
+// sample period, this is added to the reply timeout.
+#define MatrixR4_SAMPLE_HOLD_MAX_US 20000
+
 #define MatrixR4_SERVO_NUM    4
 #define MatrixR4_DC_MOTOR_NUM 4
 #define MatrixR4_ENCODER_NUM  4
 #define MatrixR4_BUTTON_NUM   2
+#define MatrixR4_DRIVE_NUM    4
+
+// WaitTaskDone() asks this often when the lower board does not push
+// AUTO_SEND_TASK_DONE (old firmware, or TELEMETRY::TASK not subscribed).
+#define MatrixR4_TASK_POLL_MS 10
+// With pushes it still asks this often, a lost push must not hang the wait.
+#ifndef MatrixR4_TASK_CHECK_MS
+#    define MatrixR4_TASK_CHECK_MS (5 * MatrixR4_TASK_POLL_MS)
+#endif
+// Subscribe to AUTO_SEND_TASK_DONE in Init() / InitFast(), framed links only.
+#ifndef MR4_TASK_PUSH_ENABLE
+#    define MR4_TASK_PUSH_ENABLE true
+#endif
+
+#define MatrixR4_ASYNC_SLOT_NUM   8
+#define MatrixR4_ASYNC_REPLY_SIZE 20
+// Button and task callbacks held back while a command waits for its reply
+#define MatrixR4_EVENT_QUEUE_SIZE 8
+
+// Per-command link counters, one entry per row of the command descriptor table
+#ifndef MR4_LINK_STATS_ENABLE
+#    define MR4_LINK_STATS_ENABLE true
+#endif
+#define MatrixR4_CMD_NUM 79
+
+// Reply timeouts follow the measured round trip of each command (smoothed
+// RTT + 4 x variance, as TCP does), between MR4_RTO_MIN_US and the
+// timeout in cmdTable. Off = always the cmdTable timeout. An async request
+// counts from the reply to the one queued ahead of it, see RtoRestartAsync().
+#ifndef MR4_ADAPTIVE_TIMEOUT_ENABLE
+#    define MR4_ADAPTIVE_TIMEOUT_ENABLE true
+#endif
+#ifndef MR4_RTO_MIN_US
+#    define MR4_RTO_MIN_US 3000
+#endif
+#define MatrixR4_RTO_UNIT_US     16   // RTT estimates are kept in 16 µs units
+#define MatrixR4_RTO_BACKOFF_MAX 6
 
 #define DIR_REVERSE (MatrixMiniR4::DIR::REVERSE)
 #define DIR_FORWARD (MatrixMiniR4::DIR::FORWARD)
 
+struct MMLowerCmdDesc_t;
+
 /**
  * @brief Handling the Lower MCU (STM32) communication.
  */
@@ -52,13 +128,15 @@ class MMLower
 {
 public:
     MMLower(uint8_t rx, uint8_t tx, uint32_t baudrate);
+    MMLower(MMLowerTransport* transport, uint32_t baudrate);
 
     enum class COMM_STATE
     {
         WAIT_LEAD,
         WAIT_NOT_LEAD,
         WAIT_CMD,
-        ERROR,
+        ERROR,   // deprecated, never set, kept for sketches that name it
+        WAIT_PAYLOAD,
     };
 
     enum class COMM_CMD
@@ -79,6 +157,7 @@ public:
 		SET_ENCODER_PPR_MAXSPEED,			//  2025/07/07
 		SET_ALL_ENCODER_PPR,				//  2025/05/22
 		SET_IMU_Calib_Data,					//  2025/05/22	
+        SET_TASK_ECHO_MODE,
 		
         // Setting-Commonly used
         SET_DC_MOTOR_POWER = 0x11,
@@ -116,6 +195,7 @@ public:
         AUTO_SEND_IMU_EULER,
         AUTO_SEND_IMU_GYRO,
         AUTO_SEND_IMU_ACC,
+        AUTO_SEND_TASK_DONE,
 		
 		// New Function 					//  2025/05/22
 		SET_DC_BRAKE_TYPE			= 0x41,
@@ -150,13 +230,21 @@ public:
 		
 
         // Other-Info
-        ECHO_TEST        = 0xFF,
-        F_VERSION        = 0xFE,
-        F_BUILD_DAY      = 0xFD,
-        F_DESCRIPTOR     = 0xFC,
-        READ_MODEL_INDEX = 0xFB,
-        READ_ALL_INFO    = 0xFA,
-        RUN_AUTO_QC      = 0xF9,
+        ECHO_TEST         = 0xFF,
+        F_VERSION         = 0xFE,
+        F_BUILD_DAY       = 0xFD,
+        F_DESCRIPTOR      = 0xFC,
+        READ_MODEL_INDEX  = 0xFB,
+        READ_ALL_INFO     = 0xFA,
+        RUN_AUTO_QC       = 0xF9,
+        SET_COMM_FRAMING   = 0xF8,
+        SET_COMM_BAUDRATE  = 0xF7,
+        SET_COMM_TIMESTAMP = 0xF6,
+        GET_PROFILE_HASH   = 0xF5,
+        SET_PROFILE        = 0xF4,
+        GET_SNAPSHOT       = 0xF3,
+        GET_SAMPLE         = 0xF2,
+        SET_BATCH          = 0xF1,
     };
 
     enum class BTN_STATE
@@ -196,6 +284,39 @@ public:
         MAX,
     };
 
+    enum class TASK_ECHO_MODE
+    {
+        PASSIVE,
+        ACTIVE,
+        MAX,
+    };
+
+    enum class TELEMETRY
+    {
+        BUTTON,
+        ENCODER,
+        IMU,
+        TASK,   // AUTO_SEND_TASK_DONE
+    };
+
+    /**
+     * @brief Sensors the lower board numbers its samples of, see GetSampleSeq().
+     */
+    enum class SENSOR
+    {
+        SPEED,   // encoder speeds
+        IMU,
+    };
+
+    /**
+     * @brief Motions that run on the lower board until they finish on their own.
+     */
+    enum class TASK
+    {
+        ROTATE,   // SetDCMotorRotate(), num is the motor
+        DRIVE,    // Set_Drive_*Degs / *Time / TurnGyro, num is the drive
+    };
+
     enum class IMU_ACC_FSR
     {
         _2G,
@@ -300,6 +421,9 @@ public:
         ERROR_QC_IMU,
 
         ERROR_POWER_VOLT_RANGE,
+
+        // Async
+        PENDING,
     };
 	
 	enum class Drive_RESULT
@@ -344,9 +468,112 @@ public:
         uint8_t modelIndex;
     } AllInfo_t;
 
+    /**
+     * @brief Robot state read by GetSnapshot(), fields tells which members
+     * were filled.
+     */
+    struct Snapshot_t
+    {
+        enum FIELD : uint16_t
+        {
+            ENCODER = 0x0001,   // enCounter
+            SPEED   = 0x0002,   // enSpeed
+            EULER   = 0x0004,   // roll, pitch, yaw (deg)
+            GYRO    = 0x0008,   // gyroX..gyroZ (deg/s)
+            ACC     = 0x0010,   // accX..accZ (g)
+            BUTTON  = 0x0020,   // btnState
+            POWER   = 0x0040,   // voltage, voltagePerc
+            ALL     = 0x007F,
+        };
+
+        uint16_t fields;
+        int32_t  enCounter[MatrixR4_ENCODER_NUM];
+        int32_t  enSpeed[MatrixR4_DC_MOTOR_NUM];
+        float    roll, pitch, yaw;
+        float    gyroX, gyroY, gyroZ;
+        float    accX, accY, accZ;
+        bool     btnState[MatrixR4_BUTTON_NUM];
+        float    voltage, voltagePerc;
+        uint32_t sampleUs;   // micros() of the sample, like the shadow stamps
+    };
+
+    /**
+     * @brief Counters of one command, see GetCmdStats().
+     */
+    typedef struct
+    {
+        uint32_t calls;
+        uint32_t timeouts;       // no reply, ERROR_WAIT_TIMEOUT
+        uint32_t readTimeouts;   // reply shorter than expected, ERROR_READ_TIMEOUT
+        uint32_t retries;        // sent again right after a failed call
+        uint32_t latencyUsSum;   // request queued to reply decoded, replies only
+        uint32_t latencyUsMax;
+    } CmdStats_t;
+
+    /**
+     * @brief Counters of the whole link, see GetLinkStats().
+     */
+    typedef struct
+    {
+        uint32_t txFrames;
+        uint32_t rxFrames;
+        uint32_t flushedBytes;   // thrown away by the decoder while resyncing
+        uint32_t crcErrors;      // or a frame length that does not fit the opcode
+        uint32_t unknownCmds;    // frames with an opcode MMLower does not know
+        uint32_t lateReplies;    // replies that arrived after their caller gave up
+        uint32_t txStalls;       // TX ring stayed full for MatrixR4_TX_TIMEOUT_MS
+    } LinkStats_t;
+
+    /**
+     * @brief Called from loop() when the lower board reports a button change.
+     *
+     * Like every MMLower callback it never runs while a command waits for
+     * its reply: changes seen then are queued and reported when that call
+     * returns. So it may send commands.
+     */
     typedef void (*BtnChgCallback)(uint8_t num, BTN_STATE newState);
 
-    RESULT Init(uint32_t timeout_ms = 1000);
+    /**
+     * @brief Called from loop(), WaitTaskDone() or the end of a blocking call
+     * when a task finished, doneUs as GetTaskDoneUs().
+     */
+    typedef void (*TaskDoneCallback)(TASK task, uint8_t num, uint32_t doneUs);
+
+    /**
+     * @brief Called while WaitTaskDone() waits. No command is in flight
+     * then, so the callback may send its own.
+     */
+    typedef void (*IdleCallback)(void);
+
+    /**
+     * @brief Called from loop() when an IMU telemetry sample is complete:
+     * the board sends Euler, gyro and acc in that order, this runs after the
+     * acc frame with imuGyro* and imuAcc* of the same sample. Samples that
+     * arrive while a command waits are reported once, with the latest, when
+     * that call returns.
+     */
+    typedef void (*IMUCallback)(void);
+
+    /**
+     * @brief Handle of a queued async command, -1 if it could not be queued.
+     */
+    typedef int8_t AsyncHandle;
+
+    /**
+     * @brief Called from loop() when an async command completes or times out.
+     *
+     * A completion parsed while another command waits for its reply is held
+     * until that call returns, so the callback may send commands. The slot
+     * is released after the callback returns, so copy the reply if needed.
+     */
+    typedef void (*AsyncCallback)(
+        AsyncHandle handle, RESULT result, const uint8_t* reply, uint8_t size);
+
+    RESULT Init(uint32_t timeout_ms = 12500);
+    RESULT InitFast(uint32_t timeout_ms = 1000);
+    RESULT SetDefaultConfig(void);
+    RESULT ApplyProfile(const MMLowerProfile& profile, bool force = false);
+    RESULT GetProfileHash(uint32_t& hash);
     // Application API
     // Setting-Init
     RESULT SetDCMotorDir(uint8_t num, DIR dir);
@@ -355,7 +582,10 @@ public:
     RESULT SetDCMotorSpeedRange(uint8_t num, uint16_t min, uint16_t max);
     RESULT SetServoPulseRange(uint8_t num, uint16_t min, uint16_t max);
     RESULT SetServoAngleRange(uint8_t num, uint16_t min, uint16_t max);
+    RESULT SetButtonEchoMode(BUTTON_ECHO_MODE mode);
+    RESULT SetEncoderEchoMode(ENCODER_ECHO_MODE mode, uint16_t echoIntervalMs);
     RESULT SetIMUEchoMode(IMU_ECHO_MODE mode, uint16_t echoIntervalMs);
+    RESULT SetTaskEchoMode(TASK_ECHO_MODE mode);
     RESULT SetIMUInit(IMU_ACC_FSR accFSR, IMU_GYRO_FSR gyroFSR, IMU_ODR odr, IMU_FIFO fifo);
     RESULT SetPowerParam(float fullVolt, float cutOffVolt, float alarmVolt);
     RESULT SetStateLED(uint8_t brightness, uint32_t colorRGB);
@@ -383,6 +613,9 @@ public:
     RESULT GetButtonsState(bool* btnsState);
     RESULT GetEncoderCounter(uint8_t num, int32_t& enCounter);
     RESULT GetAllEncoderCounter(int32_t* enCounter);
+    RESULT GetIMUEuler(float& roll, float& pitch, float& yaw);
+    RESULT GetIMUGyro(float& x, float& y, float& z);
+    RESULT GetIMUAcc(float& x, float& y, float& z);
     RESULT GetIMUEuler(double& roll, double& pitch, double& yaw);
     RESULT GetIMUGyro(double& x, double& y, double& z);
     RESULT GetIMUAcc(double& x, double& y, double& z);
@@ -391,14 +624,27 @@ public:
 	RESULT GetALLEncoderSpeed(int32_t * enSpeed);					//  2025/05/22	
 	RESULT Get_IMU_nancalib_acc(float * accdata);					//  2025/05/22	
 	RESULT GetEncoderDegrees(uint8_t num, int32_t& enDeges);		//  2025/07/15	
+    RESULT GetALLEncoderSpeed(int32_t* enSpeed, uint16_t newerThan);
+    RESULT Get_IMU_nancalib_acc(float* accdata, uint16_t newerThan);
+    uint16_t GetSampleSeq(SENSOR sensor) { return sampleSeq[(uint8_t)sensor]; }
+    RESULT GetSnapshot(Snapshot_t& snap, uint16_t fields = Snapshot_t::ALL);
     // Other-Info
     RESULT EchoTest(void);
     RESULT GetFWVersion(String& version);
+    RESULT GetFWVersion(uint8_t& major, uint8_t& minor);
     RESULT GetFWBuildDay(String& date);
     RESULT GetFWDescriptor(String& descriptor);
     RESULT GetModelIndex(uint8_t& index);
     RESULT GetAllInfo(AllInfo_t& info);
     RESULT RunAutoQC(void);
+    RESULT SetCommFraming(bool enable);
+    RESULT SetCommBaudrate(uint32_t baudrate);
+    bool   isFramed(void) { return framed; }
+    RESULT SetCommTimestamp(bool enable);
+    bool   isTimestamped(void) { return stamped; }
+    RESULT SyncClock(uint8_t rounds = 8);
+    void   SetClockSyncInterval(uint16_t intervalMs);
+    const ClockSync& GetClockSync(void) { return clockSync; }
 	
 	// Drive DC Function											// 2025/05/30
 	Drive_RESULT Set_Drive2Motor_PARAM(uint8_t m1_num, uint8_t m2_num, DIR m1_dir, DIR m2_dir, uint8_t num);
@@ -428,28 +674,298 @@ public:
 	Drive_RESULT Get_Drive_EncoderCounter(uint8_t num, int32_t& enCounter);
 	Drive_RESULT Get_Drive_Degrees(uint8_t num, int32_t& Degs);
 
-	
+    // Async API
+    // Queue the request and return at once, completion is driven by loop().
+    AsyncHandle SendAsync(
+        COMM_CMD cmd, uint8_t* data, uint16_t size, uint8_t replySize,
+        AsyncCallback callback = NULL, uint32_t timeout_ms = 100);
+    AsyncHandle SetDCMotorPowerAsync(uint8_t num, int16_t power, AsyncCallback callback = NULL);
+    AsyncHandle SetDCMotorSpeedAsync(uint8_t num, int16_t speed, AsyncCallback callback = NULL);
+    AsyncHandle SetServoAngleAsync(uint8_t num, uint16_t angle, AsyncCallback callback = NULL);
+    AsyncHandle GetAllEncoderCounterAsync(AsyncCallback callback = NULL);
+    AsyncHandle GetIMUEulerAsync(AsyncCallback callback = NULL);
+    AsyncHandle GetIMUGyroAsync(AsyncCallback callback = NULL);
+    AsyncHandle GetIMUAccAsync(AsyncCallback callback = NULL);
+    bool        isDone(AsyncHandle handle);
+    RESULT      poll(AsyncHandle handle, uint8_t* reply = NULL, uint8_t size = 0);
+    RESULT      await(AsyncHandle handle, uint8_t* reply = NULL, uint8_t size = 0);
+
+    // Batch API
+    // Collect actuator writes, BatchFlush() sends them in one SET_BATCH request.
+    bool   BatchDCMotorPower(uint8_t num, int16_t power);
+    bool   BatchDCMotorSpeed(uint8_t num, int16_t speed);
+    bool   BatchDCBrake(uint8_t num);
+    bool   BatchServoAngle(uint8_t num, uint16_t angle);
+    void   BatchClear(void);
+    bool   BatchIsEmpty(void);
+    RESULT BatchFlush(void);
+
+    // Link statistics
+    void GetLinkStats(LinkStats_t& stats);
+    bool GetCmdStats(COMM_CMD cmd, CmdStats_t& stats);
+    void ResetLinkStats(void);
+    void PrintLinkStats(Print& out);
+    uint32_t GetTimeoutUs(COMM_CMD cmd);
+
+    // Telemetry shadow
+    RESULT Subscribe(TELEMETRY stream, uint16_t intervalMs);
+    void   SetTelemetryMaxAge(uint16_t maxAgeMs);
+    bool   GetCachedButtonState(uint8_t num, bool& state);
+    bool   GetCachedEncoderCounter(uint8_t num, int32_t& counter);
+    bool   GetCachedEncoderCounter64(uint8_t num, int64_t& counter);
+    void   SetEncoderReconcile(uint16_t intervalMs);
+    bool   GetCachedIMUEuler(float& roll, float& pitch, float& yaw);
+    bool   GetCachedIMUGyro(float& x, float& y, float& z);
+    bool   GetCachedIMUAcc(float& x, float& y, float& z);
+    bool   GetCachedIMUEuler(double& roll, double& pitch, double& yaw);
+    bool   GetCachedIMUGyro(double& x, double& y, double& z);
+    bool   GetCachedIMUAcc(double& x, double& y, double& z);
+
+    // Task completion
+    void     onTaskDone(TaskDoneCallback callback);
+    RESULT   GetTaskState(TASK task, uint8_t num, bool& isDone);
+    RESULT   WaitTaskDone(TASK task, uint8_t num, uint32_t timeout_ms = 0);
+    uint32_t GetTaskDoneUs(TASK task, uint8_t num);
 
     void loop(void);
     void onBtnChg(BtnChgCallback callback);
+    void onIdle(IdleCallback callback) { idleCallback = callback; }
+    void onSchedulerIdle(IdleCallback callback) { schedulerCallback = callback; }   // MiniR4Scheduler's
+    void onIMU(IMUCallback callback) { imuCallback = callback; }
+    void setTransport(MMLowerTransport* transport) { commSerial = transport; }
+    void setCapture(MMLowerCapture* capture) { this->capture = capture; }
 
     // TODO: 外部存取?
+    // Buttons
+    bool btnState[MatrixR4_BUTTON_NUM];
     // Encoders
     int32_t enCounter[MatrixR4_ENCODER_NUM];
-    // IMU
+    // IMU, double copies of the float shadows the library works on
+    double imuRoll, imuPitch, imuYaw;
     double imuGyroX, imuGyroY, imuGyroZ;
     double imuAccX, imuAccY, imuAccZ;
+    // Last update time of each shadow, micros(), 0 = never. With timestamps
+    // on and the clock synced this is when the lower board took the sample.
+    uint32_t btnStateUs, enCounterUs, imuEulerUs, imuGyroUs, imuAccUs;
 
 private:
-    uint32_t        _baudrate;
-    SoftwareSerial* commSerial;
-    BtnChgCallback  callbackFunc;
-
-    void CommSendData(COMM_CMD cmd, uint8_t* data = NULL, uint16_t size = 0);
-    void CommSendData(COMM_CMD cmd, uint8_t data);
-    bool CommReadData(uint8_t* data, uint16_t size = 1, uint32_t timeout_ms = 10);
-    bool WaitData(COMM_CMD cmd = COMM_CMD::NONE, uint32_t timeout_ms = 0);
-    void HandleCommand(uint8_t cmd);
+    enum class ASYNC_STATE
+    {
+        FREE,
+        PENDING,
+        DONE,
+        NOTIFY,   // done, the callback has not run yet
+    };
+
+    enum class EVENT : uint8_t
+    {
+        BUTTON,   // num, BTN_STATE
+        TASK,     // num, TASK
+    };
+
+    enum class PROBE
+    {
+        UNKNOWN,
+        SUPPORTED,
+        UNSUPPORTED,
+    };
+
+    enum class BATCH_OP
+    {
+        NONE,
+        POWER,
+        SPEED,
+        BRAKE,
+    };
+
+    typedef struct
+    {
+        ASYNC_STATE             state;
+        COMM_CMD                cmd;
+        const MMLowerCmdDesc_t* desc;   // NULL for raw SendAsync() requests
+        uint8_t                 seq;
+        uint8_t                 replySize;
+        uint8_t                 reply[MatrixR4_ASYNC_REPLY_SIZE];
+        RESULT                  result;
+        uint16_t                order;
+        uint32_t                startUs;   // queued, or the last reply to a request ahead of it
+        uint32_t                timeoutUs;
+        AsyncCallback           callback;
+    } AsyncSlot_t;
+
+    typedef struct
+    {
+        EVENT    kind;
+        uint8_t  num;
+        uint8_t  value;
+        uint32_t us;
+    } Event_t;
+
+    uint32_t          _baudrate;
+    MMLowerTransport* commSerial;
+    BtnChgCallback    callbackFunc;
+    TaskDoneCallback  taskCallback;
+    IdleCallback      idleCallback;
+    IdleCallback      schedulerCallback;   // runs before idleCallback, set by MiniR4Scheduler
+    float             imuEuler[3], imuGyro[3], imuAcc[3];   // x y z, roll pitch yaw
+    IMUCallback       imuCallback;
+    AsyncSlot_t       asyncSlots[MatrixR4_ASYNC_SLOT_NUM];
+    uint16_t          asyncOrder;
+    Event_t           events[MatrixR4_EVENT_QUEUE_SIZE];
+    uint8_t           eventHead;
+    uint8_t           eventCount;
+    bool              imuPending;
+    bool              firing;   // inside FireCallbacks()
+    BATCH_OP          batchMotorOp[MatrixR4_DC_MOTOR_NUM];
+    int16_t           batchMotorValue[MatrixR4_DC_MOTOR_NUM];
+    bool              batchServoSet[MatrixR4_SERVO_NUM];
+    uint16_t          batchServoAngle[MatrixR4_SERVO_NUM];
+    PROBE             snapshotProbe;   // whether the firmware answers GET_SNAPSHOT
+    PROBE             sampleProbe;     // and GET_SAMPLE
+    PROBE             batchProbe;      // and SET_BATCH
+    uint16_t          sampleSeq[2];    // of the last sample read, per SENSOR
+
+    // Framed link
+    bool     framed;
+    uint8_t  txSeq;
+    uint8_t  rxRaw[MatrixR4_FRAME_SIZE_MAX];
+    uint16_t rxRawLen;
+    uint8_t  rxCmd;
+    uint8_t  rxSeq;
+    uint8_t  rxLen;
+    uint8_t  rxPos;
+    uint8_t  rxPayload[MatrixR4_FRAME_PAYLOAD_MAX];
+    // Lower board tick of the decoded frame and the micros() it was decoded at
+    bool     stamped;
+    bool     rxHasTick;
+    uint32_t rxTick;
+    uint32_t rxTickUs;
+    // Legacy decoder and the reply WaitData() is waiting for
+    COMM_STATE rxState;
+    uint16_t   rxNeed;
+    COMM_CMD   rxWaitCmd;
+    uint8_t    rxWaitSize;
+
+    // Traffic recorder, NULL = off
+    MMLowerCapture* capture;
+
+    // Link statistics, cmdFailed has a bit per command whose last call failed
+    LinkStats_t linkStats;
+#if MR4_LINK_STATS_ENABLE
+    CmdStats_t cmdStats[MatrixR4_CMD_NUM];
+    uint8_t    cmdFailed[(MatrixR4_CMD_NUM + 7) / 8];
+#endif
+
+    // Round trip estimate per command, 0 = no sample yet
+    typedef struct
+    {
+        uint16_t srtt;     // MatrixR4_RTO_UNIT_US units
+        uint16_t rttvar;   // MatrixR4_RTO_UNIT_US units
+        uint8_t  backoff;  // timeouts in a row, each doubles the timeout
+    } RttEst_t;
+#if MR4_ADAPTIVE_TIMEOUT_ENABLE
+    RttEst_t rttEst[MatrixR4_CMD_NUM];
+#endif
+
+    // TX ring, frames are serialized in place and drained by TxPump()
+    uint8_t  txBuf[MatrixR4_TX_BUF_SIZE];
+    uint16_t txHead;        // next free byte
+    uint16_t txTail;        // next byte to send
+    uint16_t txWrap;        // end of the data when txHead wrapped past txTail
+    uint16_t txFrameSize;   // frame between TxBegin() and TxEnd()
+
+    // Telemetry shadow
+    uint8_t  subscribed;   // bit per TELEMETRY
+    uint32_t telemetryMaxAgeUs;
+
+    // Encoder counts unwrapped from the 16 bit stream, corrected by 32 bit reads
+    int64_t     enCounter64[MatrixR4_ENCODER_NUM];
+    uint16_t    enReconcileMs;
+    uint32_t    enReconcileAt;
+    uint32_t    enReconcileSentUs;   // micros() when the pending read went out
+    AsyncHandle enReconcileHandle;
+
+    // Tasks started through MMLower, bit per motor / drive until the board
+    // reports them done, and when that was (micros(), 0 = never)
+    uint8_t  taskRunning[2];
+    uint8_t  taskUnsure[2];   // the start was not acknowledged, ask the board
+    uint8_t  taskPolled[2];   // seen done by asking, drop the push that follows
+    uint32_t taskDoneUs[2][MatrixR4_DC_MOTOR_NUM];
+
+    // Lower board clock, sampled by echo round trips from loop()
+    ClockSync clockSync;
+    uint16_t  clockSyncMs;
+    uint32_t  clockSyncAt;
+
+    bool     CommSendData(COMM_CMD cmd, uint8_t* data = NULL, uint16_t size = 0);
+    bool     CommSendData(COMM_CMD cmd, uint8_t data);
+    uint8_t* TxBegin(COMM_CMD cmd, uint16_t size);
+    void     TxEnd(void);
+    bool     TxReserve(uint16_t size);
+    void     TxPump(void);
+    bool     CommReadData(uint8_t* data, uint16_t size = 1);
+    bool     WaitData(COMM_CMD cmd, uint8_t replySize, uint32_t timeoutUs);
+    bool     RxPump(void);
+    bool     RxDispatch(void);
+    int16_t  LegacyReplySize(uint8_t cmd);
+    bool     LegacyFeed(uint8_t b);
+    void     HandleCommand(uint8_t cmd);
+    void     InitState(void);
+    bool     FrameFeed(uint8_t b);
+    bool     FrameParse(void);
+    bool     FrameLenValid(uint8_t cmd, uint8_t len);
+    uint32_t RxSampleUs(void);
+
+    // Table driven commands, see the command descriptor table in MMLower.cpp
+    template<COMM_CMD CMD, typename R = RESULT, typename... Args>
+    R Call(Args... args);
+    template<COMM_CMD CMD, typename R = RESULT, size_t N, typename... Args>
+    R Query(uint8_t (&reply)[N], Args... args);
+    template<COMM_CMD CMD, typename... Args>
+    AsyncHandle CallAsync(AsyncCallback callback, Args... args);
+    template<COMM_CMD CMD, typename... Args>
+    bool        PipelineCall(AsyncHandle* handles, uint8_t& count, RESULT& result, Args... args);
+    void        PipelineAwait(AsyncHandle* handles, uint8_t& count, RESULT& result);
+    template<COMM_CMD CMD, size_t N>
+    RESULT      QuerySample(SENSOR sensor, uint16_t newerThan, uint8_t (&reply)[N]);
+    uint8_t     Transact(const MMLowerCmdDesc_t& desc, uint8_t* reply, uint32_t timeoutUs = 0);
+    RESULT      EchoProbe(uint32_t timeoutUs);
+    RESULT      ApplyProfileCommands(const MMLowerProfile& profile);
+    RESULT      SnapshotQuery(Snapshot_t& snap, uint16_t fields, uint32_t timeoutUs);
+    RESULT      SnapshotPipeline(Snapshot_t& snap, uint16_t fields);
+    void        SnapshotShadow(const Snapshot_t& snap);
+    RESULT      LinkSetup(void);
+
+    AsyncHandle AsyncIssue(
+        COMM_CMD cmd, uint8_t* data, uint16_t size, uint8_t replySize,
+        const MMLowerCmdDesc_t* desc, AsyncCallback callback, uint32_t timeoutUs);
+    AsyncHandle AsyncClaim(
+        COMM_CMD cmd, uint8_t replySize, const MMLowerCmdDesc_t* desc, AsyncCallback callback,
+        uint32_t timeoutUs);
+    int8_t FindAsyncSlot(uint8_t cmd);
+    bool   HandleAsyncReply(uint8_t cmd);
+    void   CompleteAsync(AsyncHandle handle, RESULT result);
+    void   ExpireAsync(void);
+    bool   BatchMotor(uint8_t num, BATCH_OP op, int16_t value);
+    RESULT BatchQuery(uint32_t timeoutUs, bool& answered);
+    RESULT BatchPipeline(void);
+    bool   AsyncSlotFree(void);
+    bool   IsFresh(TELEMETRY stream, const uint32_t& stampUs, bool checkAge);
+    void   EncoderReconcile(uint8_t num, int32_t counter);
+    void   CountCall(const MMLowerCmdDesc_t& desc, uint8_t result, uint32_t latencyUs);
+    void   EncoderReconcilePump(void);
+    void   ClockSyncPump(void);
+    bool   TaskValid(TASK task, uint8_t num);
+    void   TaskStarted(TASK task, uint8_t num, uint8_t result);
+    RESULT QueryTaskState(TASK task, uint8_t num, bool& isDone);
+    void   TaskDone(TASK task, uint8_t num, uint32_t doneUs);
+    void   PushEvent(EVENT kind, uint8_t num, uint8_t value, uint32_t us);
+    void   FireCallbacks(void);
+
+    uint32_t RtoUs(const MMLowerCmdDesc_t& desc);
+    void     RtoUpdate(const MMLowerCmdDesc_t& desc, uint8_t result, uint32_t latencyUs);
+    void     RtoRestartAsync(uint32_t now);
+    void     RtoReset(void);
 };
 
 extern MMLower mmL;
@@ -0,0 +1,163 @@
+/**
+ * @file MMLowerCapture.cpp
+ * @brief Binary capture of the MMLower link traffic.
+ * @author MATRIX Robotics
+ */
+#include "MMLowerCapture.h"
+
+static uint8_t PutVarint(uint8_t* out, uint32_t value)
+{
+    uint8_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static void WriteHeader(Print& out)
+{
+    out.write((const uint8_t*)MR4_CAPTURE_MAGIC, 4);
+    out.write((uint8_t)MR4_CAPTURE_VERSION);
+}
+
+//--------------------------------------------------------------//
+//  MMLowerCapture  //
+//--------------------------------------------------------------//
+MMLowerCapture::MMLowerCapture()
+    : lastUs(0)
+    , started(false)
+    , records(0)
+    , stageLen(0)
+{}
+
+void MMLowerCapture::Record(bool rx, bool framed, const uint8_t* data, uint16_t size)
+{
+    uint32_t now = micros();
+    uint32_t dt  = started ? (now - lastUs) : 0;
+    lastUs       = now;
+    started      = true;
+
+    uint8_t head[MR4_CAPTURE_HEAD_MAX];
+    uint8_t n = 0;
+    head[n++] = (rx ? MR4_CAPTURE_F_RX : 0) | (framed ? MR4_CAPTURE_F_FRAMED : 0);
+    n += PutVarint(head + n, dt);
+    n += PutVarint(head + n, size);
+    Write(head, n, data, size);
+    records++;
+}
+
+void MMLowerCapture::Stage(uint8_t b, bool framed)
+{
+    if (stageLen >= MR4_CAPTURE_RX_STAGE) Commit(framed);
+    stage[stageLen++] = b;
+}
+
+void MMLowerCapture::Commit(bool framed)
+{
+    if (stageLen == 0) return;
+    Record(true, framed, stage, stageLen);
+    stageLen = 0;
+}
+
+//--------------------------------------------------------------//
+//  MMLowerCaptureRing  //
+//--------------------------------------------------------------//
+MMLowerCaptureRing::MMLowerCaptureRing(uint8_t* buffer, uint16_t size)
+    : buf(buffer)
+    , bufSize(size)
+{
+    Clear();
+}
+
+void MMLowerCaptureRing::Clear(void)
+{
+    head    = 0;
+    tail    = 0;
+    used    = 0;
+    dropped = 0;
+}
+
+void MMLowerCaptureRing::Write(
+    const uint8_t* headBytes, uint8_t headSize, const uint8_t* data, uint16_t size)
+{
+    uint32_t total = (uint32_t)headSize + size;
+    if (total > bufSize) {
+        dropped++;
+        return;
+    }
+
+    // Make room by dropping whole records from the old end.
+    while ((uint32_t)(bufSize - used) < total) {
+        uint16_t oldest = RecordSize();
+        tail            = (tail + oldest) % bufSize;
+        used -= oldest;
+        dropped++;
+    }
+    Put(headBytes, headSize);
+    Put(data, size);
+}
+
+/**
+ * @brief Write the capture stream, oldest record first.
+ */
+void MMLowerCaptureRing::Dump(Print& out)
+{
+    WriteHeader(out);
+
+    uint16_t first = bufSize - tail;
+    if (first > used) first = used;
+    out.write(buf + tail, first);
+    if (used > first) out.write(buf, used - first);
+}
+
+void MMLowerCaptureRing::Put(const uint8_t* data, uint16_t size)
+{
+    for (uint16_t i = 0; i < size; i++) {
+        buf[head] = data[i];
+        head      = (head + 1) % bufSize;
+    }
+    used += size;
+}
+
+uint8_t MMLowerCaptureRing::At(uint16_t offset)
+{
+    return buf[(tail + offset) % bufSize];
+}
+
+// Size of the record at tail, header included.
+uint16_t MMLowerCaptureRing::RecordSize(void)
+{
+    uint16_t n = 1;
+    while (At(n++) & 0x80) {}   // dt
+
+    uint32_t size  = 0;
+    uint8_t  shift = 0;
+    uint8_t  b;
+    do {
+        b = At(n++);
+        size |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return n + size;
+}
+
+//--------------------------------------------------------------//
+//  MMLowerCaptureStream  //
+//--------------------------------------------------------------//
+MMLowerCaptureStream::MMLowerCaptureStream(Print& out)
+    : out(out)
+    , headerSent(false)
+{}
+
+void MMLowerCaptureStream::Write(
+    const uint8_t* headBytes, uint8_t headSize, const uint8_t* data, uint16_t size)
+{
+    if (!headerSent) {
+        WriteHeader(out);
+        headerSent = true;
+    }
+    out.write(headBytes, headSize);
+    out.write(data, size);
+}
@@ -0,0 +1,100 @@
+/**
+ * @file MMLowerCapture.h
+ * @brief Binary capture of the MMLower link traffic.
+ * @author MATRIX Robotics
+ */
+#ifndef MMLOWERCAPTURE_H
+#define MMLOWERCAPTURE_H
+
+#include <Arduino.h>
+
+// Capture stream: "MR4C", version, then one record per frame
+//   flags    bit0 = RX, bit1 = framed link
+//   dt       µs since the previous record, LEB128
+//   size     LEB128
+//   bytes    the frame as it crossed the UART
+#define MR4_CAPTURE_MAGIC     "MR4C"
+#define MR4_CAPTURE_VERSION   0x01
+#define MR4_CAPTURE_F_RX      0x01
+#define MR4_CAPTURE_F_FRAMED  0x02
+#define MR4_CAPTURE_HEAD_MAX  9    // flags + 5 byte dt + 3 byte size
+#define MR4_CAPTURE_RX_STAGE  64
+
+/**
+ * @brief Records what MMLower sends and receives, see MMLower::setCapture().
+ *
+ * TX frames are recorded as they are queued. RX bytes are recorded as read,
+ * including bytes the decoder throws away, and committed as one record when
+ * a frame completes (or the stage fills up). Subclasses store the records.
+ */
+class MMLowerCapture
+{
+public:
+    MMLowerCapture();
+    virtual ~MMLowerCapture() {}
+
+    void Record(bool rx, bool framed, const uint8_t* data, uint16_t size);
+    void Stage(uint8_t b, bool framed);
+    void Commit(bool framed);
+
+    uint32_t GetRecordCount(void) { return records; }
+
+protected:
+    virtual void Write(const uint8_t* headBytes, uint8_t headSize, const uint8_t* data, uint16_t size) = 0;
+
+private:
+    uint32_t lastUs;
+    bool     started;
+    uint32_t records;
+    uint8_t  stage[MR4_CAPTURE_RX_STAGE];
+    uint8_t  stageLen;
+};
+
+/**
+ * @brief Keeps the latest records in a RAM ring, the oldest are dropped.
+ *
+ * Dump() writes the capture stream to any Print, e.g. Serial after the
+ * robot misbehaved.
+ */
+class MMLowerCaptureRing : public MMLowerCapture
+{
+public:
+    MMLowerCaptureRing(uint8_t* buffer, uint16_t size);
+
+    void     Dump(Print& out);
+    void     Clear(void);
+    uint32_t GetDropCount(void) { return dropped; }
+
+protected:
+    void Write(const uint8_t* headBytes, uint8_t headSize, const uint8_t* data, uint16_t size) override;
+
+private:
+    uint8_t* buf;
+    uint16_t bufSize;
+    uint16_t head;   // next free byte
+    uint16_t tail;   // oldest record
+    uint16_t used;
+    uint32_t dropped;
+
+    void     Put(const uint8_t* data, uint16_t size);
+    uint8_t  At(uint16_t offset);
+    uint16_t RecordSize(void);
+};
+
+/**
+ * @brief Writes records straight to a Print (Serial, a file, ...).
+ */
+class MMLowerCaptureStream : public MMLowerCapture
+{
+public:
+    MMLowerCaptureStream(Print& out);
+
+protected:
+    void Write(const uint8_t* headBytes, uint8_t headSize, const uint8_t* data, uint16_t size) override;
+
+private:
+    Print& out;
+    bool   headerSent;
+};
+
+#endif   // MMLOWERCAPTURE_H
@@ -0,0 +1,217 @@
+/**
+ * @file MMLowerProfile.cpp
+ * @brief Lower board configuration profile, kept in the R4 EEPROM.
+ * @author MATRIX Robotics
+ */
+#include "MMLowerProfile.h"
+#include "Util/CRC16.h"
+#include "Util/WireFormat.h"
+
+#include <EEPROM.h>
+
+// EEPROM head: magic, version, blob size, CRC16 of the blob
+typedef WireLayout<uint16_t, uint8_t, uint8_t, uint16_t> ProfileHead_t;
+static_assert(ProfileHead_t::Size == MR4_PROFILE_EEPROM_HEAD, "EEPROM head size");
+
+// The blob as Serialize() writes it: sections, directions, speed ranges, PPR,
+// max RPM, motor PID x100, DriveDC PID, servo ranges, IMU calibration
+typedef WireLayout<uint16_t, uint8_t, uint8_t, uint8_t, uint16_t[MR4_PROFILE_MOTOR_NUM],
+                   uint16_t[MR4_PROFILE_MOTOR_NUM], uint16_t[MR4_PROFILE_MOTOR_NUM],
+                   uint16_t[MR4_PROFILE_MOTOR_NUM], uint16_t[MR4_PROFILE_MOTOR_NUM * 3],
+                   uint16_t[MR4_PROFILE_MOTOR_NUM * 3], float[3], float[3], float[3],
+                   uint16_t[MR4_PROFILE_SERVO_NUM], uint16_t[MR4_PROFILE_SERVO_NUM],
+                   uint16_t[MR4_PROFILE_SERVO_NUM], uint16_t[MR4_PROFILE_SERVO_NUM], float[6]>
+    ProfileBlob_t;
+static_assert(ProfileBlob_t::Size == MR4_PROFILE_BLOB_SIZE, "MR4_PROFILE_BLOB_SIZE is stale");
+
+static void PutU16(uint8_t*& p, uint16_t value)
+{
+    p = WireLayout<uint16_t>::PackTo(p, value);
+}
+
+static void PutFloat(uint8_t*& p, float value)
+{
+    p = WireLayout<float>::PackTo(p, value);
+}
+
+static void PutPid(uint8_t*& p, const MMLowerProfile::Pid_t& pid, bool scaled)
+{
+    if (scaled) {
+        // SET_PID_PARAM carries the gains x100
+        PutU16(p, (uint16_t)(pid.kp * 100.0f));
+        PutU16(p, (uint16_t)(pid.ki * 100.0f));
+        PutU16(p, (uint16_t)(pid.kd * 100.0f));
+    } else {
+        PutFloat(p, pid.kp);
+        PutFloat(p, pid.ki);
+        PutFloat(p, pid.kd);
+    }
+}
+
+static uint16_t GetU16(const uint8_t*& p)
+{
+    uint16_t value;
+    p = WireLayout<uint16_t>::UnpackFrom(p, value);
+    return value;
+}
+
+static float GetFloat(const uint8_t*& p)
+{
+    float value;
+    p = WireLayout<float>::UnpackFrom(p, value);
+    return value;
+}
+
+static void GetPid(const uint8_t*& p, MMLowerProfile::Pid_t& pid, bool scaled)
+{
+    if (scaled) {
+        pid.kp = GetU16(p) / 100.0f;
+        pid.ki = GetU16(p) / 100.0f;
+        pid.kd = GetU16(p) / 100.0f;
+    } else {
+        pid.kp = GetFloat(p);
+        pid.ki = GetFloat(p);
+        pid.kd = GetFloat(p);
+    }
+}
+
+/**
+ * @brief Write the MR4_PROFILE_BLOB_SIZE byte wire form.
+ */
+void MMLowerProfile::Serialize(uint8_t* blob) const
+{
+    uint8_t* p = blob;
+    PutU16(p, sections);
+    *p++ = motorReverse;
+    *p++ = encoderReverse;
+    *p++ = servoReverse;
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) PutU16(p, speedMin[i]);
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) PutU16(p, speedMax[i]);
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) PutU16(p, ppr[i]);
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) PutU16(p, maxRPM[i]);
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) PutPid(p, speedPid[i], true);
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) PutPid(p, rotatePid[i], true);
+    PutPid(p, moveSyncPid, false);
+    PutPid(p, moveGyroPid, false);
+    PutPid(p, turnGyroPid, false);
+    for (uint8_t i = 0; i < MR4_PROFILE_SERVO_NUM; i++) PutU16(p, servoAngleMin[i]);
+    for (uint8_t i = 0; i < MR4_PROFILE_SERVO_NUM; i++) PutU16(p, servoAngleMax[i]);
+    for (uint8_t i = 0; i < MR4_PROFILE_SERVO_NUM; i++) PutU16(p, servoPulseMin[i]);
+    for (uint8_t i = 0; i < MR4_PROFILE_SERVO_NUM; i++) PutU16(p, servoPulseMax[i]);
+    for (uint8_t i = 0; i < 6; i++) PutFloat(p, imuCalib[i]);
+}
+
+/**
+ * @brief Read the wire form back.
+ *
+ * Motor PID gains come back rounded to 0.01, as the lower board has them.
+ *
+ * @return false for unknown section bits.
+ */
+bool MMLowerProfile::Deserialize(const uint8_t* blob)
+{
+    const uint8_t* p = blob;
+    sections   = GetU16(p);
+    if (sections & ~(DIR | SPEED_RANGE | PPR | PID | DRIVE_PID | SERVO_RANGE | SERVO_PULSE |
+                     IMU_CALIB)) {
+        return false;
+    }
+    motorReverse   = *p++;
+    encoderReverse = *p++;
+    servoReverse   = *p++;
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) speedMin[i] = GetU16(p);
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) speedMax[i] = GetU16(p);
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) ppr[i] = GetU16(p);
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) maxRPM[i] = GetU16(p);
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) GetPid(p, speedPid[i], true);
+    for (uint8_t i = 0; i < MR4_PROFILE_MOTOR_NUM; i++) GetPid(p, rotatePid[i], true);
+    GetPid(p, moveSyncPid, false);
+    GetPid(p, moveGyroPid, false);
+    GetPid(p, turnGyroPid, false);
+    for (uint8_t i = 0; i < MR4_PROFILE_SERVO_NUM; i++) servoAngleMin[i] = GetU16(p);
+    for (uint8_t i = 0; i < MR4_PROFILE_SERVO_NUM; i++) servoAngleMax[i] = GetU16(p);
+    for (uint8_t i = 0; i < MR4_PROFILE_SERVO_NUM; i++) servoPulseMin[i] = GetU16(p);
+    for (uint8_t i = 0; i < MR4_PROFILE_SERVO_NUM; i++) servoPulseMax[i] = GetU16(p);
+    for (uint8_t i = 0; i < 6; i++) imuCalib[i] = GetFloat(p);
+    return true;
+}
+
+/**
+ * @brief Store the profile in the EEPROM, bytes that did not change are
+ * not rewritten.
+ */
+bool MMLowerProfile::Save(int address) const
+{
+    uint8_t blob[MR4_PROFILE_BLOB_SIZE];
+    Serialize(blob);
+
+    uint8_t head[MR4_PROFILE_EEPROM_HEAD];
+    ProfileHead_t::Pack(head, MR4_PROFILE_EEPROM_MAGIC, MR4_PROFILE_VERSION, MR4_PROFILE_BLOB_SIZE,
+                        CRC16::Calc(blob, sizeof(blob)));
+
+    if (address < 0 || address + sizeof(head) + sizeof(blob) > EEPROM.length()) return false;
+    for (uint8_t i = 0; i < sizeof(head); i++) EEPROM.update(address + i, head[i]);
+    address += sizeof(head);
+    for (uint8_t i = 0; i < sizeof(blob); i++) EEPROM.update(address + i, blob[i]);
+    return true;
+}
+
+/**
+ * @brief Read the profile from the EEPROM.
+ *
+ * @return false when there is none, it is of another version or the CRC
+ * does not match. The profile is left unchanged then.
+ */
+bool MMLowerProfile::Load(int address)
+{
+    if (address < 0 ||
+        address + MR4_PROFILE_EEPROM_HEAD + MR4_PROFILE_BLOB_SIZE > EEPROM.length()) {
+        return false;
+    }
+
+    uint8_t head[MR4_PROFILE_EEPROM_HEAD];
+    for (uint8_t i = 0; i < sizeof(head); i++) head[i] = EEPROM.read(address + i);
+
+    uint16_t magic, crc;
+    uint8_t  version, size;
+    ProfileHead_t::Unpack(head, magic, version, size, crc);
+    if (magic != MR4_PROFILE_EEPROM_MAGIC || version != MR4_PROFILE_VERSION ||
+        size != MR4_PROFILE_BLOB_SIZE) {
+        return false;
+    }
+
+    uint8_t blob[MR4_PROFILE_BLOB_SIZE];
+    address += sizeof(head);
+    for (uint8_t i = 0; i < sizeof(blob); i++) blob[i] = EEPROM.read(address + i);
+    if (CRC16::Calc(blob, sizeof(blob)) != crc) return false;
+
+    MMLowerProfile loaded;
+    if (!loaded.Deserialize(blob)) return false;
+    *this = loaded;
+    return true;
+}
+
+/**
+ * @brief Identity of the profile as the lower board reports it, see
+ * MMLower::GetProfileHash().
+ */
+uint32_t MMLowerProfile::Hash(void) const
+{
+    uint8_t payload[1 + MR4_PROFILE_BLOB_SIZE];
+    payload[0] = MR4_PROFILE_VERSION;
+    Serialize(payload + 1);
+    return Hash(payload, sizeof(payload));
+}
+
+/**
+ * @brief FNV-1a, 32 bit.
+ */
+uint32_t MMLowerProfile::Hash(const uint8_t* data, uint16_t size)
+{
+    uint32_t hash = 2166136261UL;
+    for (uint16_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file MMLowerProfile.h
+ * @brief Lower board configuration profile, kept in the R4 EEPROM.
+ * @author MATRIX Robotics
+ */
+#ifndef MMLOWERPROFILE_H
+#define MMLOWERPROFILE_H
+
+#include <Arduino.h>
+
+// Wire / EEPROM blob: the sections mask, then every field in declaration
+// order, little endian. Motor PID gains go out x100 as uint16 like
+// SET_PID_PARAM, drive PID gains and the IMU calibration as float.
+#define MR4_PROFILE_VERSION   0x01
+#define MR4_PROFILE_MOTOR_NUM 4
+#define MR4_PROFILE_SERVO_NUM 4
+#define MR4_PROFILE_BLOB_SIZE 177
+// EEPROM: "MP", version, blob size, CRC16 of the blob, blob. The IMU
+// calibration of MiniR4Motion sits at 0x32 - 0x49.
+#define MR4_PROFILE_EEPROM_ADDR  0x100
+#define MR4_PROFILE_EEPROM_MAGIC 0x504D   // "MP"
+#define MR4_PROFILE_EEPROM_HEAD  6
+
+/**
+ * @brief Everything the lower board is configured with at boot, as one
+ * value: motor / encoder / servo directions, speed ranges, encoder PPR and
+ * max RPM, motor and DriveDC PID gains, servo ranges and the IMU
+ * calibration. Only the sections a setter touched are applied, and within
+ * a section ports and DriveDC PID sets left at zero keep what the lower
+ * board has.
+ *
+ * Setters return a modified copy, so a sketch can describe its robot as a
+ * constant:
+ *
+ * @code
+ * constexpr MMLowerProfile robot = MMLowerProfile()
+ *     .MotorReverse(2, true)
+ *     .EncoderPPR(1, 537, 312)
+ *     .EncoderPPR(2, 537, 312)
+ *     .MoveSyncPID(0.02f, 0.0f, 0.04f);
+ *
+ * robot.Save();              // EEPROM, only when it changed
+ * mmL.ApplyProfile(robot);   // one transfer, skipped if the board has it
+ * @endcode
+ *
+ * MiniR4.begin(true) applies the saved profile by itself.
+ */
+class MMLowerProfile
+{
+public:
+    enum SECTION : uint16_t
+    {
+        DIR         = 0x0001,
+        SPEED_RANGE = 0x0002,
+        PPR         = 0x0004,
+        PID         = 0x0008,
+        DRIVE_PID   = 0x0010,
+        SERVO_RANGE = 0x0020,
+        SERVO_PULSE = 0x0040,
+        IMU_CALIB   = 0x0080,
+    };
+
+    typedef struct
+    {
+        float kp, ki, kd;
+    } Pid_t;
+
+    uint16_t sections       = 0;
+    uint8_t  motorReverse   = 0;   // bit per port
+    uint8_t  encoderReverse = 0;
+    uint8_t  servoReverse   = 0;
+    uint16_t speedMin[MR4_PROFILE_MOTOR_NUM]      = {};
+    uint16_t speedMax[MR4_PROFILE_MOTOR_NUM]      = {};
+    uint16_t ppr[MR4_PROFILE_MOTOR_NUM]           = {};
+    uint16_t maxRPM[MR4_PROFILE_MOTOR_NUM]        = {};
+    Pid_t    speedPid[MR4_PROFILE_MOTOR_NUM]      = {};   // SetPIDParam() pidNum 0
+    Pid_t    rotatePid[MR4_PROFILE_MOTOR_NUM]     = {};   // SetPIDParam() pidNum 1
+    Pid_t    moveSyncPid                          = {};   // DriveDC 1
+    Pid_t    moveGyroPid                          = {};
+    Pid_t    turnGyroPid                          = {};
+    uint16_t servoAngleMin[MR4_PROFILE_SERVO_NUM] = {};
+    uint16_t servoAngleMax[MR4_PROFILE_SERVO_NUM] = {};
+    uint16_t servoPulseMin[MR4_PROFILE_SERVO_NUM] = {};
+    uint16_t servoPulseMax[MR4_PROFILE_SERVO_NUM] = {};
+    float    imuCalib[6]                          = {};
+
+    // Builders, num is the 1 based port like everywhere else
+    constexpr MMLowerProfile MotorReverse(uint8_t num, bool reverse) const
+    {
+        MMLowerProfile p = *this;
+        p.motorReverse   = SetBit(motorReverse, num, reverse);
+        p.sections |= DIR;
+        return p;
+    }
+    constexpr MMLowerProfile EncoderReverse(uint8_t num, bool reverse) const
+    {
+        MMLowerProfile p = *this;
+        p.encoderReverse = SetBit(encoderReverse, num, reverse);
+        p.sections |= DIR;
+        return p;
+    }
+    constexpr MMLowerProfile ServoReverse(uint8_t num, bool reverse) const
+    {
+        MMLowerProfile p = *this;
+        p.servoReverse   = SetBit(servoReverse, num, reverse);
+        p.sections |= DIR;
+        return p;
+    }
+    constexpr MMLowerProfile SpeedRange(uint8_t num, uint16_t min, uint16_t max) const
+    {
+        MMLowerProfile p    = *this;
+        p.speedMin[num - 1] = min;
+        p.speedMax[num - 1] = max;
+        p.sections |= SPEED_RANGE;
+        return p;
+    }
+    constexpr MMLowerProfile EncoderPPR(uint8_t num, uint16_t pulses, uint16_t rpm) const
+    {
+        MMLowerProfile p = *this;
+        p.ppr[num - 1]    = pulses;
+        p.maxRPM[num - 1] = rpm;
+        p.sections |= PPR;
+        return p;
+    }
+    constexpr MMLowerProfile SpeedPID(uint8_t num, float kp, float ki, float kd) const
+    {
+        MMLowerProfile p    = *this;
+        p.speedPid[num - 1] = {kp, ki, kd};
+        p.sections |= PID;
+        return p;
+    }
+    constexpr MMLowerProfile RotatePID(uint8_t num, float kp, float ki, float kd) const
+    {
+        MMLowerProfile p     = *this;
+        p.rotatePid[num - 1] = {kp, ki, kd};
+        p.sections |= PID;
+        return p;
+    }
+    constexpr MMLowerProfile MoveSyncPID(float kp, float ki, float kd) const
+    {
+        MMLowerProfile p = *this;
+        p.moveSyncPid    = {kp, ki, kd};
+        p.sections |= DRIVE_PID;
+        return p;
+    }
+    constexpr MMLowerProfile MoveGyroPID(float kp, float ki, float kd) const
+    {
+        MMLowerProfile p = *this;
+        p.moveGyroPid    = {kp, ki, kd};
+        p.sections |= DRIVE_PID;
+        return p;
+    }
+    constexpr MMLowerProfile TurnGyroPID(float kp, float ki, float kd) const
+    {
+        MMLowerProfile p = *this;
+        p.turnGyroPid    = {kp, ki, kd};
+        p.sections |= DRIVE_PID;
+        return p;
+    }
+    constexpr MMLowerProfile ServoAngleRange(uint8_t num, uint16_t min, uint16_t max) const
+    {
+        MMLowerProfile p         = *this;
+        p.servoAngleMin[num - 1] = min;
+        p.servoAngleMax[num - 1] = max;
+        p.sections |= SERVO_RANGE;
+        return p;
+    }
+    constexpr MMLowerProfile ServoPulseRange(uint8_t num, uint16_t min, uint16_t max) const
+    {
+        MMLowerProfile p         = *this;
+        p.servoPulseMin[num - 1] = min;
+        p.servoPulseMax[num - 1] = max;
+        p.sections |= SERVO_PULSE;
+        return p;
+    }
+    // Six-position calibration, the faces of MiniR4Motion::saveIMUCalData()
+    constexpr MMLowerProfile IMUCalib(
+        float face1, float face2, float face3, float face4, float face5, float face6) const
+    {
+        MMLowerProfile p = *this;
+        p.imuCalib[0]    = face1;
+        p.imuCalib[1]    = face2;
+        p.imuCalib[2]    = face3;
+        p.imuCalib[3]    = face4;
+        p.imuCalib[4]    = face5;
+        p.imuCalib[5]    = face6;
+        p.sections |= IMU_CALIB;
+        return p;
+    }
+
+    void     Serialize(uint8_t* blob) const;
+    bool     Deserialize(const uint8_t* blob);
+    bool     Save(int address = MR4_PROFILE_EEPROM_ADDR) const;
+    bool     Load(int address = MR4_PROFILE_EEPROM_ADDR);
+    uint32_t Hash(void) const;
+
+    static uint32_t Hash(const uint8_t* data, uint16_t size);
+
+private:
+    static constexpr uint8_t SetBit(uint8_t bits, uint8_t num, bool set)
+    {
+        return set ? (bits | (1 << (num - 1))) : (bits & ~(1 << (num - 1)));
+    }
+};
+
+#endif   // MMLOWERPROFILE_H
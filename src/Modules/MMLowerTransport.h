@@ -0,0 +1,64 @@
+/**
+ * @file MMLowerTransport.h
+ * @brief Byte transport between MMLower and the Lower MCU (STM32).
+ * @author MATRIX Robotics
+ */
+#ifndef MMLOWERTRANSPORT_H
+#define MMLOWERTRANSPORT_H
+
+#include <Arduino.h>
+#include <SoftwareSerial.h>
+
+/**
+ * @brief Byte stream used by MMLower to talk to the lower board.
+ *
+ * MMLower only needs a non-blocking byte pipe, so any serial port (or a
+ * host side pipe for off-target runs) can carry the protocol.
+ */
+class MMLowerTransport
+{
+public:
+    virtual ~MMLowerTransport() {}
+
+    virtual void   begin(uint32_t baudrate)                = 0;
+    virtual void   end(void)                               = 0;
+    virtual int    available(void)                         = 0;
+    virtual int    read(void)                              = 0;
+    virtual size_t write(const uint8_t* data, size_t size) = 0;
+    virtual void   flush(void)                             = 0;
+};
+
+/**
+ * @brief Transport on top of an Arduino serial class (SoftwareSerial, UART, ...).
+ *
+ * @tparam SerialT Serial class providing begin/end/available/read/write/flush.
+ */
+template<typename SerialT> class MMLowerSerialTransport : public MMLowerTransport
+{
+public:
+    MMLowerSerialTransport(SerialT* serial)
+        : _serial(serial)
+    {}
+
+    void   begin(uint32_t baudrate) override { _serial->begin(baudrate, SERIAL_8N1); }
+    void   end(void) override { _serial->end(); }
+    int    available(void) override { return _serial->available(); }
+    int    read(void) override { return _serial->read(); }
+    size_t write(const uint8_t* data, size_t size) override { return _serial->write(data, size); }
+    void   flush(void) override { _serial->flush(); }
+
+private:
+    SerialT* _serial;
+};
+
+/**
+ * @brief Bit-banged link on the default pins (8, 9), works on every board.
+ */
+typedef MMLowerSerialTransport<SoftwareSerial> MMLowerSoftSerialTransport;
+
+/**
+ * @brief Hardware SCI link, interrupt driven and good for higher baud rates.
+ */
+typedef MMLowerSerialTransport<UART> MMLowerUARTTransport;
+
+#endif   // MMLOWERTRANSPORT_H
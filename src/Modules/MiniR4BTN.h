@@ -34,7 +34,7 @@ public:
     bool getState(void)
     {
         bool state = false;
-        MMLower::RESULT result = mmL.GetButtonState(_id, state);
+        if (!mmL.GetCachedButtonState(_id, state)) mmL.GetButtonState(_id, state);
         return state;
     }
 
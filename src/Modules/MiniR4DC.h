@@ -20,7 +20,11 @@
 template<uint8_t ID> class MiniR4DC
 {
 public:
-    MiniR4DC() { _id = ID; }
+    MiniR4DC()
+    {
+        _id       = ID;
+        _deferred = false;
+    }
 
     /**
      * @brief Initializes the DC motor settings.
@@ -63,6 +67,17 @@ public:
 		return (result == MMLower::RESULT::OK);
 	}
 	
+    /**
+     * @brief Enables or disables deferred mode.
+     *
+     * In deferred mode setPower(), setSpeed() and setBrake() only record the
+     * command into the mmL batch. Call mmL.BatchFlush() once per control tick
+     * to send all queued motor and servo commands together.
+     *
+     * @param deferred True to queue commands, false to send them immediately.
+     */
+    void setDeferred(bool deferred) { _deferred = deferred; }
+
     /**
      * @brief Sets the direction of the DC motor.
      * 
@@ -89,6 +104,8 @@ public:
      */
     bool setPower(int16_t power)
     {
+        if (_deferred) return mmL.BatchDCMotorPower(_id, power);
+
         MMLower::RESULT result = mmL.SetDCMotorPower(_id, power);
 		
 		if(result != MMLower::RESULT::OK){
@@ -110,6 +127,8 @@ public:
      */
     bool setSpeed(int16_t speed)
     {
+        if (_deferred) return mmL.BatchDCMotorSpeed(_id, speed);
+
         MMLower::RESULT result = mmL.SetDCMotorSpeed(_id, speed);
         return (result == MMLower::RESULT::OK);
     }
@@ -118,7 +137,8 @@ public:
      * @brief Rotates the DC motor for a specific degree at a given speed.
      * 
      * It's like LEGO EV3/SPIKE Motor rotate for degress block.
-     * Note: Non-Blocking function, you can use ChkRotateEnd() to check motor finish rotate or not.
+     * Note: Non-Blocking function, you can use ChkRotateEnd() to check motor finish rotate or not,
+     *       or waitRotateEnd() to wait for it.
      * Note: If motor not complete rotate and revice other command like setSpeed(), the rotate will be skip. 
      * 
      * @param speed The speed at which to rotate the motor.
@@ -166,8 +186,8 @@ public:
      */
     int32_t getCounter(void)
     {
-        int32_t         counter = 0;
-        MMLower::RESULT result  = mmL.GetEncoderCounter(_id, counter);
+        int32_t counter = 0;
+        if (!mmL.GetCachedEncoderCounter(_id, counter)) mmL.GetEncoderCounter(_id, counter);
         return counter;
     }
 	
@@ -206,6 +226,8 @@ public:
      */
     bool setBrake(bool brake)
     {
+        if (_deferred) return (brake) ? mmL.BatchDCBrake(_id) : mmL.BatchDCMotorSpeed(_id, 0);
+
         if (brake) {
             MMLower::RESULT result = mmL.SetDCBrake(_id);
             return (result == MMLower::RESULT::OK);
@@ -223,12 +245,28 @@ public:
      */
     bool ChkRotateEnd(bool& isEnd)
     {
-        MMLower::RESULT result = mmL.GetRotateState(_id, isEnd);
+        MMLower::RESULT result = mmL.GetTaskState(MMLower::TASK::ROTATE, _id, isEnd);
+        return (result == MMLower::RESULT::OK);
+    }
+
+    /**
+     * @brief Waits until the rotation has ended.
+     * 
+     * Returns as soon as the lower board reports the end of the rotation,
+     * without polling when the firmware pushes task completions.
+     * 
+     * @param timeout_ms Give up after this long, 0 waits for ever.
+     * @return True if the rotation has ended, false on timeout.
+     */
+    bool waitRotateEnd(uint32_t timeout_ms = 0)
+    {
+        MMLower::RESULT result = mmL.WaitTaskDone(MMLower::TASK::ROTATE, _id, timeout_ms);
         return (result == MMLower::RESULT::OK);
     }
 
 private:
     uint8_t _id;
+    bool    _deferred;
 };
 
 #endif   // MINIR4DC_H
@@ -254,12 +254,7 @@ template < uint8_t ID > class MiniR4DriveDC {
     }
 
     if (async == false) {
-      bool stats[2];
-      stats[0] = true;
-      while (stats[0]) {
-        delay(50);
-        mmL.Get_Drive_isTaskDone(_id, stats);
-      }
+      mmL.WaitTaskDone(MMLower::TASK::DRIVE, _id);
 	  
       #ifdef ENABLE_DRIVEDC_BRAKE_DELAY
       delay(DRIVEDC_BRAKE_DELAY_MS); //Give motor some time to stop.
@@ -302,12 +297,7 @@ template < uint8_t ID > class MiniR4DriveDC {
     }
 
     if (async == false) {
-      bool stats[2];
-      stats[0] = true;
-      while (stats[0]) {
-        delay(50);
-        mmL.Get_Drive_isTaskDone(_id, stats);
-      }
+      mmL.WaitTaskDone(MMLower::TASK::DRIVE, _id);
 	  
 	  #ifdef ENABLE_DRIVEDC_BRAKE_DELAY
       delay(DRIVEDC_BRAKE_DELAY_MS); //Give motor some time to stop.
@@ -380,12 +370,7 @@ template < uint8_t ID > class MiniR4DriveDC {
     }
 
     if (async == false) {
-      bool stats[2];
-      stats[0] = true;
-      while (stats[0]) {
-        delay(10);
-        mmL.Get_Drive_isTaskDone(_id, stats);
-      }
+      mmL.WaitTaskDone(MMLower::TASK::DRIVE, _id);
 	  
 	  #ifdef ENABLE_DRIVEDC_BRAKE_DELAY
       delay(DRIVEDC_BRAKE_DELAY_MS); //Give motor some time to stop.
@@ -430,12 +415,7 @@ template < uint8_t ID > class MiniR4DriveDC {
     }
 
     if (async == false) {
-      bool stats[2];
-      stats[0] = true;
-      while (stats[0]) {
-        delay(10);
-        mmL.Get_Drive_isTaskDone(_id, stats);
-      }
+      mmL.WaitTaskDone(MMLower::TASK::DRIVE, _id);
 	  
 	  #ifdef ENABLE_DRIVEDC_BRAKE_DELAY
       delay(DRIVEDC_BRAKE_DELAY_MS); //Give motor some time to stop.
@@ -508,12 +488,7 @@ template < uint8_t ID > class MiniR4DriveDC {
     }
 
     if (async == false) {
-      bool stats[2];
-      stats[0] = true;
-      while (stats[0]) {
-        delay(10);
-        mmL.Get_Drive_isTaskDone(_id, stats);
-      }
+      mmL.WaitTaskDone(MMLower::TASK::DRIVE, _id);
 	  
 	  #ifdef ENABLE_DRIVEDC_BRAKE_DELAY
       delay(DRIVEDC_BRAKE_DELAY_MS); //Give motor some time to stop.
@@ -557,12 +532,7 @@ template < uint8_t ID > class MiniR4DriveDC {
     }
 
     if (async == false) {
-      bool stats[2];
-      stats[0] = true;
-      while (stats[0]) {
-        delay(10);
-        mmL.Get_Drive_isTaskDone(_id, stats);
-      }
+      mmL.WaitTaskDone(MMLower::TASK::DRIVE, _id);
 	  
 	  #ifdef ENABLE_DRIVEDC_BRAKE_DELAY
       delay(DRIVEDC_BRAKE_DELAY_MS); //Give motor some time to stop.
@@ -599,12 +569,7 @@ template < uint8_t ID > class MiniR4DriveDC {
     }
 
     if (async == false) {
-      bool stats[2];
-      stats[0] = true;
-      while (stats[0]) {
-        delay(10);
-        mmL.Get_Drive_isTaskDone(_id, stats);
-      }
+      mmL.WaitTaskDone(MMLower::TASK::DRIVE, _id);
 	  
 	  #ifdef ENABLE_DRIVEDC_BRAKE_DELAY
       delay(DRIVEDC_BRAKE_DELAY_MS); //Give motor some time to stop.
@@ -691,11 +656,31 @@ template < uint8_t ID > class MiniR4DriveDC {
    * @return True if the previous task is done, false if still running.
    */
   bool isPrevTaskDone(void) {
-    bool stsu[2];
+    bool isDone = false;
+    mmL.GetTaskState(MMLower::TASK::DRIVE, _id, isDone);
+    return isDone;
+  }
 
-    MMLower::Drive_RESULT result = mmL.Get_Drive_isTaskDone(_id, stsu);
-    return stsu[0] ? false : true;
+  /**
+   * @brief Waits until the previous task has completed (for async moves).
+   * 
+   * Returns as soon as the lower board reports the end of the task, without
+   * polling when the firmware pushes task completions.
+   * 
+   * @param timeout_ms Give up after this long, 0 waits for ever.
+   * @return True if the task is done, false on timeout.
+   */
+  bool waitPrevTaskDone(uint32_t timeout_ms = 0) {
+    return mmL.WaitTaskDone(MMLower::TASK::DRIVE, _id, timeout_ms) == MMLower::RESULT::OK;
+  }
 
+  /**
+   * @brief Time the previous task completed at.
+   * 
+   * @return micros() of the completion, 0 while it is still running.
+   */
+  uint32_t getTaskDoneTime(void) {
+    return mmL.GetTaskDoneUs(MMLower::TASK::DRIVE, _id);
   }
 
   private: uint8_t _id_left,
@@ -7,8 +7,14 @@
 #define MINIR4MOTION_H
 
 #include "MMLower.h"
+#include "Util/AHRS.h"
 #include <EEPROM.h>
 
+// Axis getters reuse the last update() for this long, 0 = only update() reads
+#ifndef MR4_MOTION_MAX_AGE_MS
+#    define MR4_MOTION_MAX_AGE_MS 10
+#endif
+
 /**
  * @brief Class for motion sensing using an IMU (Inertial Measurement Unit).
  *
@@ -16,11 +22,34 @@
  * 
  * This class provides methods to retrieve gyro, accelerometer, and Euler angles 
  * data from the IMU. It also allows resetting the IMU values to zero.
+ *
+ * Gyro, accelerometer and Euler angles are read together by update() into
+ * a cached sample, which the getters return. They call update() themselves
+ * when the sample is older than the max age (setMaxAge()), so reading all
+ * axes costs one request.
  */
 class MiniR4Motion
 {
 public:
-    MiniR4Motion() {}
+    MiniR4Motion()
+        : _sample()
+        , _maxAgeMs(MR4_MOTION_MAX_AGE_MS)
+        , _updateUs(0)
+        , _cacheValid(false)
+        , _ahrsUs(0)
+    {}
+
+    /**
+     * @brief One IMU sample, see update().
+     */
+    typedef struct
+    {
+        float    gyroX, gyroY, gyroZ;   // deg/s
+        float    accX, accY, accZ;      // g
+        float    roll, pitch, yaw;      // deg
+        uint32_t sampleUs;              // micros() of the sample
+        uint32_t seq;                   // +1 per new sample, 0 = none yet
+    } Sample_t;
 
     enum class AxisType
     {
@@ -38,6 +67,115 @@ public:
         return (result);
     }	
 
+    /**
+     * @brief Reads gyro, accelerometer and Euler angles into the cached sample.
+     *
+     * With the IMU telemetry subscribed and fresh this costs no request,
+     * otherwise it is one snapshot request for all three.
+     *
+     * @return True if the sample was read, the cache is left unchanged otherwise.
+     */
+    bool update(void)
+    {
+        Sample_t s;
+        if (mmL.GetCachedIMUGyro(s.gyroX, s.gyroY, s.gyroZ) &&
+            mmL.GetCachedIMUAcc(s.accX, s.accY, s.accZ) &&
+            mmL.GetCachedIMUEuler(s.roll, s.pitch, s.yaw)) {
+            s.sampleUs = mmL.imuGyroUs;
+        } else {
+            MMLower::Snapshot_t snap;
+            if (mmL.GetSnapshot(snap, MMLower::Snapshot_t::EULER | MMLower::Snapshot_t::GYRO |
+                                          MMLower::Snapshot_t::ACC) != MMLower::RESULT::OK) {
+                return false;
+            }
+            s.gyroX = snap.gyroX, s.gyroY = snap.gyroY, s.gyroZ = snap.gyroZ;
+            s.accX = snap.accX, s.accY = snap.accY, s.accZ = snap.accZ;
+            s.roll = snap.roll, s.pitch = snap.pitch, s.yaw = snap.yaw;
+            s.sampleUs = snap.sampleUs;
+        }
+
+        // The same telemetry sample again keeps its sequence number
+        if (_sample.seq == 0 || s.sampleUs != _sample.sampleUs) {
+            s.seq   = _sample.seq + 1;
+            _sample = s;
+        }
+        _updateUs   = micros();
+        _cacheValid = true;
+        return true;
+    }
+
+    /**
+     * @brief The cached sample, updated first when it is older than the max age.
+     *
+     * Compare seq with the one of an earlier call to tell a new sample from
+     * the same one.
+     */
+    const Sample_t& getSample(void)
+    {
+        refresh();
+        return _sample;
+    }
+
+    /**
+     * @brief Sequence number of the cached sample, 0 before the first one.
+     */
+    uint32_t getSampleSeq(void) { return _sample.seq; }
+
+    /**
+     * @brief How old the cached sample may be before a getter updates it.
+     *
+     * @param maxAgeMs 0 = the getters never update, call update() once per tick.
+     */
+    void setMaxAge(uint16_t maxAgeMs) { _maxAgeMs = maxAgeMs; }
+
+    /**
+     * @brief Runs the on-host AHRS on the IMU telemetry.
+     *
+     * Subscribes the IMU stream at intervalMs and feeds every gyro / acc
+     * sample to ahrs as mmL.loop() receives it. The getters below call
+     * mmL.loop() themselves, a sketch that polls them often enough needs
+     * nothing else.
+     *
+     * @return True if the stream was subscribed.
+     */
+    bool beginAHRS(uint16_t intervalMs = 10, AHRS::FILTER filter = AHRS::FILTER::MAHONY)
+    {
+        ahrs.SetFilter(filter);
+        ahrs.Reset();
+        _ahrsUs    = 0;
+        _ahrsOwner = this;
+        mmL.onIMU(feedAHRS);
+        return (mmL.Subscribe(MMLower::TELEMETRY::IMU, intervalMs) == MMLower::RESULT::OK);
+    }
+
+    /**
+     * @brief Attitude quaternion (w, x, y, z), body to earth.
+     */
+    void getQuaternion(float& w, float& x, float& y, float& z)
+    {
+        mmL.loop();
+        ahrs.GetQuaternion(w, x, y, z);
+    }
+
+    /**
+     * @brief Gravity direction (up) in the body frame, unit length.
+     */
+    void getGravity(float& x, float& y, float& z)
+    {
+        mmL.loop();
+        ahrs.GetGravity(x, y, z);
+    }
+
+    /**
+     * @brief Heading in degrees from the yaw rate about the vertical axis,
+     * not wrapped. resetIMUValues() sets it to 0.
+     */
+    float getHeading(void)
+    {
+        mmL.loop();
+        return ahrs.GetHeading();
+    }
+
     /**
      * @brief Gets the gyro value for a specified axis.
      *
@@ -46,8 +184,8 @@ public:
      */
     double getGyro(AxisType axis)
     {
-        double x = 0, y = 0, z = 0;
-        mmL.GetIMUGyro(x, y, z);
+        float x = 0, y = 0, z = 0;
+        getGyro(x, y, z);
 
         if (axis == AxisType::X)
             return x;
@@ -67,8 +205,8 @@ public:
      */
     double getAccel(AxisType axis)
     {
-        double x = 0, y = 0, z = 0;
-        mmL.GetIMUAcc(x, y, z);
+        float x = 0, y = 0, z = 0;
+        getAccel(x, y, z);
 
         if (axis == AxisType::X)
             return x;
@@ -114,8 +252,8 @@ public:
      */
     double getEuler(AxisType axis)
     {
-        double roll = 0, pitch = 0, yaw = 0;
-        mmL.GetIMUEuler(roll, pitch, yaw);
+        float roll = 0, pitch = 0, yaw = 0;
+        getEuler(roll, pitch, yaw);
 
         if (axis == AxisType::Roll)
             return roll;
@@ -135,8 +273,8 @@ public:
      */
     uint8_t getAccel_All(double * dataX)
     {
-        double x = 0, y = 0, z = 0;
-        mmL.GetIMUAcc(x, y, z);
+        float x = 0, y = 0, z = 0;
+        getAccel(x, y, z);
 
 		dataX[0] = x;
 		dataX[1] = y;
@@ -153,8 +291,8 @@ public:
      */
     uint8_t getGyro_All(double * dataX)
     {
-        double x = 0, y = 0, z = 0;
-        mmL.GetIMUGyro(x, y, z);
+        float x = 0, y = 0, z = 0;
+        getGyro(x, y, z);
 		dataX[0] = x;
 		dataX[1] = y;
 		dataX[2] = z;
@@ -170,8 +308,8 @@ public:
      */
     uint8_t getEuler_All(double * dataX)
     {
-        double roll = 0, pitch = 0, yaw = 0;
-        mmL.GetIMUEuler(roll, pitch, yaw);
+        float roll = 0, pitch = 0, yaw = 0;
+        getEuler(roll, pitch, yaw);
 
 		dataX[0] = roll;
 		dataX[1] = pitch;
@@ -179,6 +317,59 @@ public:
 		
         return 0;
     }
+    /**
+     * @brief Gets the gyro values of all axes (deg/s) in single precision.
+     *
+     * The float getters are the fast path, the Cortex-M4F has no double
+     * precision unit. The double getters above convert their result.
+     *
+     * @return True if the values are valid, they are left unchanged otherwise.
+     */
+    bool getGyro(float& x, float& y, float& z)
+    {
+        if (!refresh()) return false;
+        x = _sample.gyroX, y = _sample.gyroY, z = _sample.gyroZ;
+        return true;
+    }
+
+    /**
+     * @brief Gets the accelerometer values of all axes (g) in single precision.
+     *
+     * @return True if the values are valid, they are left unchanged otherwise.
+     */
+    bool getAccel(float& x, float& y, float& z)
+    {
+        if (!refresh()) return false;
+        x = _sample.accX, y = _sample.accY, z = _sample.accZ;
+        return true;
+    }
+
+    /**
+     * @brief Gets the Euler angles (deg) in single precision.
+     *
+     * @return True if the values are valid, they are left unchanged otherwise.
+     */
+    bool getEuler(float& roll, float& pitch, float& yaw)
+    {
+        if (!refresh()) return false;
+        roll = _sample.roll, pitch = _sample.pitch, yaw = _sample.yaw;
+        return true;
+    }
+
+    /**
+     * @brief Reads encoders, IMU, buttons and battery in one request.
+     *
+     * For a control loop that needs the whole state every tick, one round
+     * trip instead of one per getter.
+     *
+     * @param snap   Receives the values, snap.fields tells which are valid.
+     * @param fields MMLower::Snapshot_t::FIELD values OR'ed, all by default.
+     * @return True if every requested field was read.
+     */
+    bool getSnapshot(MMLower::Snapshot_t& snap, uint16_t fields = MMLower::Snapshot_t::ALL)
+    {
+        return (mmL.GetSnapshot(snap, fields) == MMLower::RESULT::OK);
+    }
 	
 	/**
 	 * @brief Save IMU calibration data with 6 individual parameters (R4 EEPROM 0x32 - 0x49)
@@ -242,43 +433,31 @@ public:
 	
     /**
      * @brief Gets the current encoder Speed value. (RPS)
+     *
+     * Always a sample taken after the one the last call returned.
      * 
      * @return True if the Value is get successfully, false otherwise.
      */
     bool getAllSpeed(int32_t * Speed_value)
     {
-        int32_t         Speed_En[4];
-        MMLower::RESULT result  = mmL.GetALLEncoderSpeed(Speed_En);
-		delay(1);
-		result  = mmL.GetALLEncoderSpeed(Speed_En);
-		Speed_value[0] = Speed_En[0];
-		Speed_value[1] = Speed_En[1];
-		Speed_value[2] = Speed_En[2];
-		Speed_value[3] = Speed_En[3];
-		
+        MMLower::RESULT result = mmL.GetALLEncoderSpeed(
+            Speed_value, mmL.GetSampleSeq(MMLower::SENSOR::SPEED));
         return (result == MMLower::RESULT::OK);
     }	
 	
     /**
 	 * @brief Gets the raw (uncalibrated) IMU accelerometer data
 	 * 
-	 * Reads the 3-axis accelerometer values without calibration applied.
-	 * Performs two consecutive reads with a 2ms delay for stability.
+	 * Reads the 3-axis accelerometer values without calibration applied,
+	 * always a sample taken after the one the last call returned.
 	 * 
 	 * @param accdataCX Pointer to float array to store the accelerometer data (X, Y, Z axes)
 	 * @return true if data was successfully retrieved, false otherwise
 	 */
 	bool getIMU_acc_real(float * accdataCX)
 	{
-		float         Speed_En[4];
-		MMLower::RESULT result  = mmL.Get_IMU_nancalib_acc(Speed_En);
-		delay(2);
-		result  = mmL.Get_IMU_nancalib_acc(Speed_En);
-		
-		accdataCX[0] = Speed_En[0];
-		accdataCX[1] = Speed_En[1];
-		accdataCX[2] = Speed_En[2];
-		
+		MMLower::RESULT result = mmL.Get_IMU_nancalib_acc(
+			accdataCX, mmL.GetSampleSeq(MMLower::SENSOR::IMU));
 		return (result == MMLower::RESULT::OK);
 	}	
 
@@ -287,9 +466,53 @@ public:
      *
      * @return True if the reset operation was successful, false otherwise.
      */
-    bool resetIMUValues(void) { return (mmL.SetIMUToZero() == MMLower::RESULT::OK); }
+    bool resetIMUValues(void)
+    {
+        _cacheValid = false;   // the angles change
+        ahrs.SetHeading(0);
+        return (mmL.SetIMUToZero() == MMLower::RESULT::OK);
+    }
+
+    AHRS ahrs;   // filter and gains, fed by beginAHRS()
 
 private:
+    Sample_t _sample;
+    uint16_t _maxAgeMs;
+    uint32_t _updateUs;
+    bool     _cacheValid;
+    uint32_t _ahrsUs;   // imuAccUs of the last sample fed, 0 = none
+
+    static inline MiniR4Motion* _ahrsOwner = NULL;
+
+    // IMU telemetry hook. mmL.loop() runs it once for the newest sample, so
+    // a sketch busy between loops skips the ones in between: the gap is
+    // integrated at the newest rate, in steps short enough for the filter.
+    // A gap over a second is a stall (a resubscribe, the stream stopped) and
+    // the sample after it only sets the time.
+    static void feedAHRS(void)
+    {
+        MiniR4Motion* self = _ahrsOwner;
+        uint32_t      us   = mmL.imuAccUs;
+        float         dt   = (uint32_t)(us - self->_ahrsUs) * 1e-6f;
+        if (self->_ahrsUs == 0 || dt > 1.0f) dt = 0;
+        self->_ahrsUs = us;
+        do {
+            float step = (dt > 0.05f) ? 0.05f : dt;
+            self->ahrs.Update(mmL.imuGyroX, mmL.imuGyroY, mmL.imuGyroZ,
+                              mmL.imuAccX, mmL.imuAccY, mmL.imuAccZ, step);
+            dt -= step;
+        } while (dt > 0);
+    }
+
+    // update() unless the cached sample is young enough
+    bool refresh(void)
+    {
+        if (_cacheValid &&
+            (_maxAgeMs == 0 || (uint32_t)(micros() - _updateUs) <= (uint32_t)_maxAgeMs * 1000)) {
+            return true;
+        }
+        return update();
+    }
 };
 
 #endif   // MINIR4MOTION_H
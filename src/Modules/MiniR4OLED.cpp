@@ -1021,8 +1021,24 @@ void Adafruit_SSD1306::display(void)
     // 32-byte transfer condition below.
     yield();
 #endif
-    uint16_t count = WIDTH * ((HEIGHT + 7) / 8);
-    uint8_t* ptr   = buffer;
+    ssd1306_data(buffer, WIDTH * ((HEIGHT + 7) / 8));
+    TRANSACTION_END
+#if defined(ESP8266)
+    yield();
+#endif
+}
+
+/*!
+    @brief  Send display RAM data, in WIRE_MAX sized I2C transfers. Call
+            between TRANSACTION_START and TRANSACTION_END.
+    @param  ptr
+            First byte.
+    @param  count
+            Number of bytes.
+    @return None (void).
+*/
+void Adafruit_SSD1306::ssd1306_data(const uint8_t* ptr, uint16_t count)
+{
     if (wire) {   // I2C
         wire->beginTransmission(i2caddr);
         WIRE_WRITE((uint8_t)0x40);
@@ -1042,10 +1058,42 @@ void Adafruit_SSD1306::display(void)
         SSD1306_MODE_DATA
         while (count--) SPIwrite(*ptr++);
     }
+}
+
+/*!
+    @brief  Push one 8 pixel high page of the RAM buffer to the display.
+    @param  page
+            Page number, 0 is the top row.
+    @return None (void).
+*/
+void Adafruit_SSD1306::displayPage(uint8_t page)
+{
+    if (page >= (HEIGHT + 7) / 8) return;
+
+    TRANSACTION_START
+    ssd1306_command1(SSD1306_PAGEADDR);
+    ssd1306_command1(page);
+    ssd1306_command1(page);
+    ssd1306_command1(SSD1306_COLUMNADDR);
+    ssd1306_command1(0);
+    ssd1306_command1(WIDTH - 1);
+    ssd1306_data(buffer + page * WIDTH, WIDTH);
     TRANSACTION_END
-#if defined(ESP8266)
-    yield();
-#endif
+}
+
+/*!
+    @brief  Push the next page of the RAM buffer, so a frame can go out a
+            piece at a time between other work.
+    @return true once the last page of the frame was sent, the next call
+            starts a new frame.
+    @note   In a MiniR4Task: MR4_TASK_WAIT_UNTIL(MiniR4.OLED.displayStep());
+*/
+bool Adafruit_SSD1306::displayStep(void)
+{
+    displayPage(flushPage++);
+    if (flushPage < (HEIGHT + 7) / 8) return false;
+    flushPage = 0;
+    return true;
 }
 
 // SCROLLING FUNCTIONS -----------------------------------------------------
@@ -182,6 +182,8 @@ public:
         uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0, bool reset = true,
         bool periphBegin = true);
     void         display(void);
+    void         displayPage(uint8_t page);
+    bool         displayStep(void);
     void         clearDisplay(void);
     void         invertDisplay(bool i);
     void         dim(bool dim);
@@ -203,6 +205,7 @@ protected:
     void        drawFastVLineInternal(int16_t x, int16_t y, int16_t h, uint16_t color);
     void        ssd1306_command1(uint8_t c);
     void        ssd1306_commandList(const uint8_t* c, uint8_t n);
+    void        ssd1306_data(const uint8_t* ptr, uint16_t count);
 
     SPIClass* spi;     ///< Initialized during construction when using SPI. See
                        ///< SPI.cpp, SPI.h
@@ -228,7 +231,8 @@ protected:
     uint32_t wireClk;      ///< Wire speed for SSD1306 transfers
     uint32_t restoreClk;   ///< Wire speed following SSD1306 transfers
 #endif
-    uint8_t contrast;   ///< normal contrast setting for this device
+    uint8_t contrast;        ///< normal contrast setting for this device
+    uint8_t flushPage = 0;   ///< next page for displayStep()
 #if defined(SPI_HAS_TRANSACTION)
 protected:
     // Allow sub-class to change
@@ -21,7 +21,11 @@
 template<uint8_t ID> class MiniR4RC
 {
 public:
-    MiniR4RC() { _id = ID; }
+    MiniR4RC()
+    {
+        _id       = ID;
+        _deferred = false;
+    }
 
     /**
      * @brief Initializes the servo with a default angle range.
@@ -49,6 +53,16 @@ public:
         return (result == MMLower::RESULT::OK);
     }
 
+    /**
+     * @brief Enables or disables deferred mode.
+     *
+     * In deferred mode setAngle() only records the angle into the mmL batch,
+     * it is sent by the next mmL.BatchFlush().
+     *
+     * @param deferred True to queue commands, false to send them immediately.
+     */
+    void setDeferred(bool deferred) { _deferred = deferred; }
+
     /**
      * @brief Sets the angle of the servo.
      *
@@ -59,12 +73,15 @@ public:
      */
     bool setAngle(uint16_t angle)
     {
+        if (_deferred) return mmL.BatchServoAngle(_id, angle);
+
         MMLower::RESULT result = mmL.SetServoAngle(_id, angle);
         return (result == MMLower::RESULT::OK);
     }
 
 private:
     uint8_t _id;
+    bool    _deferred;
 };
 
 #endif   // MINIR4RC_H
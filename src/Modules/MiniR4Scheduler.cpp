@@ -0,0 +1,219 @@
+/**
+ * @file MiniR4Scheduler.cpp
+ * @brief Cooperative tasks for the MiniR4 runtime.
+ * @author MATRIX Robotics
+ */
+#include "MiniR4Scheduler.h"
+#include "MMLower.h"
+
+// MMLower waits (blocking DriveDC moves) make a pass. The hook is the
+// scheduler's own, a sketch's mmL.onIdle() callback runs as well.
+static void IdleHook(void)
+{
+    mr4Sched.run();
+}
+
+//--------------------------------------------------------------//
+//  MiniR4Task  //
+//--------------------------------------------------------------//
+MiniR4Task::MiniR4Task(const char* name)
+    : _line(0)
+    , _finished(false)
+    , _name(name)
+    , _next(NULL)
+    , _busy(false)
+    , _sleepAt(0)
+    , _sleepMs(0)
+{
+    resetStats();
+}
+
+/**
+ * @brief Start the body over from MR4_TASK_BEGIN(), e.g. after it ended.
+ */
+void MiniR4Task::restart(void)
+{
+    _line     = 0;
+    _finished = false;
+    _sleepMs  = 0;
+}
+
+void MiniR4Task::resetStats(void)
+{
+    _runs    = 0;
+    _totalUs = 0;
+    _maxUs   = 0;
+}
+
+/**
+ * @brief Skip this task for ms, counted from now.
+ */
+void MiniR4Task::wakeAfter(uint32_t ms)
+{
+    _sleepAt = millis();
+    _sleepMs = ms;
+}
+
+bool MiniR4Task::isReady(uint32_t now)
+{
+    return !_finished && !_busy && (uint32_t)(now - _sleepAt) >= _sleepMs;
+}
+
+//--------------------------------------------------------------//
+//  MiniR4PeriodicTask  //
+//--------------------------------------------------------------//
+MiniR4PeriodicTask::MiniR4PeriodicTask(const char* name, uint32_t periodMs, void (*func)(void))
+    : MiniR4Task(name)
+    , _periodMs(periodMs)
+    , _func(func)
+{}
+
+void MiniR4PeriodicTask::run(void)
+{
+    uint32_t start = millis();
+    _func();
+    uint32_t took = millis() - start;
+    wakeAfter(took < _periodMs ? _periodMs - took : 0);
+}
+
+//--------------------------------------------------------------//
+//  MiniR4Scheduler  //
+//--------------------------------------------------------------//
+MiniR4Scheduler::MiniR4Scheduler()
+    : _head(NULL)
+    , _childUs(0)
+{
+    resetStats();
+}
+
+/**
+ * @brief Add a task to the end of the round, the object must outlive it.
+ */
+void MiniR4Scheduler::add(MiniR4Task& task)
+{
+    MiniR4Task** p = &_head;
+    while (*p != NULL) {
+        if (*p == &task) return;
+        p = &(*p)->_next;
+    }
+    task._next = NULL;
+    *p         = &task;
+    mmL.onSchedulerIdle(IdleHook);
+}
+
+void MiniR4Scheduler::remove(MiniR4Task& task)
+{
+    for (MiniR4Task** p = &_head; *p != NULL; p = &(*p)->_next) {
+        if (*p == &task) {
+            *p         = task._next;
+            task._next = NULL;
+            break;
+        }
+    }
+    if (_head == NULL) mmL.onSchedulerIdle(NULL);
+}
+
+/**
+ * @brief One pass: service the lower board link, then run every task that
+ * is not sleeping, finished or already inside run().
+ */
+void MiniR4Scheduler::run(void)
+{
+    uint32_t start = micros();
+    mmL.loop();
+    uint32_t linkUs = micros() - start;
+    _linkUs += linkUs;
+    _childUs += linkUs;
+
+    uint32_t now = millis();
+    for (MiniR4Task* task = _head; task != NULL;) {
+        MiniR4Task* next = task->_next;   // run() may remove it
+        if (task->isReady(now)) runTask(task);
+        task = next;
+    }
+}
+
+/**
+ * @brief delay() that keeps the tasks and the link running.
+ *
+ * Library calls use it for their waits, inside a task the task itself is
+ * skipped meanwhile.
+ */
+void MiniR4Scheduler::delay(uint32_t ms)
+{
+    uint32_t start = millis();
+    do {
+        run();
+        ::yield();
+    } while ((uint32_t)(millis() - start) < ms);
+}
+
+uint8_t MiniR4Scheduler::getTaskCount(void)
+{
+    uint8_t n = 0;
+    for (MiniR4Task* task = _head; task != NULL; task = task->_next) n++;
+    return n;
+}
+
+void MiniR4Scheduler::resetStats(void)
+{
+    for (MiniR4Task* task = _head; task != NULL; task = task->_next) task->resetStats();
+    _linkUs  = 0;
+    _statsUs = micros();
+}
+
+/**
+ * @brief One line per task: runs, total and longest run() time and the
+ * share of the time since resetStats().
+ */
+void MiniR4Scheduler::printStats(Print& out)
+{
+    uint32_t wallUs = micros() - _statsUs;
+    if (wallUs == 0) wallUs = 1;
+
+    uint32_t busyUs = _linkUs;
+    for (MiniR4Task* task = _head; task != NULL; task = task->_next) {
+        out.print(task->_name != NULL ? task->_name : "task");
+        out.print(F(": runs="));
+        out.print(task->_runs);
+        out.print(F(" total="));
+        out.print(task->_totalUs / 1000);
+        out.print(F("ms max="));
+        out.print(task->_maxUs);
+        out.print(F("us load="));
+        out.print(task->_totalUs * 100.0f / wallUs, 1);
+        out.println('%');
+        busyUs += task->_totalUs;
+    }
+    out.print(F("link: total="));
+    out.print(_linkUs / 1000);
+    out.print(F("ms load="));
+    out.print(_linkUs * 100.0f / wallUs, 1);
+    out.println('%');
+    out.print(F("idle: load="));
+    out.print(busyUs < wallUs ? (wallUs - busyUs) * 100.0f / wallUs : 0.0f, 1);
+    out.println('%');
+}
+
+// A task waiting in a library call makes nested passes, their time is
+// charged to the tasks they ran and not to the waiting one.
+void MiniR4Scheduler::runTask(MiniR4Task* task)
+{
+    uint32_t outerChildUs = _childUs;
+    _childUs              = 0;
+    task->_busy           = true;
+
+    uint32_t start = micros();
+    task->run();
+    uint32_t elapsed = micros() - start;
+
+    task->_busy  = false;
+    uint32_t own = elapsed - _childUs;
+    _childUs     = outerChildUs + elapsed;
+
+    task->_runs++;
+    task->_totalUs += own;
+    if (own > task->_maxUs) task->_maxUs = own;
+}
+
+MiniR4Scheduler mr4Sched;
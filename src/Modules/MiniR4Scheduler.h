@@ -0,0 +1,176 @@
+/**
+ * @file MiniR4Scheduler.h
+ * @brief Cooperative tasks for the MiniR4 runtime.
+ * @author MATRIX Robotics
+ */
+#ifndef MINIR4SCHEDULER_H
+#define MINIR4SCHEDULER_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Protothread style task bodies, for use inside MiniR4Task::run().
+ *
+ * run() returns at every wait and continues after it on the next call, so
+ * locals do not survive a wait, keep that state in members. Waits cannot
+ * sit inside a switch statement of the body's own.
+ *
+ * @code
+ * class Blink : public MiniR4Task
+ * {
+ * public:
+ *     Blink() : MiniR4Task("blink") {}
+ *
+ * protected:
+ *     void run(void) override
+ *     {
+ *         MR4_TASK_BEGIN();
+ *         while (true) {
+ *             MiniR4.LED.setColor(1, 0, 0, 255);
+ *             MR4_TASK_DELAY(500);
+ *             MiniR4.LED.setColor(1, 0, 0, 0);
+ *             MR4_TASK_DELAY(500);
+ *         }
+ *         MR4_TASK_END();
+ *     }
+ * };
+ * @endcode
+ */
+#define MR4_TASK_BEGIN()                                                                           \
+    switch (_line) {                                                                               \
+    case 0:
+
+#define MR4_TASK_YIELD()                                                                           \
+    do {                                                                                           \
+        _line = __LINE__;                                                                          \
+        return;                                                                                    \
+    case __LINE__:;                                                                                \
+    } while (0)
+
+#define MR4_TASK_WAIT_UNTIL(cond)                                                                  \
+    do {                                                                                           \
+        _line = __LINE__;                                                                          \
+    case __LINE__:                                                                                 \
+        if (!(cond)) return;                                                                       \
+    } while (0)
+
+// The scheduler does not call run() until the time is up.
+#define MR4_TASK_DELAY(ms)                                                                         \
+    do {                                                                                           \
+        wakeAfter(ms);                                                                             \
+        _line = __LINE__;                                                                          \
+        return;                                                                                    \
+    case __LINE__:;                                                                                \
+    } while (0)
+
+#define MR4_TASK_END()                                                                             \
+    }                                                                                              \
+    _line     = 0;                                                                                 \
+    _finished = true;                                                                              \
+    return
+
+/**
+ * @brief A task run by MiniR4Scheduler. Derive from it and implement run(),
+ * either with the MR4_TASK_ macros or as a plain function that returns
+ * quickly (see MiniR4PeriodicTask).
+ *
+ * The scheduler keeps the time spent in run() per task, time spent in other
+ * tasks meanwhile (a task waiting in a blocking library call) not included.
+ */
+class MiniR4Task
+{
+public:
+    MiniR4Task(const char* name = NULL);
+    virtual ~MiniR4Task() {}
+
+    const char* getName(void) { return _name; }
+    bool        isFinished(void) { return _finished; }
+    void        restart(void);
+
+    uint32_t getRunCount(void) { return _runs; }
+    uint32_t getTotalUs(void) { return _totalUs; }
+    uint32_t getMaxUs(void) { return _maxUs; }
+    void     resetStats(void);
+
+protected:
+    virtual void run(void) = 0;
+
+    void wakeAfter(uint32_t ms);
+
+    uint16_t _line;
+    bool     _finished;
+
+private:
+    friend class MiniR4Scheduler;
+
+    const char* _name;
+    MiniR4Task* _next;
+    bool        _busy;   // inside run(), a nested pass skips it
+    uint32_t    _sleepAt;
+    uint32_t    _sleepMs;
+    uint32_t    _runs;
+    uint32_t    _totalUs;
+    uint32_t    _maxUs;
+
+    bool isReady(uint32_t now);
+};
+
+/**
+ * @brief Calls a function every periodMs, for work that needs no waits.
+ */
+class MiniR4PeriodicTask : public MiniR4Task
+{
+public:
+    MiniR4PeriodicTask(const char* name, uint32_t periodMs, void (*func)(void));
+
+    void setPeriod(uint32_t periodMs) { _periodMs = periodMs; }
+
+protected:
+    void run(void) override;
+
+private:
+    uint32_t _periodMs;
+    void (*_func)(void);
+};
+
+/**
+ * @brief Runs MiniR4Task objects round robin on the one core.
+ *
+ * run() is one pass over the tasks and services the lower board link
+ * (mmL.loop()). Call it from loop(), or wait with delay(), which keeps
+ * passing until the time is up. Library calls that wait (blocking DriveDC
+ * moves, DHT11, gesture, Vision reads) run the other tasks meanwhile, so a
+ * sketch can drive, sense and display at the same time.
+ *
+ * A task is never entered twice: a pass made while it waits in a library
+ * call skips it.
+ */
+class MiniR4Scheduler
+{
+public:
+    MiniR4Scheduler();
+
+    void add(MiniR4Task& task);
+    void remove(MiniR4Task& task);
+
+    void run(void);
+    void delay(uint32_t ms);
+
+    uint8_t  getTaskCount(void);
+    bool     hasTasks(void) { return _head != NULL; }
+    uint32_t getLinkUs(void) { return _linkUs; }
+    void     resetStats(void);
+    void     printStats(Print& out);
+
+private:
+    MiniR4Task* _head;
+    uint32_t    _childUs;   // time of nested passes, taken out of the caller's
+    uint32_t    _linkUs;
+    uint32_t    _statsUs;
+
+    void runTask(MiniR4Task* task);
+};
+
+extern MiniR4Scheduler mr4Sched;
+
+#endif   // MINIR4SCHEDULER_H
@@ -6,6 +6,8 @@
 #ifndef MINIR4_SMART_CAM_READER
 #define MINIR4_SMART_CAM_READER
 
+#include "../MiniR4Scheduler.h"
+
 #include <Arduino.h>
 
 /**
@@ -51,7 +53,9 @@ public:
 
         system_time = millis();   // 获取当前系统时间
         // 等待至少两个字节的数据或超时
-        while ((millis() - system_time < timeout) && (Serial1.available() < 2));
+        while ((millis() - system_time < timeout) && (Serial1.available() < 2)) {
+            if (mr4Sched.hasTasks()) mr4Sched.run();
+        }
 
         if (Serial1.available() >= 2) {     // 如果至少有两个字节的数据
             if (Serial1.read() == 0xAA) {   // 检查头字节
@@ -61,7 +65,9 @@ public:
                 system_time = millis();   // 重置系统时间
                 // 等待足够多的数据或超时
                 while ((millis() - system_time < timeout) &&
-                       (Serial1.available() < length * 2 + 1)) {}
+                       (Serial1.available() < length * 2 + 1)) {
+                    if (mr4Sched.hasTasks()) mr4Sched.run();
+                }
 
                 if (Serial1.available() >= length * 2 + 1) {   // 如果数据足够
                     for (unsigned char n = 0; n < length * 2; n++) {
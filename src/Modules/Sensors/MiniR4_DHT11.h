@@ -15,6 +15,8 @@
 #ifndef MINIR4_DHT11_H
 #define MINIR4_DHT11_H
 
+#include "../MiniR4Scheduler.h"
+
 #include <Arduino.h>
 
 /**
@@ -150,7 +152,7 @@ private:
     {
         pinMode(_pin, OUTPUT);
         digitalWrite(_pin, LOW);
-        delay(18);
+        delay(18);   // a pass could stretch it past what the sensor accepts
         digitalWrite(_pin, HIGH);
         delayMicroseconds(40);
         pinMode(_pin, INPUT);
@@ -164,7 +166,11 @@ private:
      */
     int readRawData(byte data[5])
     {
-        delay(_delayMS);
+        if (mr4Sched.hasTasks()) {
+            mr4Sched.delay(_delayMS);
+        } else {
+            delay(_delayMS);
+        }
         // if (millis() - _lastReadTime < _delayMS) {
         // return ERROR_NOT_READY; // if not reach delayMS, bypass.
         // }
@@ -13,6 +13,17 @@
  * @license MIT License
  */
 #include "MiniR4_MXGesture.h"
+#include "../MiniR4Scheduler.h"
+
+// Lets the scheduler's tasks run meanwhile, a plain delay() without any
+static void GestureDelay(uint32_t ms)
+{
+    if (mr4Sched.hasTasks()) {
+        mr4Sched.delay(ms);
+    } else {
+        delay(ms);
+    }
+}
 
 int MatrixGesture::begin(void) {
     uint16_t partid;
@@ -58,14 +69,14 @@ int MatrixGesture::getGesture(void) {
     _gesture = (MatrixGesture::eGesture_t)(((uint16_t)_gesture) << 8);
     if (_gesture == eGestureWave) {
         DBG("Wave1 Event Detected");
-        delay(GES_QUIT_TIME);
+        GestureDelay(GES_QUIT_TIME);
     } else {
         _gesture = eGestureNone;
         readReg(PAJ7620_ADDR_GES_PS_DET_FLAG_0, &_gesture, 1);  // Read Bank_0_Reg_0x43/0x44 for gesture result.
         _gesture = (MatrixGesture::eGesture_t)(((uint16_t)_gesture) & 0x00ff);
         if (!_gestureHighRate) {
             uint8_t tmp;
-            delay(GES_ENTRY_TIME);
+            GestureDelay(GES_ENTRY_TIME);
             readReg(PAJ7620_ADDR_GES_PS_DET_FLAG_0, &tmp, 1);
             DBG("tmp=0x");
             DBG(tmp, HEX);
@@ -95,18 +106,18 @@ int MatrixGesture::getGesture(void) {
                 case eGestureForward:
                     DBG("Forward Event Detected");
                     if (!_gestureHighRate) {
-                        delay(GES_QUIT_TIME);
+                        GestureDelay(GES_QUIT_TIME);
                     } else {
-                        delay(GES_QUIT_TIME / 5);
+                        GestureDelay(GES_QUIT_TIME / 5);
                     }
                     break;
 
                 case eGestureBackward:
                     DBG("Backward Event Detected");
                     if (!_gestureHighRate) {
-                        delay(GES_QUIT_TIME);
+                        GestureDelay(GES_QUIT_TIME);
                     } else {
-                        delay(GES_QUIT_TIME / 5);
+                        GestureDelay(GES_QUIT_TIME / 5);
                     }
                     break;
 
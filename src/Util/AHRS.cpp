@@ -0,0 +1,227 @@
+/**
+ * @file AHRS.cpp
+ * @brief Attitude and heading from gyro and accelerometer samples.
+ * @author MATRIX Robotics
+ */
+#include "AHRS.h"
+
+#include <math.h>
+
+#define AHRS_DEG_TO_RAD 0.017453292f
+#define AHRS_RAD_TO_DEG 57.29578f
+
+AHRS::AHRS(FILTER filter)
+    : filter(filter)
+    , beta(AHRS_MADGWICK_BETA)
+    , twoKp(2.0f * AHRS_MAHONY_KP)
+    , twoKi(2.0f * AHRS_MAHONY_KI)
+{
+    Reset();
+}
+
+/**
+ * @brief Forget the attitude, the next Update() aligns to gravity again.
+ */
+void AHRS::Reset(void)
+{
+    aligned = false;
+    q0      = 1.0f;
+    q1      = 0.0f;
+    q2      = 0.0f;
+    q3      = 0.0f;
+    iFbX    = 0.0f;
+    iFbY    = 0.0f;
+    iFbZ    = 0.0f;
+    SetHeading(0.0f);
+}
+
+void AHRS::SetHeading(float deg)
+{
+    headingTurns = (int32_t)lroundf(deg / 360.0f);
+    heading      = deg - headingTurns * 360.0f;
+}
+
+void AHRS::SetMahonyGains(float kp, float ki)
+{
+    twoKp = 2.0f * kp;
+    twoKi = 2.0f * ki;
+    if (ki == 0.0f) iFbX = iFbY = iFbZ = 0.0f;
+}
+
+/**
+ * @brief One IMU sample.
+ *
+ * @param gx, gy, gz Angular rate in deg/s.
+ * @param ax, ay, az Acceleration in g, any scale, only the direction is used.
+ * @param dt Seconds since the previous sample.
+ */
+void AHRS::Update(float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+    if (!aligned) {
+        Align(ax, ay, az);
+        return;
+    }
+    if (dt <= 0.0f) return;
+
+    // Rotation about the vertical: the body rate projected on gravity
+    float vx, vy, vz;
+    GetGravity(vx, vy, vz);
+    heading += (gx * vx + gy * vy + gz * vz) * dt;
+    if (heading >= 180.0f) {
+        heading -= 360.0f;
+        headingTurns++;
+    } else if (heading < -180.0f) {
+        heading += 360.0f;
+        headingTurns--;
+    }
+
+    gx *= AHRS_DEG_TO_RAD;
+    gy *= AHRS_DEG_TO_RAD;
+    gz *= AHRS_DEG_TO_RAD;
+    if (filter == FILTER::MADGWICK) {
+        UpdateMadgwick(gx, gy, gz, ax, ay, az, dt);
+    } else {
+        UpdateMahony(gx, gy, gz, ax, ay, az, dt);
+    }
+}
+
+void AHRS::GetQuaternion(float& w, float& x, float& y, float& z) const
+{
+    w = q0;
+    x = q1;
+    y = q2;
+    z = q3;
+}
+
+/**
+ * @brief Unit vector of gravity (up) in the body frame, (0, 0, 1) when level.
+ */
+void AHRS::GetGravity(float& x, float& y, float& z) const
+{
+    x = 2.0f * (q1 * q3 - q0 * q2);
+    y = 2.0f * (q0 * q1 + q2 * q3);
+    z = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+}
+
+/**
+ * @brief Roll, pitch and yaw in degrees, yaw in -180..180.
+ */
+void AHRS::GetEuler(float& roll, float& pitch, float& yaw) const
+{
+    float sinp = 2.0f * (q0 * q2 - q1 * q3);
+    if (sinp > 1.0f) sinp = 1.0f;
+    if (sinp < -1.0f) sinp = -1.0f;
+
+    roll  = atan2f(2.0f * (q0 * q1 + q2 * q3), 1.0f - 2.0f * (q1 * q1 + q2 * q2)) * AHRS_RAD_TO_DEG;
+    pitch = asinf(sinp) * AHRS_RAD_TO_DEG;
+    yaw   = atan2f(2.0f * (q0 * q3 + q1 * q2), 1.0f - 2.0f * (q2 * q2 + q3 * q3)) * AHRS_RAD_TO_DEG;
+}
+
+// Roll and pitch from the accelerometer, yaw 0.
+void AHRS::Align(float ax, float ay, float az)
+{
+    if (ax == 0.0f && ay == 0.0f && az == 0.0f) return;
+
+    float halfRoll  = 0.5f * atan2f(ay, az);
+    float halfPitch = 0.5f * atan2f(-ax, sqrtf(ay * ay + az * az));
+    float cr = cosf(halfRoll), sr = sinf(halfRoll);
+    float cp = cosf(halfPitch), sp = sinf(halfPitch);
+
+    q0      = cr * cp;
+    q1      = sr * cp;
+    q2      = cr * sp;
+    q3      = -sr * sp;
+    aligned = true;
+}
+
+// Madgwick, IMU variant: gradient descent step on the gravity error.
+void AHRS::UpdateMadgwick(float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+    float qDot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+    float qDot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+    float qDot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+    float qDot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+    float norm = ax * ax + ay * ay + az * az;
+    if (norm > 0.0f) {
+        float recip = 1.0f / sqrtf(norm);
+        ax *= recip;
+        ay *= recip;
+        az *= recip;
+
+        float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2, _2q3 = 2.0f * q3;
+        float _4q0 = 4.0f * q0, _4q1 = 4.0f * q1, _4q2 = 4.0f * q2;
+        float _8q1 = 8.0f * q1, _8q2 = 8.0f * q2;
+        float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+
+        float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+        float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 +
+                   _8q1 * q2q2 + _4q1 * az;
+        float s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 +
+                   _8q2 * q2q2 + _4q2 * az;
+        float s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+        norm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+        if (norm > 0.0f) {
+            recip = beta / sqrtf(norm);
+            qDot0 -= s0 * recip;
+            qDot1 -= s1 * recip;
+            qDot2 -= s2 * recip;
+            qDot3 -= s3 * recip;
+        }
+    }
+
+    q0 += qDot0 * dt;
+    q1 += qDot1 * dt;
+    q2 += qDot2 * dt;
+    q3 += qDot3 * dt;
+    Normalize();
+}
+
+// Mahony: PI feedback of the cross product between the measured and the
+// estimated gravity into the gyro rate.
+void AHRS::UpdateMahony(float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+    float norm = ax * ax + ay * ay + az * az;
+    if (norm > 0.0f) {
+        float recip = 1.0f / sqrtf(norm);
+        ax *= recip;
+        ay *= recip;
+        az *= recip;
+
+        float vx, vy, vz;
+        GetGravity(vx, vy, vz);
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+
+        if (twoKi > 0.0f) {
+            iFbX += twoKi * ex * dt;
+            iFbY += twoKi * ey * dt;
+            iFbZ += twoKi * ez * dt;
+            gx += iFbX;
+            gy += iFbY;
+            gz += iFbZ;
+        }
+        gx += twoKp * ex;
+        gy += twoKp * ey;
+        gz += twoKp * ez;
+    }
+
+    float hx = 0.5f * dt * gx, hy = 0.5f * dt * gy, hz = 0.5f * dt * gz;
+    float a = q0, b = q1, c = q2;
+    q0 += -b * hx - c * hy - q3 * hz;
+    q1 += a * hx + c * hz - q3 * hy;
+    q2 += a * hy - b * hz + q3 * hx;
+    q3 += a * hz + b * hy - c * hx;
+    Normalize();
+}
+
+void AHRS::Normalize(void)
+{
+    float recip = 1.0f / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    q0 *= recip;
+    q1 *= recip;
+    q2 *= recip;
+    q3 *= recip;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file AHRS.h
+ * @brief Attitude and heading from gyro and accelerometer samples.
+ * @author MATRIX Robotics
+ */
+#ifndef AHRS_H
+#define AHRS_H
+
+#include <stdint.h>
+
+#ifndef AHRS_MADGWICK_BETA
+#    define AHRS_MADGWICK_BETA 0.1f   // gradient descent step, rad/s
+#endif
+#ifndef AHRS_MAHONY_KP
+#    define AHRS_MAHONY_KP 0.5f
+#endif
+#ifndef AHRS_MAHONY_KI
+#    define AHRS_MAHONY_KI 0.0f
+#endif
+
+/**
+ * @brief Madgwick or Mahony filter on a 6 axis IMU, in single precision for
+ * the Cortex-M4F FPU.
+ *
+ * Update() takes one sample, gyro in deg/s and acceleration in g (the units
+ * of MMLower), at the IMU rate. The gyro is integrated into the attitude
+ * quaternion and the accelerometer pulls roll and pitch towards gravity.
+ * Nothing corrects yaw, it drifts with the gyro bias.
+ *
+ * The heading is the gyro rate about the vertical axis summed over all
+ * samples, in the sign of gz when level. It does not wrap, two full turns
+ * read 720.
+ */
+class AHRS
+{
+public:
+    enum class FILTER
+    {
+        MADGWICK,
+        MAHONY,
+    };
+
+    AHRS(FILTER filter = FILTER::MAHONY);
+
+    void Reset(void);
+    void SetFilter(FILTER filter) { this->filter = filter; }
+    void SetMadgwickGain(float beta) { this->beta = beta; }
+    void SetMahonyGains(float kp, float ki);
+    void Update(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+
+    bool  IsAligned(void) const { return aligned; }
+    void  GetQuaternion(float& w, float& x, float& y, float& z) const;
+    void  GetGravity(float& x, float& y, float& z) const;
+    void  GetEuler(float& roll, float& pitch, float& yaw) const;
+    float GetHeading(void) const { return headingTurns * 360.0f + heading; }
+    void  SetHeading(float deg);
+
+private:
+    FILTER  filter;
+    bool    aligned;              // the first sample sets roll and pitch
+    float   q0, q1, q2, q3;       // body to earth, w x y z
+    float   beta;                 // Madgwick
+    float   twoKp, twoKi;         // Mahony
+    float   iFbX, iFbY, iFbZ;     // Mahony integral feedback, rad/s
+    float   heading;              // deg in -180..180, plus
+    int32_t headingTurns;         // whole turns, so the sum keeps its precision
+
+    void Align(float ax, float ay, float az);
+    void UpdateMadgwick(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+    void UpdateMahony(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+    void Normalize(void);
+};
+
+#endif   // AHRS_H
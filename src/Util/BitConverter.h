@@ -10,6 +10,9 @@
 
 /**
  * @brief MiniR4 low level functions.
+ *
+ * @note Kept for existing code, the library itself packs and unpacks with
+ * the typed, inlined WireLayout (Util/WireFormat.h).
  */
 class BitConverter
 {
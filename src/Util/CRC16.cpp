@@ -0,0 +1,26 @@
+/**
+ * @file CRC16.cpp
+ * @brief MiniR4 low level functions.
+ * @author MATRIX Robotics
+ */
+#include "CRC16.h"
+
+uint16_t CRC16::Update(uint16_t crc, uint8_t value)
+{
+    crc ^= (uint16_t)value << 8;
+    for (uint8_t i = 0; i < 8; i++) {
+        if (crc & 0x8000)
+            crc = (crc << 1) ^ 0x1021;
+        else
+            crc <<= 1;
+    }
+    return crc;
+}
+
+uint16_t CRC16::Calc(const uint8_t* data, uint16_t size, uint16_t crc)
+{
+    for (uint16_t i = 0; i < size; i++) {
+        crc = Update(crc, data[i]);
+    }
+    return crc;
+}
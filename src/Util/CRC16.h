@@ -0,0 +1,23 @@
+/**
+ * @file CRC16.h
+ * @brief MiniR4 low level functions.
+ * @author MATRIX Robotics
+ */
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+
+/**
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) used by the framed link.
+ */
+class CRC16
+{
+public:
+    static uint16_t Calc(const uint8_t* data, uint16_t size, uint16_t crc = 0xFFFF);
+    static uint16_t Update(uint16_t crc, uint8_t value);
+
+private:
+};
+
+#endif   // CRC16_H
@@ -0,0 +1,76 @@
+/**
+ * @file ClockSync.cpp
+ * @brief MiniR4 low level functions.
+ * @author MATRIX Robotics
+ */
+#include "ClockSync.h"
+
+ClockSync::ClockSync()
+{
+    Reset();
+}
+
+void ClockSync::Reset(void)
+{
+    count     = 0;
+    next      = 0;
+    baseUs    = 0;
+    baseTick  = 0;
+    baseRttUs = 0;
+    skew      = 0;
+}
+
+void ClockSync::AddSample(uint32_t sendUs, uint32_t tick, uint32_t recvUs)
+{
+    uint32_t rtt = recvUs - sendUs;
+
+    samples[next].midUs = sendUs + rtt / 2;
+    samples[next].tick  = tick;
+    samples[next].rttUs = rtt;
+    next                = (next + 1) % CLOCKSYNC_WINDOW;
+    if (count < CLOCKSYNC_WINDOW) count++;
+    Fit();
+}
+
+void ClockSync::Fit(void)
+{
+    // The shortest round trip has the least queueing, it anchors the offset.
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < count; i++) {
+        if (samples[i].rttUs < samples[best].rttUs) best = i;
+    }
+    const Sample_t& base = samples[best];
+    baseUs               = base.midUs;
+    baseTick             = base.tick;
+    baseRttUs            = base.rttUs;
+
+    // Drift: slope of the offset over time through the anchor, from the
+    // samples whose round trip is not much worse than the anchor's.
+    float    sxy = 0, sxx = 0;
+    uint32_t span = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        const Sample_t& s = samples[i];
+        if (i == best || s.rttUs > base.rttUs * 2 + 50) continue;
+
+        int32_t dx = (int32_t)(s.midUs - base.midUs);
+        int32_t dy = (int32_t)(s.tick - base.tick) - dx;
+        sxy += (float)dx * dy;
+        sxx += (float)dx * dx;
+        uint32_t adx = (dx < 0) ? -dx : dx;
+        if (adx > span) span = adx;
+    }
+    if (span < CLOCKSYNC_MIN_SPAN) return;
+
+    skew = sxy / sxx;
+    if (skew > CLOCKSYNC_MAX_PPM * 1e-6f) skew = CLOCKSYNC_MAX_PPM * 1e-6f;
+    if (skew < -CLOCKSYNC_MAX_PPM * 1e-6f) skew = -CLOCKSYNC_MAX_PPM * 1e-6f;
+}
+
+/**
+ * @brief Local micros() at which the lower board read the given tick.
+ */
+uint32_t ClockSync::ToLocal(uint32_t tick) const
+{
+    int32_t dt = (int32_t)(tick - baseTick);
+    return baseUs + dt - (int32_t)(dt * skew);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file ClockSync.h
+ * @brief MiniR4 low level functions.
+ * @author MATRIX Robotics
+ */
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <stdint.h>
+
+#define CLOCKSYNC_WINDOW   8
+#define CLOCKSYNC_MAX_PPM  1000   // crystal tolerance, larger estimates are noise
+#define CLOCKSYNC_MIN_SPAN 100000  // µs between samples before the drift is fitted
+
+/**
+ * @brief Maps the lower board µs tick onto the local micros() clock.
+ *
+ * NTP style: every sample is one round trip (local send time, remote tick
+ * of the reply, local receive time). The remote tick is assumed to be taken
+ * halfway through the round trip. The offset is anchored on the sample with
+ * the shortest round trip of the window, the drift is a least squares fit
+ * of the offsets of all samples with a comparable round trip.
+ */
+class ClockSync
+{
+public:
+    ClockSync();
+
+    void     Reset(void);
+    void     AddSample(uint32_t sendUs, uint32_t tick, uint32_t recvUs);
+    bool     IsSynced(void) const { return count > 0; }
+    uint32_t ToLocal(uint32_t tick) const;
+    uint32_t GetRoundTrip(void) const { return baseRttUs; }
+    float    GetDriftPpm(void) const { return skew * 1e6f; }
+
+private:
+    typedef struct
+    {
+        uint32_t midUs;
+        uint32_t tick;
+        uint32_t rttUs;
+    } Sample_t;
+
+    Sample_t samples[CLOCKSYNC_WINDOW];
+    uint8_t  count, next;
+    uint32_t baseUs, baseTick, baseRttUs;
+    float    skew;   // remote ticks per local µs - 1
+
+    void Fit(void);
+};
+
+#endif   // CLOCKSYNC_H
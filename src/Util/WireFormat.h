@@ -0,0 +1,234 @@
+/**
+ * @file WireFormat.h
+ * @brief Typed little endian packing of the lower board link payloads.
+ * @author MATRIX Robotics
+ */
+#ifndef WIREFORMAT_H
+#define WIREFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <type_traits>
+
+/**
+ * @brief Unsigned word of N bytes, loaded / stored little endian.
+ *
+ * On a little endian core (the R4, a PC) memcpy compiles to one, possibly
+ * unaligned, load or store. Elsewhere the bytes are assembled by shifts.
+ */
+template<size_t N>
+struct WireWord;
+
+template<>
+struct WireWord<1>
+{
+    typedef uint8_t Type;
+};
+template<>
+struct WireWord<2>
+{
+    typedef uint16_t Type;
+};
+template<>
+struct WireWord<4>
+{
+    typedef uint32_t Type;
+};
+template<>
+struct WireWord<8>
+{
+    typedef uint64_t Type;
+};
+
+template<typename U>
+static inline U WireLoadWord(const uint8_t* p)
+{
+    U value;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&value, p, sizeof(U));
+#else
+    value = 0;
+    for (uint8_t i = 0; i < sizeof(U); i++) value |= (U)p[i] << (8 * i);
+#endif
+    return value;
+}
+
+template<typename U>
+static inline void WireStoreWord(uint8_t* p, U value)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(p, &value, sizeof(U));
+#else
+    for (uint8_t i = 0; i < sizeof(U); i++) p[i] = (uint8_t)(value >> (8 * i));
+#endif
+}
+
+/**
+ * @brief Wire size and load / store of one field: integers, enums, bool
+ * (1 byte), float (IEEE 754) and arrays of them.
+ */
+template<typename T, typename Enable = void>
+struct WireField
+{
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                  "no wire format for this type");
+    typedef typename WireWord<sizeof(T)>::Type Word;
+
+    static constexpr uint16_t Size = sizeof(T);
+
+    static inline T Load(const uint8_t* p)
+    {
+        Word word = WireLoadWord<Word>(p);
+        T    value;
+        memcpy(&value, &word, sizeof(T));
+        return value;
+    }
+    static inline void Store(uint8_t* p, T value)
+    {
+        Word word;
+        memcpy(&word, &value, sizeof(T));
+        WireStoreWord<Word>(p, word);
+    }
+    static inline void Get(const uint8_t* p, T& out) { out = Load(p); }
+    static inline void Put(uint8_t* p, const T& value) { Store(p, value); }
+};
+
+template<>
+struct WireField<bool>
+{
+    static constexpr uint16_t Size = 1;
+
+    static inline bool Load(const uint8_t* p) { return p[0] != 0; }
+    static inline void Store(uint8_t* p, bool value) { p[0] = (uint8_t)value; }
+    static inline void Get(const uint8_t* p, bool& out) { out = Load(p); }
+    static inline void Put(uint8_t* p, const bool& value) { Store(p, value); }
+};
+
+template<typename T, size_t N>
+struct WireField<T[N]>
+{
+    static constexpr uint16_t Size = N * WireField<T>::Size;
+
+    // A pointer, so a caller's T* parameter can be filled as well
+    static inline void Get(const uint8_t* p, T* out)
+    {
+        for (size_t i = 0; i < N; i++) WireField<T>::Get(p + i * WireField<T>::Size, out[i]);
+    }
+    static inline void Put(uint8_t* p, const T* value)
+    {
+        for (size_t i = 0; i < N; i++) WireField<T>::Put(p + i * WireField<T>::Size, value[i]);
+    }
+};
+
+template<size_t I, typename... Ts>
+struct WireTypeAt;
+
+template<size_t I, typename T, typename... Ts>
+struct WireTypeAt<I, T, Ts...>
+{
+    typedef typename WireTypeAt<I - 1, Ts...>::Type Type;
+};
+template<typename T, typename... Ts>
+struct WireTypeAt<0, T, Ts...>
+{
+    typedef T Type;
+};
+
+/**
+ * @brief A payload of fields Ts... back to back, little endian.
+ *
+ * Sizes and offsets are compile time constants, and access through a
+ * byte array is checked against its size at compile time.
+ *
+ * @code
+ * typedef WireLayout<uint8_t, int32_t[4]> SpeedReply_t;   // status, speeds
+ * uint8_t b[SpeedReply_t::Size];                          // 17
+ * ...
+ * uint8_t status = SpeedReply_t::Get<0>(b);
+ * SpeedReply_t::Read<1>(b, enSpeed);
+ * @endcode
+ */
+template<typename... Ts>
+struct WireLayout
+{
+    static constexpr uint16_t Size = (0 + ... + WireField<Ts>::Size);
+
+    template<size_t I>
+    using Type = typename WireTypeAt<I, Ts...>::Type;
+
+    template<size_t I>
+    static constexpr uint16_t Offset(void)
+    {
+        static_assert(I < sizeof...(Ts), "no such field");
+        constexpr uint16_t sizes[] = {WireField<Ts>::Size...};
+        uint16_t           offset  = 0;
+        for (size_t i = 0; i < I; i++) offset += sizes[i];
+        return offset;
+    }
+
+    // One scalar field
+    template<size_t I, size_t N>
+    static inline Type<I> Get(const uint8_t (&buf)[N])
+    {
+        static_assert(Offset<I>() + WireField<Type<I>>::Size <= N, "field is past the buffer");
+        return WireField<Type<I>>::Load(buf + Offset<I>());
+    }
+
+    // One field of any kind, arrays into a T[] or T*
+    template<size_t I, size_t N, typename Out>
+    static inline void Read(const uint8_t (&buf)[N], Out&& out)
+    {
+        static_assert(Offset<I>() + WireField<Type<I>>::Size <= N, "field is past the buffer");
+        WireField<Type<I>>::Get(buf + Offset<I>(), out);
+    }
+
+    template<size_t N>
+    static inline void Unpack(const uint8_t (&buf)[N], Ts&... out)
+    {
+        static_assert(Size <= N, "layout is larger than the buffer");
+        UnpackFrom(buf, out...);
+    }
+
+    template<size_t N>
+    static inline void Pack(uint8_t (&buf)[N], const Ts&... value)
+    {
+        static_assert(Size <= N, "layout is larger than the buffer");
+        PackTo(buf, value...);
+    }
+
+    // Unchecked, for buffers sized elsewhere (the TX ring). Return the end.
+    static inline const uint8_t* UnpackFrom(const uint8_t* p, Ts&... out)
+    {
+        ((WireField<Ts>::Get(p, out), p += WireField<Ts>::Size), ...);
+        return p;
+    }
+    static inline uint8_t* PackTo(uint8_t* p, const Ts&... value)
+    {
+        ((WireField<Ts>::Put(p, value), p += WireField<Ts>::Size), ...);
+        return p;
+    }
+};
+
+/**
+ * @brief Unpack a buffer into variables, the layout is their types.
+ *
+ * @code
+ * int32_t counter;
+ * WireUnpack(b, counter);   // does not compile if b is shorter than 4
+ * @endcode
+ */
+template<size_t N, typename... Ts>
+static inline void WireUnpack(const uint8_t (&buf)[N], Ts&... out)
+{
+    WireLayout<Ts...>::Unpack(buf, out...);
+}
+
+template<size_t N, typename... Ts>
+static inline void WirePack(uint8_t (&buf)[N], const Ts&... value)
+{
+    WireLayout<Ts...>::Pack(buf, value...);
+}
+
+#endif   // WIREFORMAT_H